@@ -0,0 +1,72 @@
+/*
+   This is free and unencumbered software released into the public domain.
+
+   Anyone is free to copy, modify, publish, use, compile, sell, or
+   distribute this software, either in source code form or as a compiled
+   binary, for any purpose, commercial or non-commercial, and by any
+   means.
+
+   In jurisdictions that recognize copyright laws, the author or authors
+   of this software dedicate any and all copyright interest in the
+   software to the public domain. We make this dedication for the benefit
+   of the public at large and to the detriment of our heirs and
+   successors. We intend this dedication to be an overt act of
+   relinquishment in perpetuity of all present and future rights to this
+   software under copyright law.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+   IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+   OTHER DEALINGS IN THE SOFTWARE.
+
+   For more information, please refer to <http://unlicense.org/>
+*/
+
+#ifndef UTEST_TEST_EXPECT_FAILURE_H_INCLUDED
+#define UTEST_TEST_EXPECT_FAILURE_H_INCLUDED
+
+#include "utest.h"
+
+/*
+   run body, whose assertions are expected to fail, and check that what they
+   printed contains text. What body prints is captured in the buffer utest.h
+   keeps for the output of threads other than the test's, and as body is given
+   a result of its own its failures aren't counted against the test that is
+   running it. Returns non-zero if body failed and printed text.
+*/
+static int expect_failure(void (*body)(int *), const char *text) {
+  struct utest_thread_s *const thread = utest_thread_context();
+  const size_t length = thread->output_length;
+  const int buffered = thread->buffered;
+  int result = UTEST_TEST_PASSED;
+  int found;
+
+  thread->buffered = 1;
+  body(&result);
+  thread->buffered = buffered;
+
+  found = (UTEST_TEST_FAILURE == result) && (UTEST_NULL != thread->output) &&
+          (UTEST_NULL != strstr(thread->output + length, text));
+
+  if (!found) {
+    UTEST_PRINTF("  Expected : a failure printing '%s'\n", text);
+    UTEST_PRINTF("    Actual : %s\n%s",
+                 UTEST_TEST_FAILURE == result ? "a failure printing"
+                                              : "no failure",
+                 thread->output ? thread->output + length : "");
+  }
+
+  thread->output_length = length;
+  if (UTEST_NULL != thread->output) {
+    thread->output[length] = '\0';
+  }
+
+  return found;
+}
+
+#define EXPECT_FAILURE(body, text) EXPECT_TRUE(expect_failure(body, text))
+
+#endif /* UTEST_TEST_EXPECT_FAILURE_H_INCLUDED */
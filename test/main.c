@@ -97,6 +97,114 @@ UTEST(utest_cmdline, filter_with_list) {
 
   free(hits);
 }
+
+UTEST(utest_cmdline, pin_cpu_rejects_non_numbers) {
+  struct subprocess_s process;
+  const char *command[3] = {"utest_test", "--pin-cpu=abc", 0};
+  int return_code;
+  char buffer[256] = {0};
+
+  ASSERT_EQ(0,
+            subprocess_create(command, subprocess_option_combined_stdout_stderr,
+                              &process));
+
+  ASSERT_EQ(buffer, fgets(buffer, sizeof(buffer), subprocess_stdout(&process)));
+  ASSERT_EQ(0, subprocess_join(&process, &return_code));
+  ASSERT_NE(0, return_code);
+  ASSERT_EQ(0, subprocess_destroy(&process));
+
+  ASSERT_STREQ("utest.h: invalid CPU in '--pin-cpu=abc'\n", buffer);
+}
+
+// Run utest_test (with only environment set in its environment, if given),
+// reading what it prints into buffer.
+static int run_utest_test(const char *const command[],
+                          const char *const environment[], char *buffer,
+                          size_t size) {
+  struct subprocess_s process;
+  size_t length = 0;
+  int return_code;
+
+  if (0 != subprocess_create_ex(command,
+                                subprocess_option_combined_stdout_stderr,
+                                environment, &process)) {
+    return -1;
+  }
+
+  while ((length + 1 < size) &&
+         (UTEST_NULL != fgets(buffer + length, (int)(size - length),
+                              subprocess_stdout(&process)))) {
+    length += strlen(buffer + length);
+  }
+
+  buffer[length] = '\0';
+
+  if ((0 != subprocess_join(&process, &return_code)) ||
+      (0 != subprocess_destroy(&process))) {
+    return -1;
+  }
+
+  return return_code;
+}
+
+UTEST(utest_cmdline, cache_key_includes_options) {
+  const char *first[4] = {"utest_test", "--filter=c.Sqrt",
+                          "--cache=utest_cmdline.cache", 0};
+  const char *seeded[5] = {"utest_test", "--filter=c.Sqrt",
+                           "--cache=utest_cmdline.cache",
+                           "--property-seed=7", 0};
+  char buffer[4096];
+
+  remove("utest_cmdline.cache");
+
+  ASSERT_EQ(0, run_utest_test(first, UTEST_NULL, buffer, sizeof(buffer)));
+  EXPECT_TRUE(UTEST_NULL == strstr(buffer, "[  CACHED  ] c.Sqrt"));
+
+  ASSERT_EQ(0, run_utest_test(first, UTEST_NULL, buffer, sizeof(buffer)));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  CACHED  ] c.Sqrt"));
+
+  // A different property seed changes what the tests do, so nothing is reused.
+  ASSERT_EQ(0, run_utest_test(seeded, UTEST_NULL, buffer, sizeof(buffer)));
+  EXPECT_TRUE(UTEST_NULL == strstr(buffer, "[  CACHED  ] c.Sqrt"));
+
+  ASSERT_EQ(0, run_utest_test(seeded, UTEST_NULL, buffer, sizeof(buffer)));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  CACHED  ] c.Sqrt"));
+
+  remove("utest_cmdline.cache");
+}
+
+// The tests these run are only there with the POSIX signal functions.
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+UTEST(utest_cmdline, repeat_lists_each_test_once) {
+  const char *command[4] = {"utest_test", "--repeat=3",
+                            "--filter=repeat_skips.test", 0};
+  // repeat_skips.test skips the first time it runs and fails after that.
+  const char *environment[2] = {"UTEST_CMDLINE_TEST=skip-then-fail", 0};
+  char buffer[4096];
+
+  ASSERT_EQ(1, run_utest_test(command, environment, buffer, sizeof(buffer)));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  PASSED  ] 0 tests.\n"));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  FAILED  ] 1 tests, listed"));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  FAILED  ] repeat_skips.test\n"));
+  EXPECT_TRUE(UTEST_NULL == strstr(buffer, "[  SKIPPED ] 1 tests, listed"));
+  EXPECT_TRUE(UTEST_NULL == strstr(buffer, "[  SKIPPED ] repeat_skips.test\n"));
+}
+
+UTEST(utest_cmdline, fail_fast_stops_busy_workers) {
+  const char *command[5] = {"utest_test", "--processes=3", "--fail-fast",
+                            "--filter=pool_*", 0};
+  // pool_fails.test fails, and pool_hangs.test hangs for 30 seconds.
+  const char *environment[2] = {"UTEST_CMDLINE_TEST=fail", 0};
+  const utest_int64_t start = utest_ns();
+  char buffer[4096];
+
+  ASSERT_EQ(1, run_utest_test(command, environment, buffer, sizeof(buffer)));
+  EXPECT_LT(utest_ns() - start, 20 * UTEST_CAST(utest_int64_t, 1000000000));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[  FAILED  ] pool_fails.test"));
+  EXPECT_TRUE(UTEST_NULL != strstr(buffer, "[ NOT RUN  ] pool_hangs.test"));
+  EXPECT_TRUE(UTEST_NULL == strstr(buffer, "[       OK ] pool_hangs.test"));
+}
+#endif
 #endif
 
 UTEST_MAIN()
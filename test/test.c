@@ -27,6 +27,10 @@
 
 #include "utest.h"
 
+#include "expect_failure.h"
+
+#include <signal.h>
+
 #ifdef _MSC_VER
 /* disable 'conditional expression is constant' - our examples below use this!
  */
@@ -120,6 +124,199 @@ UTEST_F(MyTestF, c2) {
   utest_fixture->foo = 13;
 }
 
+struct MyTestPooled {
+  int foo;
+  int poisoned;
+};
+
+static int my_test_pooled_setups = 0;
+static int my_test_pooled_failed_resets = 0;
+
+UTEST_F_SETUP(MyTestPooled) {
+  ASSERT_EQ(0, utest_fixture->foo);
+  my_test_pooled_setups++;
+  utest_fixture->foo = 42;
+}
+
+UTEST_F_TEARDOWN(MyTestPooled) { ASSERT_NE(0, utest_fixture->foo); }
+
+UTEST_F_RESET(MyTestPooled) {
+  if (utest_fixture->poisoned) {
+    my_test_pooled_failed_resets++;
+  }
+  ASSERT_FALSE(utest_fixture->poisoned);
+  utest_fixture->foo = 42;
+}
+
+UTEST_F(MyTestPooled, c) {
+  ASSERT_EQ(42, utest_fixture->foo);
+  ASSERT_EQ(my_test_pooled_failed_resets + 1, my_test_pooled_setups);
+  utest_fixture->foo = 13;
+}
+
+UTEST_F(MyTestPooled, c2) {
+  ASSERT_EQ(42, utest_fixture->foo);
+  ASSERT_EQ(my_test_pooled_failed_resets + 1, my_test_pooled_setups);
+  utest_fixture->poisoned = 1;
+}
+
+static int c_pool_teardowns = 0;
+
+static void c_pool_setup(int *utest_result, void *fixture) {
+  (void)utest_result;
+  *UTEST_PTR_CAST(int *, fixture) = 1;
+}
+
+static void c_pool_setup_fails(int *utest_result, void *fixture) {
+  *UTEST_PTR_CAST(int *, fixture) = 1;
+  *utest_result = UTEST_TEST_FAILURE;
+}
+
+static void c_pool_teardown(int *utest_result, void *fixture) {
+  (void)utest_result;
+  c_pool_teardowns += *UTEST_PTR_CAST(int *, fixture);
+}
+
+static void c_pool_fails(int *utest_result, void *fixture) {
+  (void)fixture;
+  *utest_result = UTEST_TEST_FAILURE;
+}
+
+UTEST(c, FixturePoolFailures) {
+  struct utest_fixture_pool_s pool;
+  void *fixture;
+  int result = UTEST_TEST_PASSED;
+
+  memset(&pool, 0, sizeof(pool));
+  pool.name = "c_pool";
+  pool.size = sizeof(int);
+  pool.setup = &c_pool_setup_fails;
+  pool.teardown = &c_pool_teardown;
+  pool.reset = &c_pool_fails;
+
+  /* whatever a failed setup acquired is torn down again */
+  c_pool_teardowns = 0;
+  EXPECT_TRUE(UTEST_NULL == utest_fixture_pool_acquire(&pool, &result));
+  EXPECT_EQ(UTEST_TEST_FAILURE, result);
+  EXPECT_EQ(1, c_pool_teardowns);
+
+  /* a failed reset is rebuilt from scratch without failing the test */
+  pool.setup = &c_pool_setup;
+  pool.fixture = malloc(sizeof(int));
+  ASSERT_TRUE(pool.fixture);
+  *UTEST_PTR_CAST(int *, pool.fixture) = 1;
+  c_pool_teardowns = 0;
+  result = UTEST_TEST_PASSED;
+  utest_state.quiet++;
+  fixture = utest_fixture_pool_acquire(&pool, &result);
+  utest_state.quiet--;
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  EXPECT_EQ(1, c_pool_teardowns);
+  ASSERT_TRUE(UTEST_NULL != fixture);
+
+  /* but if it can't be torn down either, the test has no fixture to run on */
+  pool.teardown = &c_pool_fails;
+  utest_state.quiet++;
+  fixture = utest_fixture_pool_acquire(&pool, &result);
+  utest_state.quiet--;
+  EXPECT_EQ(UTEST_TEST_FAILURE, result);
+  EXPECT_TRUE(UTEST_NULL == fixture);
+  EXPECT_TRUE(UTEST_NULL == pool.fixture);
+}
+
+struct MyTestSnapshot {
+  int foo;
+};
+
+static int my_test_snapshot_setups = 0;
+
+UTEST_F_SETUP(MyTestSnapshot) {
+  ASSERT_EQ(0, utest_fixture->foo);
+  my_test_snapshot_setups++;
+  utest_fixture->foo = 42;
+}
+
+UTEST_F_TEARDOWN(MyTestSnapshot) { ASSERT_EQ(42, utest_fixture->foo); }
+
+UTEST_F_SNAPSHOT(MyTestSnapshot)
+
+UTEST_F(MyTestSnapshot, c) {
+  ASSERT_EQ(42, utest_fixture->foo);
+  ASSERT_EQ(1, my_test_snapshot_setups);
+  utest_fixture->foo = 13;
+}
+
+UTEST_F(MyTestSnapshot, c2) {
+  ASSERT_EQ(42, utest_fixture->foo);
+  ASSERT_EQ(1, my_test_snapshot_setups);
+  utest_fixture->foo = 13;
+}
+
+UTEST_F(MyTestSnapshot, c3) {
+  /* the fixture was set up once, in the runner, however many tests use it */
+  ASSERT_EQ(1, my_test_snapshot_setups);
+  ASSERT_EQ(42, utest_fixture->foo);
+}
+
+UTEST(c, SnapshotChildReports) {
+  struct utest_fixture_pool_s pool;
+  struct utest_thread_s *const context = utest_thread_context();
+  const utest_uint64_t checked = context->assertions_checked;
+  const utest_uint64_t failed = utest_state.assertions_failed;
+  const size_t properties_length = utest_state.properties_length;
+  utest_uint64_t child_checked, child_failed;
+  int result = UTEST_TEST_PASSED;
+  int recorded;
+
+#if !defined(UTEST_HAS_FORK)
+  UTEST_SKIP("snapshots need fork()");
+#endif
+
+  memset(&pool, 0, sizeof(pool));
+
+  if (utest_fixture_pool_fork(&pool, &result)) {
+    /* the child stands in for a test that checked 3 assertions, failing 1 */
+    utest_state.output = stdout;
+    utest_state.assertions_failed = 1;
+    utest_record_property("child", "1");
+    utest_fixture_pool_exit_child(UTEST_TEST_FAILURE, 3);
+  }
+
+  /* take back what the child added to this test's counts and properties */
+  child_checked = context->assertions_checked - checked;
+  child_failed = utest_state.assertions_failed - failed;
+  recorded = (properties_length < utest_state.properties_length) &&
+             (UTEST_NULL != strstr(utest_state.properties + properties_length,
+                                   "name=\"child\""));
+  context->assertions_checked = checked;
+  utest_state.assertions_failed = failed;
+  utest_state.properties_length = properties_length;
+  if (UTEST_NULL != utest_state.properties) {
+    utest_state.properties[properties_length] = '\0';
+  }
+
+  EXPECT_EQ(UTEST_TEST_FAILURE, result);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 3), child_checked);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 1), child_failed);
+  EXPECT_TRUE(recorded);
+}
+
+UTEST(c, PropertiesAreEscaped) {
+  FILE *const output = utest_state.output;
+  const size_t length = utest_state.properties_length;
+
+  /* properties are only recorded when there is an XML file to write out */
+  utest_state.output = output ? output : stdout;
+  utest_record_property("a<b", "\"x\" & 'y' > z");
+  utest_state.output = output;
+
+  ASSERT_TRUE(UTEST_NULL != utest_state.properties);
+  EXPECT_STREQ("<property name=\"a&lt;b\" "
+               "value=\"&quot;x&quot; &amp; &apos;y&apos; &gt; z\"/>",
+               utest_state.properties + length);
+}
+
+
 struct MyTestI {
   size_t foo;
   size_t bar;
@@ -147,6 +344,1016 @@ UTEST_I(MyTestI, c2, 128) {
   utest_fixture->foo = 13;
 }
 
+static const int c_p_values[] = {3, 1, 4, 1, 5};
+
+UTEST_P(c, P, int, c_p_values) {
+  ASSERT_LT(0, utest_param);
+  ASSERT_GT(6, utest_param);
+}
+
+UTEST_P_RANGE(c, PRange, double, 0.0, 1.0, 0.25) {
+  ASSERT_LE(0.0, utest_param);
+  ASSERT_GT(1.0, utest_param);
+}
+
+static const unsigned c_p_ranges[2][3] = {{0, 4, 1}, {10, 40, 10}};
+
+UTEST_P_PRODUCT(c, PProduct, unsigned, c_p_ranges) {
+  ASSERT_GT(4u, utest_param[0]);
+  ASSERT_EQ(10u * (utest_param[1] / 10u), utest_param[1]);
+}
+
+static void c_p_zero_step(void) {
+  static const int range[3] = {0, 10, 0};
+  size_t count;
+  UTEST_P_RANGE_COUNT("c.PZeroStep", int, range, count)
+  (void)count;
+}
+
+UTEST(c, PRangeZeroStep) {
+  EXPECT_DEATH(c_p_zero_step(), "step of 0");
+}
+
+UTEST(c, PNames) {
+  const char *const expected[] = {"c.P/3(1)", "c.PRange/3(0.75)",
+                                  "c.PProduct/11(3,30)"};
+  size_t found = 0;
+  size_t i, k;
+
+  for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    for (k = 0; k < utest_state.tests_length; k++) {
+      if (0 == strcmp(expected[i], utest_state.tests[k].name)) {
+        found++;
+        break;
+      }
+    }
+  }
+
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), found);
+}
+
+UTEST_PROPERTY(c, Property, 100) {
+  char string[16];
+  unsigned char bytes[16];
+  const utest_int64_t i = UTEST_GEN_INT(-100, 100);
+  const double d = UTEST_GEN_DOUBLE(-1.0, 1.0);
+  const size_t string_length = UTEST_GEN_STRING(string, sizeof(string));
+  const size_t bytes_length = UTEST_GEN_BYTES(bytes, sizeof(bytes));
+  ASSERT_LE(-100, i);
+  ASSERT_GE(100, i);
+  ASSERT_LE(-1.0, d);
+  ASSERT_GE(1.0, d);
+  ASSERT_EQ(string_length, strlen(string));
+  ASSERT_GT(sizeof(string), string_length);
+  ASSERT_GE(sizeof(bytes), bytes_length);
+}
+
+static utest_int64_t c_property_shrunk = 0;
+
+static void c_property_failing(int *utest_result,
+                                   struct utest_property_s *utest_property) {
+  c_property_shrunk = UTEST_GEN_INT(0, 1000000);
+  EXPECT_GT(1234, c_property_shrunk);
+}
+
+static void c_property_shrinks(int *utest_result) {
+  utest_property_check("c.PropertyShrinks", 100, &c_property_failing,
+                       utest_result);
+}
+
+UTEST(c, PropertyShrinks) {
+  EXPECT_FAILURE(&c_property_shrinks, "Input : int 1234");
+  ASSERT_EQ(1234, c_property_shrunk);
+}
+
+UTEST_FUZZ(c, Fuzz, data, size) {
+  size_t i, lines = 0;
+  for (i = 0; i < size; i++) {
+    lines += ('\n' == data[i]) ? 1 : 0;
+  }
+  ASSERT_LE(lines, size);
+}
+
+static size_t c_fuzz_inputs = 0;
+static size_t c_fuzz_bytes = 0;
+
+static void c_fuzz_counting(int *utest_result, const unsigned char *data,
+                            size_t size) {
+  (void)utest_result;
+  (void)data;
+  c_fuzz_inputs++;
+  c_fuzz_bytes += size;
+}
+
+UTEST(c, FuzzCorpus) {
+  char corpus[1024];
+  const char *const corpus_was = utest_state.fuzz_corpus;
+  struct utest_mapped_file_s file;
+  size_t length = strlen(__FILE__);
+  int result = UTEST_TEST_PASSED;
+
+  /* use the directory holding this file as the seed corpus of a "test" */
+  while ((0 < length) && ('/' != __FILE__[length - 1]) &&
+         ('\\' != __FILE__[length - 1])) {
+    length--;
+  }
+  if ((2 > length) || (sizeof(corpus) <= length)) {
+    UTEST_SKIP("__FILE__ is not a path");
+  }
+  memcpy(corpus, __FILE__, length);
+  corpus[length - 1] = '\0';
+  while ((0 < length) && ('/' != corpus[length - 1]) &&
+         ('\\' != corpus[length - 1])) {
+    length--;
+  }
+  if (2 > length) {
+    UTEST_SKIP("__FILE__ is not a path");
+  }
+  corpus[length - 1] = '\0';
+
+  ASSERT_EQ(0, utest_map_file(__FILE__, &file));
+  ASSERT_LT(0u, file.size);
+
+  utest_state.fuzz_corpus = corpus;
+  utest_fuzz_corpus("test", &c_fuzz_counting, &result);
+  utest_state.fuzz_corpus = corpus_was;
+
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  EXPECT_LT(2u, c_fuzz_inputs);
+  EXPECT_LE(file.size, c_fuzz_bytes);
+  utest_unmap_file(&file);
+}
+
+static void c_fuzz_failing(int *utest_result, const unsigned char *data,
+                           size_t size) {
+  (void)data;
+  EXPECT_LT(UTEST_CAST(size_t, 0), size);
+}
+
+UTEST(c, FuzzCorpusCountsFailures) {
+  int *const current = utest_state.current_result;
+  const char *const corpus_was = utest_state.fuzz_corpus;
+  const utest_uint64_t failed = utest_state.assertions_failed;
+  utest_uint64_t counted;
+  int result = UTEST_TEST_PASSED;
+
+  /* only the empty seed runs, and fails, against our result as the test's */
+  utest_state.current_result = &result;
+  utest_state.fuzz_corpus = "no such corpus";
+  utest_state.quiet++;
+  utest_fuzz_corpus("test", &c_fuzz_failing, &result);
+  utest_state.quiet--;
+  counted = utest_state.assertions_failed - failed;
+  utest_state.fuzz_corpus = corpus_was;
+  utest_state.assertions_failed = failed;
+  utest_state.current_result = current;
+  ASSERT_EQ(UTEST_TEST_FAILURE, result);
+  ASSERT_EQ(1u, counted);
+}
+
+static const char *c_data_glob(void) {
+  static char glob[1024];
+  size_t length = strlen(__FILE__);
+
+  /* match the test*.c files that sit beside this one */
+  while ((0 < length) && ('/' != __FILE__[length - 1]) &&
+         ('\\' != __FILE__[length - 1])) {
+    length--;
+  }
+  if (sizeof(glob) < length + sizeof("test*.c")) {
+    return "test*.c";
+  }
+  memcpy(glob, __FILE__, length);
+  memcpy(glob + length, "test*.c", sizeof("test*.c"));
+  return glob;
+}
+
+UTEST_DATA(c, Data, c_data_glob()) {
+  ASSERT_LT(0u, utest_size);
+  ASSERT_EQ('/', utest_data[0]);
+  ASSERT_TRUE(UTEST_NULL != strstr(utest_path, "test"));
+}
+
+UTEST(c, DataNames) {
+  size_t found = 0;
+  size_t i;
+
+  for (i = 0; i < utest_state.tests_length; i++) {
+    if ((0 == strcmp("c.Data/test.c", utest_state.tests[i].name)) ||
+        (0 == strcmp("c.Data/test11.c", utest_state.tests[i].name))) {
+      found++;
+    }
+  }
+
+  ASSERT_EQ(2u, found);
+}
+
+UTEST(c, MatchesSnapshot) {
+  const char *const snapshot_dir_was = utest_state.snapshot_dir;
+  const char text[] = "line 1\nline 2\nline 3\n";
+  const char changed[] = "line 1\nline two\nline 3\n";
+  int result = UTEST_TEST_PASSED;
+
+  utest_state.snapshot_dir = ".";
+  utest_state.update_snapshots = 1;
+  utest_state.quiet++;
+  EXPECT_EQ(0, utest_check_snapshot(&result, __FILE__, __LINE__, text,
+                                    strlen(text)));
+  utest_state.quiet--;
+  utest_state.update_snapshots = 0;
+
+  utest_state.snapshots_taken = 0;
+  EXPECT_MATCHES_SNAPSHOT(text, strlen(text));
+
+  utest_state.snapshots_taken = 0;
+  utest_state.quiet++;
+  EXPECT_NE(0, utest_check_snapshot(&result, __FILE__, __LINE__, changed,
+                                    strlen(changed)));
+  /* the second snapshot of this test doesn't exist */
+  EXPECT_NE(0, utest_check_snapshot(&result, __FILE__, __LINE__, text,
+                                    strlen(text)));
+  utest_state.quiet--;
+
+  EXPECT_EQ(0, remove("./c.MatchesSnapshot.1.snap"));
+  utest_state.snapshot_dir = snapshot_dir_was;
+}
+
+UTEST(c, ArrayEq) {
+  int a[64];
+  int b[64];
+  const float zeros[2] = {0.0f, -0.0f};
+  const float negative_zeros[2] = {-0.0f, 0.0f};
+  int i;
+
+  for (i = 0; i < 64; i++) {
+    a[i] = b[i] = i * i;
+  }
+
+  EXPECT_ARRAY_EQ(a, b, 64);
+  ASSERT_ARRAY_EQ(a, b, 64);
+  EXPECT_MEMEQ(a, b, sizeof(a));
+  ASSERT_MEMEQ(a, b, sizeof(a));
+  /* the elements differ bitwise, but compare equal */
+  EXPECT_ARRAY_EQ(zeros, negative_zeros, 2);
+}
+
+static void c_array_mismatch(int *utest_result) {
+  int a[40];
+  int b[40];
+  int i;
+
+  for (i = 0; i < 40; i++) {
+    a[i] = b[i] = i;
+  }
+
+  b[3] = -1;
+  b[30] = -2;
+  EXPECT_ARRAY_EQ(a, b, 40);
+  EXPECT_MEMEQ(a, b, sizeof(a));
+}
+
+UTEST(c, ArrayEqFails) {
+  EXPECT_FAILURE(&c_array_mismatch, "2 elements differ");
+  EXPECT_FAILURE(&c_array_mismatch, "8 bytes differ, the first at offset 12");
+}
+
+UTEST(c, ArrayNear) {
+  float a[100];
+  float b[100];
+  double c[3] = {1.0, 2.0, 0.0};
+  const double d[3] = {1.0, 2.0000001, 0.0};
+  double zero = 0.0;
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    a[i] = UTEST_CAST(float, i) * 0.25f;
+    b[i] = a[i] + 0.001f;
+  }
+
+  EXPECT_ARRAY_NEAR(a, b, 100, 0.01f);
+  ASSERT_ARRAY_NEAR(c, d, 3, 0.001);
+  EXPECT_ARRAY_CLOSE(c, d, 3, 0, 1e-6, 0, 0);
+  EXPECT_ARRAY_ULP(c, c, 3, 0);
+  EXPECT_ARRAY_NEAR_MSG(a, b, 100, 0.01f, "a and b");
+  EXPECT_ARRAY_ULP_MSG(c, c, 3, 0, "c");
+  ASSERT_ARRAY_CLOSE_MSG(c, d, 3, 0, 1e-6, 0, 0, "c and d");
+
+  c[2] = zero / zero;
+  EXPECT_ARRAY_CLOSE(c, c, 3, 0, 0, 0, UTEST_NAN_EQUAL);
+}
+
+static void c_array_not_near(int *utest_result) {
+  float a[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+  float b[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+  double c[2] = {0.0, 1.0};
+  double zero = 0.0;
+
+  b[2] = 3.0001f;
+  EXPECT_ARRAY_ULP_MSG(a, b, 4, 1, "b[2] moved");
+  c[0] = zero / zero;
+  EXPECT_ARRAY_NEAR(c, c, 2, 1);
+}
+
+UTEST(c, ArrayNearFails) {
+  EXPECT_FAILURE(&c_array_not_near, "Max ULPs : 419 at [2]");
+  EXPECT_FAILURE(&c_array_not_near, "ULPs : NaN              1");
+  EXPECT_FAILURE(&c_array_not_near, "Message : b[2] moved");
+}
+
+UTEST(c, ConditionWithPercent) {
+  int x = 10;
+  EXPECT_EQ(0, x % 5);
+  ASSERT_NE(1, x % 3 + 1);
+}
+
+static void c_condition_with_percent(int *utest_result) {
+  int x = 10;
+  EXPECT_EQ(1, x % 5);
+  ASSERT_NE(2, x % 3 + 1);
+}
+
+UTEST(c, ConditionWithPercentFails) {
+  EXPECT_FAILURE(&c_condition_with_percent, "Expected : (1) == (x % 5)");
+  EXPECT_FAILURE(&c_condition_with_percent, "Expected : (2) != (x % 3 + 1)");
+}
+
+static void c_failures(int *utest_result) {
+  int x = 10;
+  EXPECT_EQ(1, x % 5);
+  EXPECT_TRUE(x % 5);
+  EXPECT_FALSE(x % 3);
+  EXPECT_STREQ("%d", "%s");
+  EXPECT_STRNEQ("%d", "%s", 2);
+  EXPECT_NEAR(1.0, 2.0, 0.5);
+}
+
+UTEST(c, FailuresAreRecorded) {
+  EXPECT_FAILURE(&c_failures, "Expected : true");
+  EXPECT_FAILURE(&c_failures, "Actual : \"%s\"");
+  EXPECT_FAILURE(&c_failures, "Expected : 1.000000");
+}
+
+UTEST(c, AssertionsCounted) {
+  const utest_uint64_t checked = utest_thread_context()->assertions_checked;
+  EXPECT_TRUE(1);
+  EXPECT_STREQ("a", "a");
+  ASSERT_EQ(checked + 2, utest_thread_context()->assertions_checked);
+}
+
+UTEST(c, MaxFailuresPerTest) {
+  int *const current = utest_state.current_result;
+  const utest_uint64_t failed = utest_state.assertions_failed;
+  const utest_uint64_t max = utest_state.max_failures_per_test;
+  utest_uint64_t counted;
+  int result = UTEST_TEST_PASSED;
+  /* count the failures against our own result, as if it were the test's */
+  utest_state.current_result = &result;
+  utest_state.max_failures_per_test = failed + 1;
+  utest_state.quiet++;
+  c_failures(&result);
+  utest_state.quiet--;
+  counted = utest_state.assertions_failed - failed;
+  utest_state.max_failures_per_test = max;
+  utest_state.assertions_failed = failed;
+  utest_state.current_result = current;
+  ASSERT_EQ(UTEST_TEST_FAILURE, result);
+  ASSERT_EQ(6u, counted);
+}
+
+UTEST(c, PassingTestCountsNoFailures) {
+  EXPECT_FAILURE(&c_failures, "Expected : true");
+  EXPECT_FAILURE(&c_array_mismatch, "2 elements differ");
+  EXPECT_FAILURE(&c_property_shrinks, "Input : int 1234");
+  ASSERT_EQ(0u, utest_state.assertions_failed);
+}
+
+static int c_stress_runs = 0;
+
+UTEST_STRESS(c, Stress, 4, 100) {
+  utest_atomic_increment(&c_stress_runs);
+  ASSERT_GT(UTEST_CAST(size_t, 100), UTEST_STRESS_ITERATION());
+}
+
+static void c_stress_counting(int *utest_result) {
+  (void)utest_result;
+  utest_atomic_increment(&c_stress_runs);
+}
+
+UTEST(c, StressRunsEveryIteration) {
+  c_stress_runs = 0;
+  utest_stress_run(&c_stress_counting, 4, 100, utest_result);
+  ASSERT_EQ(400, c_stress_runs);
+}
+
+UTEST(c, StressScaling) {
+  size_t scaling[2];
+  size_t *const previous = utest_state.scaling;
+  const size_t previous_length = utest_state.scaling_length;
+  scaling[0] = 1;
+  scaling[1] = 2;
+  c_stress_runs = 0;
+  utest_state.scaling = scaling;
+  utest_state.scaling_length = 2;
+  utest_stress_run(&c_stress_counting, 4, 100, utest_result);
+  utest_state.scaling = previous;
+  utest_state.scaling_length = previous_length;
+  ASSERT_EQ(300, c_stress_runs);
+}
+
+UTEST(c, Sqrt) {
+  EXPECT_NEAR(0.0, utest_sqrt(0.0), 1e-300);
+  EXPECT_NEAR(0.0, utest_sqrt(-4.0), 1e-300);
+  EXPECT_NEAR(2.0, utest_sqrt(4.0), 1e-15);
+  EXPECT_NEAR(0.5, utest_sqrt(0.25), 1e-15);
+  EXPECT_NEAR(1.4142135623730951, utest_sqrt(2.0), 1e-15);
+  /* large and small inputs are compared relative to the right answer */
+  EXPECT_NEAR(1.0, utest_sqrt(1e300) / 1e150, 1e-15);
+  EXPECT_NEAR(1.0, utest_sqrt(1e-300) / 1e-150, 1e-15);
+  EXPECT_NEAR(1.0, utest_sqrt(1.7976931348623157e308) / 1.3407807929942596e154,
+              1e-15);
+  EXPECT_NEAR(1.0,
+              utest_sqrt(4.9406564584124654e-324) / 2.2227587494850775e-162,
+              1e-15);
+}
+
+UTEST(c, RepeatStats) {
+  const utest_int64_t big = UTEST_CAST(utest_int64_t, 1e12);
+  struct utest_repeat_s stats;
+  memset(&stats, 0, sizeof(stats));
+  EXPECT_NEAR(0.0, utest_repeat_pass_rate(&stats), 1e-9);
+  EXPECT_NEAR(0.0, utest_repeat_stddev(&stats), 1e-9);
+
+  utest_repeat_add(&stats, UTEST_TEST_PASSED, 100);
+  utest_repeat_add(&stats, UTEST_TEST_FAILURE, 200);
+  utest_repeat_add(&stats, UTEST_TEST_SKIPPED, 300);
+  utest_repeat_add(&stats, UTEST_TEST_PASSED, 400);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 4), stats.runs);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 3), stats.passes);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 1), stats.skips);
+  EXPECT_NEAR(75.0, utest_repeat_pass_rate(&stats), 1e-9);
+  EXPECT_NEAR(250.0, stats.mean_ns, 1e-9);
+  EXPECT_NEAR(111.80339887498948, utest_repeat_stddev(&stats), 1e-9);
+
+  /* long runs that barely vary, that a naive sum of squares would lose */
+  memset(&stats, 0, sizeof(stats));
+  utest_repeat_add(&stats, UTEST_TEST_FAILURE, big + 4);
+  utest_repeat_add(&stats, UTEST_TEST_FAILURE, big + 7);
+  utest_repeat_add(&stats, UTEST_TEST_FAILURE, big + 13);
+  utest_repeat_add(&stats, UTEST_TEST_FAILURE, big + 16);
+  EXPECT_NEAR(0.0, utest_repeat_pass_rate(&stats), 1e-9);
+  EXPECT_NEAR(1000000000010.0, stats.mean_ns, 1e-3);
+  EXPECT_NEAR(4.7434164902525691, utest_repeat_stddev(&stats), 1e-6);
+}
+
+UTEST(c, EnvironmentIsRead) {
+  struct utest_environment_s environment;
+  utest_environment_read(&environment, 0);
+  ASSERT_NE(UTEST_CAST(size_t, 0), strlen(environment.cpu));
+  ASSERT_NE(UTEST_CAST(size_t, 0), strlen(environment.governor));
+  ASSERT_NE(UTEST_CAST(size_t, 0), strlen(environment.load_average));
+}
+
+UTEST(c, EnvironmentParsesCpuinfo) {
+  char cpu[16];
+  EXPECT_TRUE(utest_parse_cpuinfo_line("model name\t: Foo CPU @ 2GHz\n", cpu,
+                                       sizeof(cpu)));
+  EXPECT_STREQ("Foo CPU @ 2GHz", cpu);
+  EXPECT_TRUE(utest_parse_cpuinfo_line("model name:Bar", cpu, sizeof(cpu)));
+  EXPECT_STREQ("Bar", cpu);
+  EXPECT_TRUE(utest_parse_cpuinfo_line("model name : A very long name\n", cpu,
+                                       sizeof(cpu)));
+  EXPECT_STREQ("A very long nam", cpu);
+  EXPECT_FALSE(utest_parse_cpuinfo_line("processor\t: 0\n", cpu, sizeof(cpu)));
+  EXPECT_FALSE(utest_parse_cpuinfo_line("model\t\t: 85\n", cpu, sizeof(cpu)));
+  EXPECT_FALSE(utest_parse_cpuinfo_line("model name\t:\n", cpu, sizeof(cpu)));
+  EXPECT_FALSE(utest_parse_cpuinfo_line("model name", cpu, sizeof(cpu)));
+}
+
+UTEST(c, EnvironmentParsesLoadavg) {
+  char line[32];
+  UTEST_SNPRINTF(line, sizeof(line), "%s", "0.52 0.58 0.59 1/389 12345");
+  EXPECT_EQ(0, utest_parse_loadavg(line));
+  EXPECT_STREQ("0.52 0.58 0.59", line);
+  UTEST_SNPRINTF(line, sizeof(line), "%s", "1.00 2.50 3");
+  EXPECT_EQ(0, utest_parse_loadavg(line));
+  EXPECT_STREQ("1.00 2.50 3", line);
+  UTEST_SNPRINTF(line, sizeof(line), "%s", "0.52 0.58");
+  EXPECT_NE(0, utest_parse_loadavg(line));
+  UTEST_SNPRINTF(line, sizeof(line), "%s", "0.52 x 0.59 1/389 12345");
+  EXPECT_NE(0, utest_parse_loadavg(line));
+  UTEST_SNPRINTF(line, sizeof(line), "%s", "");
+  EXPECT_NE(0, utest_parse_loadavg(line));
+}
+
+static void c_stress_failing(int *utest_result) {
+  EXPECT_NE(UTEST_CAST(size_t, 3), UTEST_STRESS_ITERATION());
+}
+
+UTEST(c, StressStopsOnFailure) {
+  int result = UTEST_TEST_PASSED;
+  utest_state.quiet++;
+  utest_stress_run(&c_stress_failing, 2, 100, &result);
+  utest_threads_collect();
+  utest_state.quiet--;
+  ASSERT_EQ(UTEST_TEST_FAILURE, result);
+}
+
+UTEST(c, LastFailedContains) {
+  const char *const list = "foo.bar\nfoo.baz\n";
+  EXPECT_TRUE(utest_last_failed_contains(list, "foo.bar"));
+  EXPECT_TRUE(utest_last_failed_contains(list, "foo.baz"));
+  EXPECT_FALSE(utest_last_failed_contains(list, "foo.ba"));
+  EXPECT_FALSE(utest_last_failed_contains(list, "foo.bazz"));
+  EXPECT_FALSE(utest_last_failed_contains("", "foo.bar"));
+}
+
+UTEST(c, LastFailedFirst) {
+  size_t order[3];
+  const size_t size = strlen(utest_state.tests[2].name) + 2;
+  char *const list = UTEST_PTR_CAST(char *, malloc(size));
+  ASSERT_TRUE(list);
+  UTEST_SNPRINTF(list, size, "%s\n", utest_state.tests[2].name);
+  order[0] = 0;
+  order[1] = 1;
+  order[2] = 2;
+  utest_last_failed_first(order, 3, list);
+  free(list);
+  EXPECT_EQ(UTEST_CAST(size_t, 2), order[0]);
+  EXPECT_EQ(UTEST_CAST(size_t, 0), order[1]);
+  EXPECT_EQ(UTEST_CAST(size_t, 1), order[2]);
+}
+
+static void c_corrupted(void) {
+  fputs("heap corrupted at 0x1234\n", stderr);
+  abort();
+}
+
+UTEST(c, Death) {
+  EXPECT_DEATH(abort(), "");
+  EXPECT_DEATH(c_corrupted(), "corrupted at 0x[0-9]+");
+  ASSERT_DEATH(exit(1), UTEST_NULL);
+  EXPECT_EXIT(exit(3), UTEST_EXITED_WITH_CODE(3), "");
+  EXPECT_EXIT(exit(0), UTEST_EXITED_WITH_CODE(0), "");
+  EXPECT_EXIT(c_corrupted(), UTEST_KILLED_BY_SIGNAL(SIGABRT), "heap");
+}
+
+UTEST(c, CrashHandlerReraises) {
+  void *const handle = utest_crash_handler_install();
+  EXPECT_EXIT(raise(SIGSEGV), UTEST_KILLED_BY_SIGNAL(SIGSEGV), "");
+  EXPECT_EXIT(abort(), UTEST_KILLED_BY_SIGNAL(SIGABRT), "");
+  utest_crash_handler_uninstall(handle);
+}
+
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+static void c_crash_ignored(int signal_number) { (void)signal_number; }
+
+/* crash in a child that isn't a death test's, so the handler reports it */
+static void c_crash_child(const int output, const int xml) {
+  struct utest_repeat_s *const repeats = UTEST_PTR_CAST(
+      struct utest_repeat_s *,
+      calloc(utest_state.tests_length, sizeof(struct utest_repeat_s)));
+  struct rlimit core;
+
+  core.rlim_cur = 0;
+  core.rlim_max = 0;
+  setrlimit(RLIMIT_CORE, &core);
+  dup2(output, STDOUT_FILENO);
+
+  if (UTEST_NULL == repeats) {
+    _exit(1);
+  }
+
+  /* the first test ran and failed before the crash */
+  repeats[0].runs = 1;
+
+  utest_crash_handler_install();
+  utest_state.repeats = repeats;
+  utest_state.current_test = "c.Crashing";
+  utest_state.crash_output = xml;
+  raise(SIGSEGV);
+  _exit(1);
+}
+
+static void c_read_all(const int fd, char *buffer, const size_t size) {
+  size_t length = 0;
+  ssize_t got;
+
+  while (length + 1 < size) {
+    got = read(fd, buffer + length, size - length - 1);
+
+    if ((0 > got) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= got) {
+      break;
+    }
+
+    length += UTEST_CAST(size_t, got);
+  }
+
+  buffer[length] = '\0';
+  close(fd);
+}
+#endif
+
+UTEST(c, CrashHandlerReports) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  char printed[8192];
+  char closed[256];
+  char failed[256];
+  int output[2];
+  int xml[2];
+  int status = 0;
+  pid_t pid;
+
+  ASSERT_EQ(0, pipe(output));
+  ASSERT_EQ(0, pipe(xml));
+  fflush(stdout);
+
+  pid = fork();
+
+  if (0 == pid) {
+    close(output[0]);
+    close(xml[0]);
+    c_crash_child(output[1], xml[1]);
+  }
+
+  close(output[1]);
+  close(xml[1]);
+  c_read_all(output[0], printed, sizeof(printed));
+  c_read_all(xml[0], closed, sizeof(closed));
+  ASSERT_LT(0, pid);
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+
+  EXPECT_TRUE(WIFSIGNALED(status));
+  EXPECT_EQ(SIGSEGV, WTERMSIG(status));
+  EXPECT_TRUE(strstr(printed, "[ CRASHED  ] c.Crashing (SIGSEGV)\n"));
+  EXPECT_TRUE(strstr(printed, "[  PASSED  ] 0 tests before the crash.\n"));
+  EXPECT_TRUE(strstr(printed, "[  FAILED  ] 2 tests, listed below:\n"));
+  UTEST_SNPRINTF(failed, sizeof(failed), "[  FAILED  ] %s\n",
+                 utest_state.tests[0].name);
+  EXPECT_TRUE(strstr(printed, failed));
+  EXPECT_TRUE(strstr(printed, "[  FAILED  ] c.Crashing (crashed)\n"));
+  EXPECT_STREQ("<failure message=\"crashed with SIGSEGV\"/></testcase>\n"
+               "</testsuite>\n</testsuites>\n",
+               closed);
+#else
+  UTEST_SKIP("the crash handler needs POSIX signals");
+#endif
+}
+
+UTEST(c, CrashHandlerRestores) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct sigaction mine;
+  struct sigaction before;
+  struct sigaction after;
+  stack_t stack_before;
+  stack_t stack_after;
+  void *handle;
+
+  memset(&mine, 0, sizeof(mine));
+  mine.sa_handler = c_crash_ignored;
+  sigemptyset(&mine.sa_mask);
+  ASSERT_EQ(0, sigaction(SIGBUS, &mine, &before));
+  ASSERT_EQ(0, sigaltstack(UTEST_NULL, &stack_before));
+
+  handle = utest_crash_handler_install();
+  ASSERT_TRUE(handle);
+  utest_crash_handler_uninstall(handle);
+
+  ASSERT_EQ(0, sigaction(SIGBUS, &before, &after));
+  ASSERT_EQ(0, sigaltstack(UTEST_NULL, &stack_after));
+  EXPECT_TRUE(c_crash_ignored == after.sa_handler);
+  EXPECT_TRUE(stack_before.ss_sp == stack_after.ss_sp);
+  EXPECT_EQ(stack_before.ss_flags, stack_after.ss_flags);
+#else
+  UTEST_SKIP("the crash handler needs POSIX signals");
+#endif
+}
+
+static size_t c_test_index(const char *name) {
+  size_t index = 0;
+  while (0 != strcmp(name, utest_state.tests[index].name)) {
+    index++;
+  }
+  return index;
+}
+
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+/*
+   tests for the command line tests in main.c (and the pool tests here) to run,
+   which exit, fail, skip or hang when UTEST_CMDLINE_TEST asks them to, and
+   otherwise just pass.
+*/
+static int c_cmdline_asked(const char *what) {
+  const char *const asked = getenv("UTEST_CMDLINE_TEST");
+  return (UTEST_NULL != asked) && (0 == strcmp(what, asked));
+}
+
+UTEST(pool_exits, test) {
+  (void)utest_result;
+
+  if (c_cmdline_asked("exit")) {
+    _exit(3);
+  }
+}
+
+UTEST(pool_fails, test) { ASSERT_FALSE(c_cmdline_asked("fail")); }
+
+UTEST(repeat_skips, test) {
+  static int runs = 0;
+
+  /* skipped the first time it runs, and failing every time after that */
+  if (c_cmdline_asked("skip-then-fail") && (0 < runs++)) {
+    ASSERT_TRUE(0);
+  } else if (c_cmdline_asked("skip-then-fail")) {
+    UTEST_SKIP("only fails when it is repeated");
+  }
+}
+
+UTEST(pool_hangs, test) {
+  int seconds;
+
+  (void)utest_result;
+
+  /* long enough to tell, should --fail-fast not kill the worker running it */
+  for (seconds = 0; c_cmdline_asked("fail") && (seconds < 30); seconds++) {
+    sleep(1);
+  }
+}
+
+struct c_pool {
+  struct utest_pool_s pool;
+};
+
+UTEST_F_SETUP(c_pool) {
+  (void)utest_result;
+  memset(&utest_fixture->pool, 0, sizeof(utest_fixture->pool));
+}
+
+/* shut the pool down here, so an ASSERT failing doesn't leave workers behind */
+UTEST_F_TEARDOWN(c_pool) {
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 0),
+            utest_pool_shutdown(&utest_fixture->pool));
+}
+
+static struct utest_pool_s *c_pool_running;
+static utest_int64_t c_pool_ns;
+
+/* run a test on the first worker of c_pool_running */
+static void c_pool_run(const char *name, int *result) {
+  struct utest_pool_worker_s *worker;
+  utest_uint64_t checked = 0;
+  utest_uint64_t teardowns = 0;
+
+  *result = UTEST_TEST_FAILURE;
+  c_pool_ns = 0;
+
+  if (0 != utest_pool_dispatch(&c_pool_running->workers[0],
+                               c_test_index(name))) {
+    return;
+  }
+
+  worker = utest_pool_wait(c_pool_running);
+
+  if (worker == &c_pool_running->workers[0]) {
+    c_pool_ns = utest_pool_finish(c_pool_running, worker, result,
+                                      &checked, &teardowns);
+  }
+}
+
+static void c_pool_run_exit(int *result) {
+  c_pool_run("pool_exits.test", result);
+}
+
+UTEST_F(c_pool, Runs) {
+  struct utest_pool_s *const pool = &utest_fixture->pool;
+  struct sigaction ignore;
+  struct sigaction before;
+  struct sigaction after;
+  int result = UTEST_TEST_FAILURE;
+
+  /* the pool puts back how SIGPIPE was handled, rather than the default */
+  memset(&ignore, 0, sizeof(ignore));
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset(&ignore.sa_mask);
+  ASSERT_EQ(0, sigaction(SIGPIPE, &ignore, &before));
+
+  if (0 != utest_pool_start(pool, 1, 0)) {
+    sigaction(SIGPIPE, &before, UTEST_NULL);
+    UTEST_SKIP("worker processes need fork()");
+  }
+
+  c_pool_running = pool;
+  c_pool_run("c.ASSERT_TRUE", &result);
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 0), utest_pool_shutdown(pool));
+
+  ASSERT_EQ(0, sigaction(SIGPIPE, &before, &after));
+  EXPECT_TRUE(SIG_IGN == after.sa_handler);
+}
+
+UTEST_F(c_pool, ReplacesCrashedWorker) {
+  struct utest_pool_s *const pool = &utest_fixture->pool;
+  int result = UTEST_TEST_FAILURE;
+  int started;
+  int pid;
+
+  /* the worker is forked with the environment that has pool_exits.test exit */
+  setenv("UTEST_CMDLINE_TEST", "exit", 1);
+  started = utest_pool_start(pool, 1, 0);
+  unsetenv("UTEST_CMDLINE_TEST");
+
+  if (0 != started) {
+    UTEST_SKIP("worker processes need fork()");
+  }
+
+  pid = pool->workers[0].pid;
+  c_pool_running = pool;
+  EXPECT_FAILURE(&c_pool_run_exit,
+                 "Worker : test process exited with code 3");
+
+  /* the crashed test took as long as the runner waited on it, not 0ns */
+  EXPECT_LT(UTEST_CAST(utest_int64_t, 0), c_pool_ns);
+  ASSERT_LT(0, pool->workers[0].pid);
+  EXPECT_NE(pid, pool->workers[0].pid);
+  EXPECT_FALSE(pool->workers[0].busy);
+
+  c_pool_run("c.ASSERT_TRUE", &result);
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+}
+
+UTEST_F(c_pool, RecyclesAfter) {
+  struct utest_pool_s *const pool = &utest_fixture->pool;
+  int result = UTEST_TEST_FAILURE;
+  int pid;
+
+  if (0 != utest_pool_start(pool, 1, 2)) {
+    UTEST_SKIP("worker processes need fork()");
+  }
+
+  pid = pool->workers[0].pid;
+  c_pool_running = pool;
+
+  c_pool_run("c.ASSERT_TRUE", &result);
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  EXPECT_EQ(pid, pool->workers[0].pid);
+
+  /* the second test is as many as the worker runs before it is replaced */
+  c_pool_run("c.ASSERT_TRUE", &result);
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  ASSERT_LT(0, pool->workers[0].pid);
+  EXPECT_NE(pid, pool->workers[0].pid);
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 0), pool->workers[0].tests);
+}
+
+UTEST_F(c_pool, LeavesUnreplacedWorkerDead) {
+  struct utest_pool_s *const pool = &utest_fixture->pool;
+  struct rlimit files;
+  struct rlimit none;
+  int result = UTEST_TEST_FAILURE;
+
+  if (0 != utest_pool_start(pool, 1, 1)) {
+    UTEST_SKIP("worker processes need fork()");
+  }
+
+  /* with no file descriptors to spare, the recycled worker can't be replaced */
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &files));
+  none = files;
+  none.rlim_cur = 3;
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &none));
+  c_pool_running = pool;
+  utest_state.quiet++;
+  c_pool_run("c.ASSERT_TRUE", &result);
+  utest_state.quiet--;
+  setrlimit(RLIMIT_NOFILE, &files);
+
+  EXPECT_EQ(UTEST_TEST_PASSED, result);
+  EXPECT_EQ(-1, pool->workers[0].pid);
+  EXPECT_FALSE(pool->workers[0].busy);
+  EXPECT_EQ(UTEST_CAST(size_t, 0), utest_pool_live(pool));
+  EXPECT_TRUE(UTEST_NULL == utest_pool_idle(pool));
+  EXPECT_TRUE(UTEST_NULL == utest_pool_wait(pool));
+}
+#endif
+
+UTEST(c, PoolSchedulesBySet) {
+  struct utest_pool_worker_s workers[2];
+  size_t queue[4];
+  size_t scratch[8];
+  struct utest_pool_s pool;
+  size_t index = 0;
+
+  memset(workers, 0, sizeof(workers));
+  memset(&pool, 0, sizeof(pool));
+  pool.workers = workers;
+  pool.length = 2;
+  pool.queue = queue;
+  pool.scratch = scratch;
+  pool.queued = 4;
+  queue[0] = c_test_index("c.ASSERT_TRUE");
+  queue[1] = c_test_index("MyTestF.c");
+  queue[2] = c_test_index("c.ASSERT_FALSE");
+  queue[3] = c_test_index("MyTestF.c2");
+
+  utest_pool_schedule(&pool);
+
+  /* each set is kept together on one worker, in the order it was queued */
+  ASSERT_EQ(0, utest_pool_next(&pool, &workers[0], &index));
+  EXPECT_STREQ("c.ASSERT_TRUE", utest_state.tests[index].name);
+  ASSERT_EQ(0, utest_pool_next(&pool, &workers[0], &index));
+  EXPECT_STREQ("c.ASSERT_FALSE", utest_state.tests[index].name);
+  ASSERT_EQ(0, utest_pool_next(&pool, &workers[1], &index));
+  EXPECT_STREQ("MyTestF.c", utest_state.tests[index].name);
+
+  /* an idle worker steals from the tail of another's deque */
+  ASSERT_EQ(0, utest_pool_next(&pool, &workers[0], &index));
+  EXPECT_STREQ("MyTestF.c2", utest_state.tests[index].name);
+  EXPECT_NE(0, utest_pool_next(&pool, &workers[1], &index));
+}
+
+static int c_death_which = 0;
+
+static void c_death_fails(int *utest_result) {
+  switch (c_death_which) {
+  case 0:
+    EXPECT_DEATH((void)0, "");
+    break;
+  case 1:
+    EXPECT_DEATH(exit(0), "");
+    break;
+  case 2:
+    EXPECT_DEATH(c_corrupted(), "^stack");
+    break;
+  case 3:
+    EXPECT_DEATH(exit(1), "a[");
+    break;
+  default:
+    EXPECT_EXIT(exit(2), UTEST_EXITED_WITH_CODE(3), "");
+    break;
+  }
+}
+
+static void c_death_in_helper(int *utest_result) {
+  EXPECT_DEATH(ASSERT_TRUE(0), "kept running");
+}
+
+static void c_death_returns(int *utest_result) {
+  c_death_in_helper(utest_result);
+
+  /* only a child that ran on past its statement gets here */
+  if (utest_state.death_child) {
+    fprintf(stderr, "kept running\n");
+  }
+}
+
+UTEST(c, DeathFails) {
+  const char *const texts[] = {"Actual : returned", "exited with code 0",
+                               "stderr matching '^stack'",
+                               "'a[' is not a valid extended regex",
+                               "to exit with code 3"};
+
+#if !defined(UTEST_HAS_FORK)
+  UTEST_SKIP("death tests need fork()");
+#endif
+
+  for (c_death_which = 0; c_death_which < 5; c_death_which++) {
+    EXPECT_FAILURE(&c_death_fails, texts[c_death_which]);
+  }
+
+  /* a death test whose statement is a failed ASSERT ends its child there */
+  EXPECT_FAILURE(&c_death_returns, "stderr matching 'kept running'");
+}
+
+UTEST(c, Selected) {
+  EXPECT_TRUE(utest_selected(UTEST_NULL, UTEST_NULL, "foo.bar"));
+  EXPECT_TRUE(utest_selected("foo.*", UTEST_NULL, "foo.bar"));
+  EXPECT_FALSE(utest_selected("foo.baz", UTEST_NULL, "foo.bar"));
+  EXPECT_TRUE(utest_selected(UTEST_NULL, "foo.bar\n", "foo.bar"));
+  EXPECT_FALSE(utest_selected(UTEST_NULL, "foo.baz\n", "foo.bar"));
+}
+
+UTEST(c, CacheMark) {
+  const size_t size = strlen(utest_state.tests[1].name) + 16;
+  char *const list = UTEST_PTR_CAST(char *, malloc(size));
+  unsigned char *const marks = UTEST_PTR_CAST(
+      unsigned char *, calloc(utest_state.tests_length, 1));
+  ASSERT_TRUE(list);
+  ASSERT_TRUE(marks);
+  UTEST_SNPRINTF(list, size, "not.a.test\n%s\n", utest_state.tests[1].name);
+  utest_cache_mark(list, marks);
+  EXPECT_FALSE(marks[0]);
+  EXPECT_TRUE(marks[1]);
+  free(list);
+  free(marks);
+}
+
+UTEST(c, CacheHash) {
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 0xcbf29ce484222325u),
+            utest_fnv1a(UTEST_NULL, 0));
+  EXPECT_EQ(UTEST_CAST(utest_uint64_t, 0xaf63dc4c8601ec8cu),
+            utest_fnv1a(UTEST_PTR_CAST(const unsigned char *, "a"), 1));
+}
+
 UTEST(c, Float) {
   float a = 1;
   float b = 2;
@@ -25,6 +25,8 @@
 
 #include "utest.h"
 
+#include <thread>
+
 #ifdef _MSC_VER
 // disable 'conditional expression is constant' - our examples below use this!
 #pragma warning(disable : 4127)
@@ -265,6 +267,37 @@ UTEST(cpp11, Near) {
   ASSERT_NEAR(a, b, 0.01f);
 }
 
+template <typename T> struct MyTypedPair {
+  T first;
+  T second;
+};
+
+UTEST_TYPED(cpp11, Typed, signed char, int, long long, float, double,
+            MyTypedPair<int>) {
+  utest_type a = utest_type();
+  utest_type b = utest_type();
+  ASSERT_EQ(0, memcmp(&a, &b, sizeof(utest_type)));
+}
+
+UTEST(cpp11, TypedNames) {
+  const char *const expected[] = {
+      "cpp11.Typed<signed char>", "cpp11.Typed<int>",
+      "cpp11.Typed<long long>",   "cpp11.Typed<float>",
+      "cpp11.Typed<double>",      "cpp11.Typed<MyTypedPair<int>>"};
+  size_t found = 0;
+
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    for (size_t k = 0; k < utest_state.tests_length; k++) {
+      if (0 == strcmp(expected[i], utest_state.tests[k].name)) {
+        found++;
+        break;
+      }
+    }
+  }
+
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), found);
+}
+
 // GCC stdlib has a sanitizer bug in exceptions!
 #if defined(__has_feature)
 #if __has_feature(memory_sanitizer)
@@ -316,3 +349,62 @@ UTEST(cpp11, EnumClass) {
 #pragma clang diagnostic pop
 #endif
 #endif
+
+static void cpp11_check_in_threads(int *utest_result, int expected) {
+  std::thread workers[4];
+
+  for (std::thread &worker : workers) {
+    worker = std::thread([utest_result, expected]() {
+      for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(expected, i - i);
+      }
+    });
+  }
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+UTEST(cpp11, AssertionsFromThreads) {
+  cpp11_check_in_threads(utest_result, 0);
+  ASSERT_EQ(4000u, utest_threads_collect());
+}
+
+UTEST(cpp11, DetachedThreadsAreFreed) {
+  std::thread workers[4];
+  size_t exited = 0;
+
+  for (std::thread &worker : workers) {
+    worker = std::thread([utest_result]() {
+      EXPECT_TRUE(1);
+      utest_thread_detach();
+    });
+  }
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  for (struct utest_thread_s *thread = utest_state.exited_threads;
+       UTEST_NULL != thread; thread = thread->next) {
+    exited++;
+  }
+
+  ASSERT_EQ(4u, exited);
+  // the four threads' checks and the one above
+  ASSERT_EQ(5u, utest_threads_collect());
+  ASSERT_TRUE(UTEST_NULL == utest_state.exited_threads);
+}
+
+UTEST(cpp11, FailuresFromThreads) {
+  int result = UTEST_TEST_PASSED;
+  const utest_uint64_t max = utest_state.max_failures_per_test;
+  utest_state.max_failures_per_test = 1;
+  cpp11_check_in_threads(&result, 1);
+  utest_state.quiet++;
+  utest_threads_collect();
+  utest_state.quiet--;
+  utest_state.max_failures_per_test = max;
+  ASSERT_EQ(UTEST_TEST_FAILURE, result);
+}
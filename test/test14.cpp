@@ -265,6 +265,37 @@ UTEST(cpp14, Near) {
   ASSERT_NEAR(a, b, 0.01f);
 }
 
+template <typename T> struct MyTypedPair {
+  T first;
+  T second;
+};
+
+UTEST_TYPED(cpp14, Typed, signed char, int, long long, float, double,
+            MyTypedPair<int>) {
+  utest_type a = utest_type();
+  utest_type b = utest_type();
+  ASSERT_EQ(0, memcmp(&a, &b, sizeof(utest_type)));
+}
+
+UTEST(cpp14, TypedNames) {
+  const char *const expected[] = {
+      "cpp14.Typed<signed char>", "cpp14.Typed<int>",
+      "cpp14.Typed<long long>",   "cpp14.Typed<float>",
+      "cpp14.Typed<double>",      "cpp14.Typed<MyTypedPair<int>>"};
+  size_t found = 0;
+
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    for (size_t k = 0; k < utest_state.tests_length; k++) {
+      if (0 == strcmp(expected[i], utest_state.tests[k].name)) {
+        found++;
+        break;
+      }
+    }
+  }
+
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), found);
+}
+
 // GCC stdlib has a sanitizer bug in exceptions!
 #if defined(__has_feature)
 #if __has_feature(memory_sanitizer)
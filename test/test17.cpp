@@ -265,6 +265,37 @@ UTEST(cpp17, Near) {
   ASSERT_NEAR(a, b, 0.01f);
 }
 
+template <typename T> struct MyTypedPair {
+  T first;
+  T second;
+};
+
+UTEST_TYPED(cpp17, Typed, signed char, int, long long, float, double,
+            MyTypedPair<int>) {
+  utest_type a = utest_type();
+  utest_type b = utest_type();
+  ASSERT_EQ(0, memcmp(&a, &b, sizeof(utest_type)));
+}
+
+UTEST(cpp17, TypedNames) {
+  const char *const expected[] = {
+      "cpp17.Typed<signed char>", "cpp17.Typed<int>",
+      "cpp17.Typed<long long>",   "cpp17.Typed<float>",
+      "cpp17.Typed<double>",      "cpp17.Typed<MyTypedPair<int>>"};
+  size_t found = 0;
+
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    for (size_t k = 0; k < utest_state.tests_length; k++) {
+      if (0 == strcmp(expected[i], utest_state.tests[k].name)) {
+        found++;
+        break;
+      }
+    }
+  }
+
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), found);
+}
+
 // GCC stdlib has a sanitizer bug in exceptions!
 #if defined(__has_feature)
 #if __has_feature(memory_sanitizer)
@@ -93,6 +93,7 @@ typedef uint64_t utest_uint64_t;
 typedef uint32_t utest_uint32_t;
 #endif
 
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -143,6 +144,7 @@ typedef uint32_t utest_uint32_t;
 
 #if defined(_WINDOWS_) || defined(_WINDOWS_H)
 typedef LARGE_INTEGER utest_large_integer;
+typedef DWORD_PTR utest_affinity_mask;
 #else
 // use old QueryPerformanceCounter definitions (not sure is this needed in some
 // edge cases or not) on Win7 with VS2015 these extern declaration cause "second
@@ -164,6 +166,23 @@ UTEST_C_FUNC __declspec(dllimport) int __stdcall QueryPerformanceCounter(
 UTEST_C_FUNC __declspec(dllimport) int __stdcall QueryPerformanceFrequency(
     utest_large_integer *);
 
+/* the thread functions that UTEST_STRESS uses */
+#if defined(_WIN64)
+typedef unsigned __int64 utest_affinity_mask;
+#else
+typedef unsigned long utest_affinity_mask;
+#endif
+UTEST_C_FUNC __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(
+    void *, unsigned long);
+UTEST_C_FUNC __declspec(dllimport) int __stdcall CloseHandle(void *);
+UTEST_C_FUNC __declspec(dllimport) int __stdcall SwitchToThread(void);
+UTEST_C_FUNC __declspec(dllimport) void *__stdcall GetCurrentThread(void);
+UTEST_C_FUNC __declspec(dllimport) utest_affinity_mask __stdcall
+SetThreadAffinityMask(void *, utest_affinity_mask);
+UTEST_C_FUNC __declspec(dllimport) unsigned long __stdcall
+GetActiveProcessorCount(unsigned short);
+UTEST_C_FUNC __declspec(dllimport) int __stdcall SetThreadPriority(void *, int);
+
 #if defined(__MINGW64__) || defined(__MINGW32__)
 #pragma GCC diagnostic pop
 #endif
@@ -304,6 +323,7 @@ UTEST_C_FUNC __declspec(dllimport) int __stdcall QueryPerformanceFrequency(
 */
 #pragma warning(disable : 4820)
 #pragma warning(push, 1)
+#include <direct.h>
 #include <io.h>
 #pragma warning(pop)
 #define UTEST_COLOUR_OUTPUT() (_isatty(_fileno(stdout)))
@@ -317,6 +337,15 @@ UTEST_C_FUNC __declspec(dllimport) int __stdcall QueryPerformanceFrequency(
 #endif
 #endif
 
+#if !defined(_MSC_VER) && !defined(__EMSCRIPTEN__) &&                          \
+    (defined(__unix__) || defined(__APPLE__) || defined(__HAIKU__))
+#define UTEST_HAS_FORK
+#define UTEST_HAS_MMAP
+#elif defined(__MINGW32__) || defined(__MINGW64__)
+#include <direct.h>
+#include <io.h>
+#endif
+
 static UTEST_INLINE void *utest_realloc(void *const pointer, size_t new_size) {
   void *const new_pointer = realloc(pointer, new_size);
 
@@ -362,6 +391,19 @@ static UTEST_INLINE utest_int64_t utest_ns(void) {
 #endif
 }
 
+/*
+   the PCG random number generator - used both to randomize the test order and
+   to generate inputs for property tests. Returns the next number in the
+   sequence, and moves the state onwards.
+*/
+static UTEST_INLINE utest_uint32_t utest_random(utest_uint32_t *const state) {
+  const utest_uint32_t current = *state;
+  const utest_uint32_t word =
+      ((current >> ((current >> 28u) + 4u)) ^ current) * 277803737u;
+  *state = current * 747796405u + 2891336453u;
+  return (word >> 22u) ^ word;
+}
+
 typedef void (*utest_testcase_t)(int *, size_t);
 
 struct utest_test_state_s {
@@ -370,10 +412,119 @@ struct utest_test_state_s {
   char *name;
 };
 
+typedef void (*utest_fixture_hook_t)(int *, void *);
+
+/*
+   a fixture that declared a UTEST_F_RESET hook is built once and then kept in
+   a pool slot, being reset (rather than torn down and set up) between tests.
+   A fixture declared with UTEST_F_SNAPSHOT is pooled too, but has no reset
+   hook as each test runs against a forked copy of it instead.
+*/
+struct utest_fixture_pool_s {
+  const char *name;
+  const char *file;
+  void *fixture;
+  size_t size;
+  utest_fixture_hook_t setup;
+  utest_fixture_hook_t teardown;
+  utest_fixture_hook_t reset;
+};
+
+typedef void (*utest_fuzz_body_t)(int *, const unsigned char *, size_t);
+
+struct utest_fuzz_target_s {
+  const char *name;
+  utest_fuzz_body_t body;
+};
+
+/*
+   the assertion context of one thread: the assertions it has checked for the
+   running test, and the failures it reported that are waiting to be merged
+   into the test's output (when it isn't the thread running the tests).
+*/
+struct utest_thread_s {
+  struct utest_thread_s *next;
+  char *output;
+  size_t output_length;
+  size_t output_capacity;
+  /* the worker and iteration of the UTEST_STRESS body the thread is running */
+  size_t stress_thread;
+  size_t stress_iteration;
+  utest_uint64_t assertions_checked;
+  int buffered;
+  int id;
+};
+
 struct utest_state_s {
   struct utest_test_state_s *tests;
   size_t tests_length;
   FILE *output;
+  struct utest_fixture_pool_s *fixture_pools;
+  size_t fixture_pools_length;
+  /* set in a forked child that is running a test against a snapshot */
+  struct utest_fixture_pool_s *snapshot;
+  struct utest_fuzz_target_s *fuzz_targets;
+  size_t fuzz_targets_length;
+  /* the directory holding a sub-directory of seeds for each UTEST_FUZZ */
+  const char *fuzz_corpus;
+  /* the files that UTEST_DATA tests run over, indexed by the test's index */
+  char **data_paths;
+  size_t data_paths_length;
+  /* the name of the running test, that its snapshot files are named after */
+  const char *current_test;
+  /* the result of the running test, that assertions_failed counts against */
+  int *current_result;
+  /* the directory golden files are kept in (see EXPECT_MATCHES_SNAPSHOT) */
+  const char *snapshot_dir;
+  /* how many snapshots the running test has checked so far */
+  int snapshots_taken;
+  /* when set, mismatched or missing golden files are (re)written */
+  int update_snapshots;
+  /* options for UTEST_PROPERTY tests, set from the command line */
+  utest_uint64_t property_seed;
+  utest_int64_t property_time_ns;
+  size_t property_runs;
+  /* how many assertions of the running test failed, across all its threads */
+  utest_uint64_t assertions_failed;
+  /* the failures of a test past this many aren't printed (0 for no limit) */
+  utest_uint64_t max_failures_per_test;
+  /* the assertion context of every thread that has checked an assertion */
+  struct utest_thread_s *threads;
+  /* the contexts of threads that have exited, freed once they are collected */
+  struct utest_thread_s *exited_threads;
+  /* the results of the tests so far, that the crash handler reports */
+  struct utest_repeat_s *repeats;
+  /* the thread counts that --scaling reruns every stress test at */
+  size_t *scaling;
+  size_t scaling_length;
+  /* the <property/> elements the running test recorded for the XML output */
+  char *properties;
+  size_t properties_length;
+  size_t properties_capacity;
+  int property_seeded;
+  /* when set, UTEST_PRINTF output is swallowed */
+  int quiet;
+  /* a spin lock that guards threads and exited_threads */
+  int threads_lock;
+  int threads_length;
+  /* options for UTEST_STRESS tests, set from the command line */
+  int stress_threads;
+  int pin_threads;
+  /* the CPU that --pin-cpu pinned the tests to, or -1 */
+  int pin_cpu;
+  /* when set, stress tests are warmed up before they are measured */
+  int isolate_noise;
+  /* set in a forked child that is running the statement of a death test */
+  int death_child;
+  /*
+     the pipe a forked child reports back to its parent through - how a death
+     test's statement finished, or the counts of a test run against a snapshot
+  */
+  int child_pipe;
+  /* the file descriptor the crash handler closes the XML output on, or -1 */
+  int crash_output;
+  /* set once the crash handler is running, in case it crashes too */
+  int crashed;
 };
 
 /* extern to the global state utest needs to execute */
@@ -395,16 +546,113 @@ UTEST_EXTERN struct utest_state_s utest_state;
 #define UTEST_UNUSED UTEST_ATTRIBUTE(unused)
 #endif
 
+#if defined(_MSC_VER) || defined(__TINYC__)
+#define UTEST_COLD
+#define UTEST_UNLIKELY(x) (x)
+#else
+#define UTEST_COLD UTEST_ATTRIBUTE(noinline) UTEST_ATTRIBUTE(cold)
+#define UTEST_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#endif
+
+/*
+   assertions can be checked from threads that a test spawns, so each thread
+   has its own assertion context, and the little state they share is updated
+   atomically (or under a spin lock). tcc has neither thread locals nor atomics,
+   so there assertions are only safe to use from the thread running the test.
+*/
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define UTEST_THREAD_LOCAL __declspec(thread)
+#elif defined(__TINYC__)
+#define UTEST_THREAD_LOCAL
+#else
+#define UTEST_THREAD_LOCAL __thread
+#endif
+
+/* the assertion context of the calling thread, null until it first asserts */
+UTEST_EXTERN UTEST_THREAD_LOCAL struct utest_thread_s *utest_thread;
+
+static UTEST_INLINE void utest_set_result(int *const result, const int value) {
+#if defined(_MSC_VER)
+  _InterlockedExchange(UTEST_PTR_CAST(long volatile *, result), value);
+#elif defined(__TINYC__)
+  *result = value;
+#else
+  __atomic_store_n(result, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static UTEST_INLINE int utest_atomic_load(int *const value) {
+#if defined(_MSC_VER)
+  return _InterlockedCompareExchange(UTEST_PTR_CAST(long volatile *, value), 0,
+                                     0);
+#elif defined(__TINYC__)
+  return *value;
+#else
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static UTEST_INLINE void utest_atomic_increment(int *const value) {
+#if defined(_MSC_VER)
+  _InterlockedIncrement(UTEST_PTR_CAST(long volatile *, value));
+#elif defined(__TINYC__)
+  *value += 1;
+#else
+  __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static UTEST_INLINE utest_uint64_t
+utest_atomic_increment64(utest_uint64_t *const value) {
+#if defined(_MSC_VER)
+  return UTEST_CAST(utest_uint64_t,
+                    _InterlockedIncrement64(
+                        UTEST_PTR_CAST(__int64 volatile *, value)));
+#elif defined(__TINYC__)
+  return ++*value;
+#else
+  return __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static UTEST_INLINE void utest_lock(int *const lock) {
+#if defined(_MSC_VER)
+  while (_InterlockedExchange(UTEST_PTR_CAST(long volatile *, lock), 1)) {
+  }
+#elif defined(__TINYC__)
+  *lock = 1;
+#else
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+  }
+#endif
+}
+
+static UTEST_INLINE void utest_unlock(int *const lock) {
+#if defined(_MSC_VER)
+  _InterlockedExchange(UTEST_PTR_CAST(long volatile *, lock), 0);
+#elif defined(__TINYC__)
+  *lock = 0;
+#else
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+#endif
+}
+
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wvariadic-macros"
 #pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
 #endif
 #define UTEST_PRINTF(...)                                                      \
-  if (utest_state.output) {                                                    \
-    fprintf(utest_state.output, __VA_ARGS__);                                  \
-  }                                                                            \
-  printf(__VA_ARGS__)
+  if (utest_state.quiet) {                                                     \
+  } else if (UTEST_NULL != utest_thread && utest_thread->buffered) {           \
+    utest_thread_printf(__VA_ARGS__);                                          \
+  } else {                                                                     \
+    if (utest_state.output) {                                                  \
+      fprintf(utest_state.output, __VA_ARGS__);                                \
+    }                                                                          \
+    printf(__VA_ARGS__);                                                       \
+  }
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
@@ -425,6 +673,239 @@ UTEST_EXTERN struct utest_state_s utest_state;
 #pragma clang diagnostic pop
 #endif
 
+/*
+   give the calling thread an assertion context. The first thread to get one is
+   the thread running the tests, which prints failures as they happen. Any other
+   thread buffers its output, until the test it is running for finishes and
+   utest_threads_collect merges it into the test's output.
+*/
+UTEST_WEAK UTEST_COLD struct utest_thread_s *utest_thread_attach(void);
+UTEST_WEAK UTEST_COLD struct utest_thread_s *utest_thread_attach(void) {
+  struct utest_thread_s *const thread = UTEST_PTR_CAST(
+      struct utest_thread_s *, calloc(1, sizeof(struct utest_thread_s)));
+
+  if (UTEST_NULL == thread) {
+    fprintf(stderr, "utest.h: out of memory for a thread's assertions\n");
+    abort();
+  }
+
+  utest_lock(&utest_state.threads_lock);
+  thread->buffered = (UTEST_NULL != utest_state.threads);
+  thread->id = utest_state.threads_length++;
+  thread->next = utest_state.threads;
+  utest_state.threads = thread;
+  utest_unlock(&utest_state.threads_lock);
+
+  utest_thread = thread;
+  return thread;
+}
+
+/*
+   give up the calling thread's assertion context, once the thread has finished
+   asserting. What it checked and printed is still collected with the test it
+   ran for, after which the context is freed.
+*/
+UTEST_WEAK void utest_thread_detach(void);
+UTEST_WEAK void utest_thread_detach(void) {
+  struct utest_thread_s *const thread = utest_thread;
+  struct utest_thread_s **link;
+
+  if (UTEST_NULL == thread) {
+    return;
+  }
+
+  utest_lock(&utest_state.threads_lock);
+  for (link = &utest_state.threads; UTEST_NULL != *link;
+       link = &(*link)->next) {
+    if (thread == *link) {
+      *link = thread->next;
+      break;
+    }
+  }
+  thread->next = utest_state.exited_threads;
+  utest_state.exited_threads = thread;
+  utest_unlock(&utest_state.threads_lock);
+
+  utest_thread = UTEST_NULL;
+}
+
+static UTEST_INLINE struct utest_thread_s *utest_thread_context(void) {
+  return UTEST_UNLIKELY(UTEST_NULL == utest_thread) ? utest_thread_attach()
+                                                     : utest_thread;
+}
+
+#if defined(__clang__) || defined(__GNUC__)
+#define UTEST_PRINTF_FORMAT UTEST_ATTRIBUTE(format(printf, 1, 2))
+#else
+#define UTEST_PRINTF_FORMAT
+#endif
+
+/* UTEST_PRINTF on a thread that buffers its output appends to the buffer */
+UTEST_WEAK UTEST_PRINTF_FORMAT void utest_thread_printf(const char *format,
+                                                        ...);
+UTEST_WEAK UTEST_PRINTF_FORMAT void utest_thread_printf(const char *format,
+                                                        ...) {
+  struct utest_thread_s *const thread = utest_thread_context();
+  char line[1024];
+  size_t length;
+  va_list args;
+
+  va_start(args, format);
+#ifdef _MSC_VER
+  _vsnprintf_s(line, sizeof(line), _TRUNCATE, format, args);
+#else
+  vsnprintf(line, sizeof(line), format, args);
+#endif
+  va_end(args);
+
+  length = strlen(line);
+
+  if (thread->output_length + length + 1 > thread->output_capacity) {
+    const size_t capacity = 2 * (thread->output_length + length + 1);
+    char *const output =
+        UTEST_PTR_CAST(char *, realloc(thread->output, capacity));
+
+    if (UTEST_NULL == output) {
+      return;
+    }
+
+    thread->output = output;
+    thread->output_capacity = capacity;
+  }
+
+  memcpy(thread->output + thread->output_length, line, length + 1);
+  thread->output_length += length;
+}
+
+/*
+   once a test (and every thread it started) has finished, print the output its
+   threads buffered, and return how many assertions they checked altogether.
+*/
+UTEST_WEAK utest_uint64_t utest_threads_collect(void);
+UTEST_WEAK utest_uint64_t utest_threads_collect(void) {
+  struct utest_thread_s *thread;
+  struct utest_thread_s *next;
+  utest_uint64_t checked = 0;
+  int exited;
+
+  utest_lock(&utest_state.threads_lock);
+  for (exited = 0; exited < 2; exited++) {
+    for (thread = exited ? utest_state.exited_threads : utest_state.threads;
+         UTEST_NULL != thread; thread = next) {
+      next = thread->next;
+      checked += thread->assertions_checked;
+      thread->assertions_checked = 0;
+
+      if (0 < thread->output_length) {
+        if (!utest_state.quiet) {
+          if (utest_state.output) {
+            fprintf(utest_state.output, "    Thread : %d\n%s", thread->id,
+                    thread->output);
+          }
+          printf("    Thread : %d\n%s", thread->id, thread->output);
+        }
+        thread->output_length = 0;
+      }
+
+      if (exited) {
+        free(thread->output);
+        free(thread);
+      }
+    }
+  }
+  utest_state.exited_threads = UTEST_NULL;
+  utest_unlock(&utest_state.threads_lock);
+
+  return checked;
+}
+
+/* make room for length more bytes of properties, returning non-zero if not */
+static UTEST_INLINE int utest_properties_reserve(const size_t length) {
+  if (utest_state.properties_length + length + 1 >
+      utest_state.properties_capacity) {
+    const size_t capacity = 2 * (utest_state.properties_length + length + 1);
+    char *const properties =
+        UTEST_PTR_CAST(char *, realloc(utest_state.properties, capacity));
+
+    if (UTEST_NULL == properties) {
+      return 1;
+    }
+
+    utest_state.properties = properties;
+    utest_state.properties_capacity = capacity;
+  }
+
+  return 0;
+}
+
+/*
+   append text to the properties, escaping (if asked to) the characters that
+   can't appear in an XML attribute value. There must be room for the text to
+   grow six-fold.
+*/
+static UTEST_INLINE void utest_properties_append(const char *text,
+                                                 const int escape) {
+  char *out = utest_state.properties + utest_state.properties_length;
+
+  for (; '\0' != *text; text++) {
+    const char *entity;
+
+    switch (*text) {
+    default:
+      entity = UTEST_NULL;
+      break;
+    case '"':
+      entity = "&quot;";
+      break;
+    case '\'':
+      entity = "&apos;";
+      break;
+    case '&':
+      entity = "&amp;";
+      break;
+    case '<':
+      entity = "&lt;";
+      break;
+    case '>':
+      entity = "&gt;";
+      break;
+    }
+
+    if (!escape || (UTEST_NULL == entity)) {
+      *out++ = *text;
+    } else {
+      memcpy(out, entity, strlen(entity));
+      out += strlen(entity);
+    }
+  }
+
+  *out = '\0';
+  utest_state.properties_length =
+      UTEST_CAST(size_t, out - utest_state.properties);
+}
+
+/*
+   record a property of the running test, that is written out with it to the
+   --output XML file. The name and value are escaped as they are recorded.
+*/
+UTEST_WEAK void utest_record_property(const char *name, const char *value);
+UTEST_WEAK void utest_record_property(const char *name, const char *value) {
+  if (UTEST_NULL == utest_state.output) {
+    return;
+  }
+
+  if (0 != utest_properties_reserve(
+               32 + 6 * (strlen(name) + strlen(value)))) {
+    return;
+  }
+
+  utest_properties_append("<property name=\"", 0);
+  utest_properties_append(name, 1);
+  utest_properties_append("\" value=\"", 0);
+  utest_properties_append(value, 1);
+  utest_properties_append("\"/>", 0);
+}
+
 #if defined(__cplusplus)
 /* if we are using c++ we can use overloaded methods (its in the language) */
 #define UTEST_OVERLOADABLE
@@ -652,684 +1133,6663 @@ utest_type_printer(long long unsigned int i) {
 #define utest_type_printer(...) UTEST_PRINTF("undef")
 #endif
 
-#if defined(_MSC_VER)
-#define UTEST_SURPRESS_WARNING_BEGIN                                           \
-  __pragma(warning(push)) __pragma(warning(disable : 4127))                    \
-      __pragma(warning(disable : 4571)) __pragma(warning(disable : 4130))
-#define UTEST_SURPRESS_WARNING_END __pragma(warning(pop))
-#else
-#define UTEST_SURPRESS_WARNING_BEGIN
-#define UTEST_SURPRESS_WARNING_END
-#endif
+/*
+   the values an assertion compared, with their types erased so that the code
+   that reports a failure can live in one (cold) function out of line, rather
+   than being expanded into the caller at every assertion.
+*/
+#define UTEST_VALUE_UNDEF (0)
+#define UTEST_VALUE_SIGNED (1)
+#define UTEST_VALUE_UNSIGNED (2)
+#define UTEST_VALUE_DOUBLE (3)
+#define UTEST_VALUE_POINTER (4)
+#define UTEST_VALUE_LONG_DOUBLE (5)
 
-#if defined(__cplusplus) && (__cplusplus >= 201103L)
-#define UTEST_AUTO(x) auto
-#elif !defined(__cplusplus)
+/*
+   a long double is kept out of the union, as gcc warns that the ABI of passing
+   a union holding one changed (and first, so that the struct isn't padded).
+*/
+struct utest_value_s {
+  long double ld;
+  union {
+    utest_int64_t i;
+    utest_uint64_t u;
+    double d;
+    const void *p;
+  } as;
+  utest_uint64_t kind;
+};
 
-#if defined(__clang__)
-/* clang-format off */
-/* had to disable clang-format here because it malforms the pragmas */
-#define UTEST_AUTO(x)                                                          \
-  _Pragma("clang diagnostic push")                                             \
-      _Pragma("clang diagnostic ignored \"-Wgnu-auto-type\"") __auto_type      \
-          _Pragma("clang diagnostic pop")
-/* clang-format on */
-#else
-#define UTEST_AUTO(x) __typeof__(x + 0)
-#endif
+static UTEST_INLINE struct utest_value_s utest_value_undef(void) {
+  struct utest_value_s value;
+  value.as.u = 0;
+  value.kind = UTEST_VALUE_UNDEF;
+  return value;
+}
 
-#else
-#define UTEST_AUTO(x) typeof(x + 0)
-#endif
+static UTEST_INLINE struct utest_value_s utest_value_signed(utest_int64_t i) {
+  struct utest_value_s value;
+  value.as.i = i;
+  value.kind = UTEST_VALUE_SIGNED;
+  return value;
+}
 
-#if defined(__clang__)
-#define UTEST_STRNCMP(x, y, size)                                              \
-  _Pragma("clang diagnostic push")                                             \
-      _Pragma("clang diagnostic ignored \"-Wdisabled-macro-expansion\"")       \
-          strncmp(x, y, size) _Pragma("clang diagnostic pop")
-#else
-#define UTEST_STRNCMP(x, y, size) strncmp(x, y, size)
-#endif
+static UTEST_INLINE struct utest_value_s
+utest_value_unsigned(utest_uint64_t u) {
+  struct utest_value_s value;
+  value.as.u = u;
+  value.kind = UTEST_VALUE_UNSIGNED;
+  return value;
+}
 
-#if defined(_MSC_VER)
-#define UTEST_STRNCPY(x, y, size) strcpy_s(x, size, y)
-#elif !defined(__clang__) && defined(__GNUC__)
-static UTEST_INLINE char *
-utest_strncpy_gcc(char *const dst, const char *const src, const size_t size) {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wstringop-overflow"
-  return strncpy(dst, src, size);
-#pragma GCC diagnostic pop
+static UTEST_INLINE struct utest_value_s utest_value_double(double d) {
+  struct utest_value_s value;
+  value.as.d = d;
+  value.kind = UTEST_VALUE_DOUBLE;
+  return value;
 }
 
-#define UTEST_STRNCPY(x, y, size) utest_strncpy_gcc(x, y, size)
-#else
-#define UTEST_STRNCPY(x, y, size) strncpy(x, y, size)
-#endif
+static UTEST_INLINE struct utest_value_s
+utest_value_long_double(long double ld) {
+  struct utest_value_s value;
+  value.ld = ld;
+  value.kind = UTEST_VALUE_LONG_DOUBLE;
+  return value;
+}
 
-#define UTEST_SKIP(msg)                                                        \
-  do {                                                                         \
-    UTEST_PRINTF("   Skipped : '%s'\n", (msg));                                \
-    *utest_result = UTEST_TEST_SKIPPED;                                        \
-    return;                                                                    \
-  } while (0)
+static UTEST_INLINE struct utest_value_s utest_value_pointer(const void *p) {
+  struct utest_value_s value;
+  value.as.p = p;
+  value.kind = UTEST_VALUE_POINTER;
+  return value;
+}
 
-#if defined(__clang__)
-#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    _Pragma("clang diagnostic push")                                           \
-        _Pragma("clang diagnostic ignored \"-Wlanguage-extension-token\"")     \
-            _Pragma("clang diagnostic ignored \"-Wc++98-compat-pedantic\"")    \
-                _Pragma("clang diagnostic ignored \"-Wfloat-equal\"")          \
-                    UTEST_AUTO(x) xEval = (x);                                 \
-    UTEST_AUTO(y) yEval = (y);                                                 \
-    if (!((xEval)cond(yEval))) {                                               \
-      _Pragma("clang diagnostic pop")                                          \
-          UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                \
-      UTEST_PRINTF("  Expected : (");                                          \
-      UTEST_PRINTF(#x ") " #cond " (" #y);                                     \
-      UTEST_PRINTF(")\n");                                                     \
-      UTEST_PRINTF("    Actual : ");                                           \
-      utest_type_printer(xEval);                                               \
-      UTEST_PRINTF(" vs ");                                                    \
-      utest_type_printer(yEval);                                               \
-      UTEST_PRINTF("\n");                                                      \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
-#elif defined(__GNUC__) || defined(__TINYC__)
-#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    UTEST_AUTO(x) xEval = (x);                                                 \
-    UTEST_AUTO(y) yEval = (y);                                                 \
-    if (!((xEval)cond(yEval))) {                                               \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : (");                                          \
-      UTEST_PRINTF(#x ") " #cond " (" #y);                                     \
-      UTEST_PRINTF(")\n");                                                     \
-      UTEST_PRINTF("    Actual : ");                                           \
-      utest_type_printer(xEval);                                               \
-      UTEST_PRINTF(" vs ");                                                    \
-      utest_type_printer(yEval);                                               \
-      UTEST_PRINTF("\n");                                                      \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
-#else
-#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    if (!((x)cond(y))) {                                                       \
-      UTEST_PRINTF("%s:%i: Failure (Expected " #cond " Actual)", __FILE__,     \
-                   __LINE__);                                                  \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF(" Message : %s", msg);                                    \
-      }                                                                        \
-      UTEST_PRINTF("\n");                                                      \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
-#endif
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
 
-#define EXPECT_EQ(x, y) UTEST_COND(x, y, ==, "", 0)
-#define EXPECT_EQ_MSG(x, y, msg) UTEST_COND(x, y, ==, msg, 0)
-#define ASSERT_EQ(x, y) UTEST_COND(x, y, ==, "", 1)
-#define ASSERT_EQ_MSG(x, y, msg) UTEST_COND(x, y, ==, msg, 1)
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+#endif
 
-#define EXPECT_NE(x, y) UTEST_COND(x, y, !=, "", 0)
-#define EXPECT_NE_MSG(x, y, msg) UTEST_COND(x, y, !=, msg, 0)
-#define ASSERT_NE(x, y) UTEST_COND(x, y, !=, "", 1)
-#define ASSERT_NE_MSG(x, y, msg) UTEST_COND(x, y, !=, msg, 1)
+template <typename T, bool is_enum = std::is_enum<T>::value>
+struct utest_value_deducer final {
+  static struct utest_value_s _(const T t);
+};
 
-#define EXPECT_LT(x, y) UTEST_COND(x, y, <, "", 0)
-#define EXPECT_LT_MSG(x, y, msg) UTEST_COND(x, y, <, msg, 0)
-#define ASSERT_LT(x, y) UTEST_COND(x, y, <, "", 1)
-#define ASSERT_LT_MSG(x, y, msg) UTEST_COND(x, y, <, msg, 1)
+template <> struct utest_value_deducer<signed char, false> {
+  static struct utest_value_s _(const signed char c) {
+    return utest_value_signed(c);
+  }
+};
 
-#define EXPECT_LE(x, y) UTEST_COND(x, y, <=, "", 0)
-#define EXPECT_LE_MSG(x, y, msg) UTEST_COND(x, y, <=, msg, 0)
-#define ASSERT_LE(x, y) UTEST_COND(x, y, <=, "", 1)
-#define ASSERT_LE_MSG(x, y, msg) UTEST_COND(x, y, <=, msg, 1)
+template <> struct utest_value_deducer<unsigned char, false> {
+  static struct utest_value_s _(const unsigned char c) {
+    return utest_value_unsigned(c);
+  }
+};
 
-#define EXPECT_GT(x, y) UTEST_COND(x, y, >, "", 0)
-#define EXPECT_GT_MSG(x, y, msg) UTEST_COND(x, y, >, msg, 0)
-#define ASSERT_GT(x, y) UTEST_COND(x, y, >, "", 1)
-#define ASSERT_GT_MSG(x, y, msg) UTEST_COND(x, y, >, msg, 1)
+template <> struct utest_value_deducer<short, false> {
+  static struct utest_value_s _(const short s) {
+    return utest_value_signed(s);
+  }
+};
 
-#define EXPECT_GE(x, y) UTEST_COND(x, y, >=, "", 0)
-#define EXPECT_GE_MSG(x, y, msg) UTEST_COND(x, y, >=, msg, 0)
-#define ASSERT_GE(x, y) UTEST_COND(x, y, >=, "", 1)
-#define ASSERT_GE_MSG(x, y, msg) UTEST_COND(x, y, >=, msg, 1)
+template <> struct utest_value_deducer<unsigned short, false> {
+  static struct utest_value_s _(const unsigned short s) {
+    return utest_value_unsigned(s);
+  }
+};
 
-#define UTEST_TRUE(x, msg, is_assert)                                          \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const int xEval = !!(x);                                                   \
-    if (!(xEval)) {                                                            \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : true\n");                                     \
-      UTEST_PRINTF("    Actual : %s\n", (xEval) ? "true" : "false");           \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <> struct utest_value_deducer<float, false> {
+  static struct utest_value_s _(const float f) {
+    return utest_value_double(static_cast<double>(f));
+  }
+};
 
-#define EXPECT_TRUE(x) UTEST_TRUE(x, "", 0)
-#define EXPECT_TRUE_MSG(x, msg) UTEST_TRUE(x, msg, 0)
-#define ASSERT_TRUE(x) UTEST_TRUE(x, "", 1)
-#define ASSERT_TRUE_MSG(x, msg) UTEST_TRUE(x, msg, 1)
+template <> struct utest_value_deducer<double, false> {
+  static struct utest_value_s _(const double d) {
+    return utest_value_double(d);
+  }
+};
 
-#define UTEST_FALSE(x, msg, is_assert)                                         \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const int xEval = !!(x);                                                   \
-    if (xEval) {                                                               \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : false\n");                                    \
-      UTEST_PRINTF("    Actual : %s\n", (xEval) ? "true" : "false");           \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <> struct utest_value_deducer<long double, false> {
+  static struct utest_value_s _(const long double d) {
+    return utest_value_long_double(d);
+  }
+};
 
-#define EXPECT_FALSE(x) UTEST_FALSE(x, "", 0)
-#define EXPECT_FALSE_MSG(x, msg) UTEST_FALSE(x, msg, 0)
-#define ASSERT_FALSE(x) UTEST_FALSE(x, "", 1)
-#define ASSERT_FALSE_MSG(x, msg) UTEST_FALSE(x, msg, 1)
+template <> struct utest_value_deducer<int, false> {
+  static struct utest_value_s _(const int i) { return utest_value_signed(i); }
+};
 
-#define UTEST_STREQ(x, y, msg, is_assert)                                      \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const char *xEval = (x);                                                   \
-    const char *yEval = (y);                                                   \
-    if (UTEST_NULL == xEval || UTEST_NULL == yEval ||                          \
-        0 != strcmp(xEval, yEval)) {                                           \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : \"%s\"\n", xEval);                            \
-      UTEST_PRINTF("    Actual : \"%s\"\n", yEval);                            \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <> struct utest_value_deducer<unsigned int, false> {
+  static struct utest_value_s _(const unsigned int i) {
+    return utest_value_unsigned(i);
+  }
+};
 
-#define EXPECT_STREQ(x, y) UTEST_STREQ(x, y, "", 0)
-#define EXPECT_STREQ_MSG(x, y, msg) UTEST_STREQ(x, y, msg, 0)
-#define ASSERT_STREQ(x, y) UTEST_STREQ(x, y, "", 1)
-#define ASSERT_STREQ_MSG(x, y, msg) UTEST_STREQ(x, y, msg, 1)
+template <> struct utest_value_deducer<long, false> {
+  static struct utest_value_s _(const long i) { return utest_value_signed(i); }
+};
 
-#define UTEST_STRNE(x, y, msg, is_assert)                                      \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const char *xEval = (x);                                                   \
-    const char *yEval = (y);                                                   \
-    if (UTEST_NULL == xEval || UTEST_NULL == yEval ||                          \
-        0 == strcmp(xEval, yEval)) {                                           \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : \"%s\"\n", xEval);                            \
-      UTEST_PRINTF("    Actual : \"%s\"\n", yEval);                            \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <> struct utest_value_deducer<unsigned long, false> {
+  static struct utest_value_s _(const unsigned long i) {
+    return utest_value_unsigned(i);
+  }
+};
 
-#define EXPECT_STRNE(x, y) UTEST_STRNE(x, y, "", 0)
-#define EXPECT_STRNE_MSG(x, y, msg) UTEST_STRNE(x, y, msg, 0)
-#define ASSERT_STRNE(x, y) UTEST_STRNE(x, y, "", 1)
-#define ASSERT_STRNE_MSG(x, y, msg) UTEST_STRNE(x, y, msg, 1)
+template <> struct utest_value_deducer<long long, false> {
+  static struct utest_value_s _(const long long i) {
+    return utest_value_signed(i);
+  }
+};
 
-#define UTEST_STRNEQ(x, y, n, msg, is_assert)                                  \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const char *xEval = (x);                                                   \
-    const char *yEval = (y);                                                   \
-    const size_t nEval = UTEST_CAST(size_t, n);                                \
-    if (UTEST_NULL == xEval || UTEST_NULL == yEval ||                          \
-        0 != UTEST_STRNCMP(xEval, yEval, nEval)) {                             \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : \"%.*s\"\n", UTEST_CAST(int, nEval), xEval);  \
-      UTEST_PRINTF("    Actual : \"%.*s\"\n", UTEST_CAST(int, nEval), yEval);  \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <> struct utest_value_deducer<unsigned long long, false> {
+  static struct utest_value_s _(const unsigned long long i) {
+    return utest_value_unsigned(i);
+  }
+};
 
-#define EXPECT_STRNEQ(x, y, n) UTEST_STRNEQ(x, y, n, "", 0)
-#define EXPECT_STRNEQ_MSG(x, y, n, msg) UTEST_STRNEQ(x, y, n, msg, 0)
-#define ASSERT_STRNEQ(x, y, n) UTEST_STRNEQ(x, y, n, "", 1)
-#define ASSERT_STRNEQ_MSG(x, y, n, msg) UTEST_STRNEQ(x, y, n, msg, 1)
+template <typename T> struct utest_value_deducer<const T *, false> {
+  static struct utest_value_s _(const T *t) {
+    return utest_value_pointer(static_cast<const void *>(t));
+  }
+};
 
-#define UTEST_STRNNE(x, y, n, msg, is_assert)                                  \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const char *xEval = (x);                                                   \
-    const char *yEval = (y);                                                   \
-    const size_t nEval = UTEST_CAST(size_t, n);                                \
-    if (UTEST_NULL == xEval || UTEST_NULL == yEval ||                          \
-        0 == UTEST_STRNCMP(xEval, yEval, nEval)) {                             \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : \"%.*s\"\n", UTEST_CAST(int, nEval), xEval);  \
-      UTEST_PRINTF("    Actual : \"%.*s\"\n", UTEST_CAST(int, nEval), yEval);  \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <typename T> struct utest_value_deducer<T *, false> {
+  static struct utest_value_s _(T *t) {
+    return utest_value_pointer(static_cast<const void *>(t));
+  }
+};
 
-#define EXPECT_STRNNE(x, y, n) UTEST_STRNNE(x, y, n, "", 0)
-#define EXPECT_STRNNE_MSG(x, y, n, msg) UTEST_STRNNE(x, y, n, msg, 0)
-#define ASSERT_STRNNE(x, y, n) UTEST_STRNNE(x, y, n, "", 1)
-#define ASSERT_STRNNE_MSG(x, y, n, msg) UTEST_STRNNE(x, y, n, msg, 1)
+template <typename T> struct utest_value_deducer<T, true> {
+  static struct utest_value_s _(const T t) {
+    return utest_value_unsigned(static_cast<utest_uint64_t>(t));
+  }
+};
 
-#define UTEST_NEAR(x, y, epsilon, msg, is_assert)                              \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    const double diff =                                                        \
-        utest_fabs(UTEST_CAST(double, x) - UTEST_CAST(double, y));             \
-    if (diff > UTEST_CAST(double, epsilon) || utest_isnan(diff)) {             \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : %f\n", UTEST_CAST(double, x));                \
-      UTEST_PRINTF("    Actual : %f\n", UTEST_CAST(double, y));                \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+template <typename T>
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(const T t) {
+  return utest_value_deducer<T>::_(t);
+}
 
-#define EXPECT_NEAR(x, y, epsilon) UTEST_NEAR(x, y, epsilon, "", 0)
-#define EXPECT_NEAR_MSG(x, y, epsilon, msg) UTEST_NEAR(x, y, epsilon, msg, 0)
-#define ASSERT_NEAR(x, y, epsilon) UTEST_NEAR(x, y, epsilon, "", 1)
-#define ASSERT_NEAR_MSG(x, y, epsilon, msg) UTEST_NEAR(x, y, epsilon, msg, 1)
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
 
-#if defined(UTEST_HAS_EXCEPTIONS)
-#define UTEST_EXCEPTION(x, exception_type, msg, is_assert)                     \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    int exception_caught = 0;                                                  \
-    try {                                                                      \
-      x;                                                                       \
-    } catch (const exception_type &) {                                         \
-      exception_caught = 1;                                                    \
-    } catch (...) {                                                            \
-      exception_caught = 2;                                                    \
-    }                                                                          \
-    if (1 != exception_caught) {                                               \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : %s exception\n", #exception_type);            \
-      UTEST_PRINTF("    Actual : %s\n", (2 == exception_caught)                \
-                                            ? "Unexpected exception"           \
-                                            : "No exception");                 \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+#elif defined(UTEST_OVERLOADABLE)
 
-#define EXPECT_EXCEPTION(x, exception_type)                                    \
-  UTEST_EXCEPTION(x, exception_type, "", 0)
-#define EXPECT_EXCEPTION_MSG(x, exception_type, msg)                           \
-  UTEST_EXCEPTION(x, exception_type, msg, 0)
-#define ASSERT_EXCEPTION(x, exception_type)                                    \
-  UTEST_EXCEPTION(x, exception_type, "", 1)
-#define ASSERT_EXCEPTION_MSG(x, exception_type, msg)                           \
-  UTEST_EXCEPTION(x, exception_type, msg, 1)
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(signed char c);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(signed char c) {
+  return utest_value_signed(c);
+}
 
-#define UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message,     \
-                                     msg, is_assert)                           \
-  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
-    int exception_caught = 0;                                                  \
-    char *message_caught = UTEST_NULL;                                         \
-    try {                                                                      \
-      x;                                                                       \
-    } catch (const exception_type &e) {                                        \
-      const char *const what = e.what();                                       \
-      exception_caught = 1;                                                    \
-      if (0 !=                                                                 \
-          UTEST_STRNCMP(what, exception_message, strlen(exception_message))) { \
-        const size_t message_size = strlen(what) + 1;                          \
-        message_caught = UTEST_PTR_CAST(char *, malloc(message_size));         \
-        UTEST_STRNCPY(message_caught, what, message_size);                     \
-      }                                                                        \
-    } catch (...) {                                                            \
-      exception_caught = 2;                                                    \
-    }                                                                          \
-    if (1 != exception_caught) {                                               \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : %s exception\n", #exception_type);            \
-      UTEST_PRINTF("    Actual : %s\n", (2 == exception_caught)                \
-                                            ? "Unexpected exception"           \
-                                            : "No exception");                 \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      if (is_assert) return;                                                   \
-    } else if (UTEST_NULL != message_caught) {                                 \
-      UTEST_PRINTF("%s:%i: Failure\n", __FILE__, __LINE__);                    \
-      UTEST_PRINTF("  Expected : %s exception with message %s\n",              \
-                   #exception_type, exception_message);                        \
-      UTEST_PRINTF("    Actual message : %s\n", message_caught);               \
-      if (strlen(msg) > 0) {                                                   \
-        UTEST_PRINTF("   Message : %s\n", msg);                                \
-      }                                                                        \
-      *utest_result = UTEST_TEST_FAILURE;                                      \
-      free(message_caught);                                                    \
-      if (is_assert) return;                                                   \
-    }                                                                          \
-  }                                                                            \
-  while (0)                                                                    \
-  UTEST_SURPRESS_WARNING_END
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(unsigned char c);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(unsigned char c) {
+  return utest_value_unsigned(c);
+}
 
-#define EXPECT_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message)    \
-  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, "", 0)
-#define EXPECT_EXCEPTION_WITH_MESSAGE_MSG(x, exception_type,                   \
-                                          exception_message, msg)              \
-  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, msg, 0)
-#define ASSERT_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message)    \
-  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, "", 1)
-#define ASSERT_EXCEPTION_WITH_MESSAGE_MSG(x, exception_type,                   \
-                                          exception_message, msg)              \
-  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, msg, 1)
-#endif
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(float f);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(float f) {
+  return utest_value_double(UTEST_CAST(double, f));
+}
 
-#define UTEST(SET, NAME)                                                       \
-  UTEST_EXTERN struct utest_state_s utest_state;                               \
-  static void utest_run_##SET##_##NAME(int *utest_result);                     \
-  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
-    (void)utest_index;                                                         \
-    utest_run_##SET##_##NAME(utest_result);                                    \
-  }                                                                            \
-  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
-    const size_t index = utest_state.tests_length++;                           \
-    const char *name_part = #SET "." #NAME;                                    \
-    const size_t name_size = strlen(name_part) + 1;                            \
-    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
-    utest_state.tests = UTEST_PTR_CAST(                                        \
-        struct utest_test_state_s *,                                           \
-        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
-                      sizeof(struct utest_test_state_s) *                      \
-                          utest_state.tests_length));                          \
-    if (utest_state.tests) {                                                   \
-      utest_state.tests[index].func = &utest_##SET##_##NAME;                   \
-      utest_state.tests[index].name = name;                                    \
-      utest_state.tests[index].index = 0;                                      \
-      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
-    } else if (name) {                                                         \
-      free(name);                                                              \
-    }                                                                          \
-  }                                                                            \
-  void utest_run_##SET##_##NAME(int *utest_result)
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(double d);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(double d) {
+  return utest_value_double(d);
+}
 
-#define UTEST_F_SETUP(FIXTURE)                                                 \
-  static void utest_f_setup_##FIXTURE(int *utest_result,                       \
-                                      struct FIXTURE *utest_fixture)
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long double d);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long double d) {
+  return utest_value_long_double(d);
+}
 
-#define UTEST_F_TEARDOWN(FIXTURE)                                              \
-  static void utest_f_teardown_##FIXTURE(int *utest_result,                    \
-                                         struct FIXTURE *utest_fixture)
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s utest_make_value(int i) {
+  return utest_value_signed(i);
+}
 
-#if defined(__GNUC__) && __GNUC__ >= 8 && defined(__cplusplus)
-#define UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN                                  \
-  _Pragma("GCC diagnostic push")                                               \
-      _Pragma("GCC diagnostic ignored \"-Wclass-memaccess\"")
-#define UTEST_FIXTURE_SURPRESS_WARNINGS_END _Pragma("GCC diagnostic pop")
-#else
-#define UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN
-#define UTEST_FIXTURE_SURPRESS_WARNINGS_END
-#endif
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(unsigned int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(unsigned int i) {
+  return utest_value_unsigned(i);
+}
 
-#define UTEST_F(FIXTURE, NAME)                                                 \
-  UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN                                        \
-  UTEST_EXTERN struct utest_state_s utest_state;                               \
-  static void utest_f_setup_##FIXTURE(int *, struct FIXTURE *);                \
-  static void utest_f_teardown_##FIXTURE(int *, struct FIXTURE *);             \
-  static void utest_run_##FIXTURE##_##NAME(int *, struct FIXTURE *);           \
-  static void utest_f_##FIXTURE##_##NAME(int *utest_result,                    \
-                                         size_t utest_index) {                 \
-    struct FIXTURE fixture;                                                    \
-    (void)utest_index;                                                         \
-    memset(&fixture, 0, sizeof(fixture));                                      \
-    utest_f_setup_##FIXTURE(utest_result, &fixture);                           \
-    if (UTEST_TEST_PASSED != *utest_result) {                                  \
-      return;                                                                  \
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long int i) {
+  return utest_value_signed(i);
+}
+
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long unsigned int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long unsigned int i) {
+  return utest_value_unsigned(i);
+}
+
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(const void *p);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(const void *p) {
+  return utest_value_pointer(p);
+}
+
+/*
+   long long is a c++11 extension
+*/
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L) ||              \
+    defined(__cplusplus) && (__cplusplus >= 201103L) ||                        \
+    (defined(__MINGW32__) || defined(__MINGW64__))
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+#endif
+
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long long int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long long int i) {
+  return utest_value_signed(i);
+}
+
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long long unsigned int i);
+UTEST_WEAK UTEST_OVERLOADABLE struct utest_value_s
+utest_make_value(long long unsigned int i) {
+  return utest_value_unsigned(i);
+}
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#endif
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) &&            \
+        !(defined(__MINGW32__) || defined(__MINGW64__)) ||                     \
+    defined(__TINYC__)
+/*
+   _Generic picks how the (default promoted) value was passed to us, so that
+   values of any type can go through the one variadic function.
+*/
+#define UTEST_VA_UNDEF (0)
+#define UTEST_VA_INT (1)
+#define UTEST_VA_UINT (2)
+#define UTEST_VA_LONG (3)
+#define UTEST_VA_ULONG (4)
+#define UTEST_VA_LLONG (5)
+#define UTEST_VA_ULLONG (6)
+#define UTEST_VA_DOUBLE (7)
+#define UTEST_VA_LDOUBLE (8)
+#define UTEST_VA_POINTER (9)
+
+UTEST_WEAK struct utest_value_s utest_make_value_va(int type, ...);
+UTEST_WEAK struct utest_value_s utest_make_value_va(int type, ...) {
+  struct utest_value_s value = utest_value_undef();
+  va_list args;
+
+  va_start(args, type);
+  switch (type) {
+  default:
+    break;
+  case UTEST_VA_INT:
+    value = utest_value_signed(va_arg(args, int));
+    break;
+  case UTEST_VA_UINT:
+    value = utest_value_unsigned(va_arg(args, unsigned));
+    break;
+  case UTEST_VA_LONG:
+    value = utest_value_signed(va_arg(args, long));
+    break;
+  case UTEST_VA_ULONG:
+    value = utest_value_unsigned(va_arg(args, unsigned long));
+    break;
+  case UTEST_VA_LLONG:
+    value = utest_value_signed(va_arg(args, long long));
+    break;
+  case UTEST_VA_ULLONG:
+    value = utest_value_unsigned(va_arg(args, unsigned long long));
+    break;
+  case UTEST_VA_DOUBLE:
+    value = utest_value_double(va_arg(args, double));
+    break;
+  case UTEST_VA_LDOUBLE:
+    value = utest_value_long_double(va_arg(args, long double));
+    break;
+  case UTEST_VA_POINTER:
+    value = utest_value_pointer(va_arg(args, const void *));
+    break;
+  }
+  va_end(args);
+
+  return value;
+}
+
+#define utest_make_value(val)                                                  \
+  utest_make_value_va(_Generic((val), signed char                              \
+                               : UTEST_VA_INT, unsigned char                   \
+                               : UTEST_VA_INT, short                           \
+                               : UTEST_VA_INT, unsigned short                  \
+                               : UTEST_VA_INT, int                             \
+                               : UTEST_VA_INT, long                            \
+                               : UTEST_VA_LONG, long long                      \
+                               : UTEST_VA_LLONG, unsigned                      \
+                               : UTEST_VA_UINT, unsigned long                  \
+                               : UTEST_VA_ULONG, unsigned long long            \
+                               : UTEST_VA_ULLONG, float                        \
+                               : UTEST_VA_DOUBLE, double                       \
+                               : UTEST_VA_DOUBLE, long double                  \
+                               : UTEST_VA_LDOUBLE, default                     \
+                               : _Generic((val - val), ptrdiff_t               \
+                                          : UTEST_VA_POINTER, default          \
+                                          : UTEST_VA_UNDEF)),                  \
+                      (val))
+#else
+/* we can't tell the types of the values we got, so they print as undef */
+#define utest_make_value(...) utest_value_undef()
+#endif
+
+/* every assertion counts itself as checked, whether it passes or fails */
+#define UTEST_CHECKED() utest_thread_context()->assertions_checked++
+
+UTEST_WEAK void utest_print_value(const struct utest_value_s value);
+UTEST_WEAK void utest_print_value(const struct utest_value_s value) {
+  switch (value.kind) {
+  default:
+    UTEST_PRINTF("undef");
+    break;
+  case UTEST_VALUE_SIGNED:
+    UTEST_PRINTF("%" UTEST_PRId64, value.as.i);
+    break;
+  case UTEST_VALUE_UNSIGNED:
+    UTEST_PRINTF("%" UTEST_PRIu64, value.as.u);
+    break;
+  case UTEST_VALUE_DOUBLE:
+    UTEST_PRINTF("%f", value.as.d);
+    break;
+  case UTEST_VALUE_LONG_DOUBLE:
+#if defined(__MINGW32__) || defined(__MINGW64__)
+    /* MINGW is weird - doesn't like LF at all?! */
+    UTEST_PRINTF("%f", UTEST_CAST(double, value.ld));
+#else
+    UTEST_PRINTF("%Lf", value.ld);
+#endif
+    break;
+  case UTEST_VALUE_POINTER:
+    UTEST_PRINTF("%p", value.as.p);
+    break;
+  }
+}
+
+/*
+   the failure paths of the assertions. Each is kept out of line and marked
+   cold, so that a passing assertion costs only its comparison and a branch
+   the compiler is told will not be taken.
+*/
+
+/*
+   count a failed assertion against the running test, returning whether it
+   should be printed (it shouldn't once --max-failures-per-test is reached).
+   Only failures of the running test's own result are counted, and not those
+   of a check run against a result of its own (EG. a property being shrunk).
+*/
+UTEST_WEAK UTEST_COLD int utest_count_failure(const int *const result);
+UTEST_WEAK UTEST_COLD int utest_count_failure(const int *const result) {
+  utest_uint64_t failed;
+
+  if (result != utest_state.current_result) {
+    return 1;
+  }
+
+  failed = utest_atomic_increment64(&utest_state.assertions_failed);
+
+  return (0 == utest_state.max_failures_per_test) ||
+         (failed <= utest_state.max_failures_per_test);
+}
+
+UTEST_WEAK UTEST_COLD void utest_failure_message(const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_failure_message(const char *const msg) {
+  if (strlen(msg) > 0) {
+    UTEST_PRINTF("   Message : %s\n", msg);
+  }
+}
+
+UTEST_WEAK UTEST_COLD void
+utest_cond_failed(int *const result, const char *const file, const int line,
+                  const char *const x_text, const char *const cond_text,
+                  const char *const y_text, const struct utest_value_s x,
+                  const struct utest_value_s y, const char *const msg);
+UTEST_WEAK UTEST_COLD void
+utest_cond_failed(int *const result, const char *const file, const int line,
+                  const char *const x_text, const char *const cond_text,
+                  const char *const y_text, const struct utest_value_s x,
+                  const struct utest_value_s y, const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : (%s) %s (%s)\n", x_text, cond_text, y_text);
+  UTEST_PRINTF("    Actual : ");
+  utest_print_value(x);
+  UTEST_PRINTF(" vs ");
+  utest_print_value(y);
+  UTEST_PRINTF("\n");
+  utest_failure_message(msg);
+}
+
+/* without a way to copy the values' types, we only have the condition */
+UTEST_WEAK UTEST_COLD void
+utest_cond_failed_untyped(int *const result, const char *const file,
+                          const int line, const char *const cond_text,
+                          const char *const msg);
+UTEST_WEAK UTEST_COLD void
+utest_cond_failed_untyped(int *const result, const char *const file,
+                          const int line, const char *const cond_text,
+                          const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure (Expected %s Actual)", file, line, cond_text);
+  if (strlen(msg) > 0) {
+    UTEST_PRINTF(" Message : %s", msg);
+  }
+  UTEST_PRINTF("\n");
+}
+
+UTEST_WEAK UTEST_COLD void utest_bool_failed(int *const result,
+                                             const char *const file,
+                                             const int line, const int expected,
+                                             const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_bool_failed(int *const result,
+                                             const char *const file,
+                                             const int line, const int expected,
+                                             const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : %s\n", expected ? "true" : "false");
+  UTEST_PRINTF("    Actual : %s\n", expected ? "false" : "true");
+  utest_failure_message(msg);
+}
+
+/* n is the number of characters compared, or -1 if the strings were whole */
+UTEST_WEAK UTEST_COLD void utest_str_failed(int *const result,
+                                            const char *const file,
+                                            const int line, const char *x,
+                                            const char *y, const int n,
+                                            const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_str_failed(int *const result,
+                                            const char *const file,
+                                            const int line, const char *x,
+                                            const char *y, const int n,
+                                            const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : \"%.*s\"\n", n, x);
+  UTEST_PRINTF("    Actual : \"%.*s\"\n", n, y);
+  utest_failure_message(msg);
+}
+
+UTEST_WEAK UTEST_COLD void utest_near_failed(int *const result,
+                                             const char *const file,
+                                             const int line, const double x,
+                                             const double y,
+                                             const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_near_failed(int *const result,
+                                             const char *const file,
+                                             const int line, const double x,
+                                             const double y,
+                                             const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : %f\n", x);
+  UTEST_PRINTF("    Actual : %f\n", y);
+  utest_failure_message(msg);
+}
+
+#if defined(_MSC_VER)
+#define UTEST_SURPRESS_WARNING_BEGIN                                           \
+  __pragma(warning(push)) __pragma(warning(disable : 4127))                    \
+      __pragma(warning(disable : 4571)) __pragma(warning(disable : 4130))
+#define UTEST_SURPRESS_WARNING_END __pragma(warning(pop))
+#else
+#define UTEST_SURPRESS_WARNING_BEGIN
+#define UTEST_SURPRESS_WARNING_END
+#endif
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+#define UTEST_AUTO(x) auto
+#elif !defined(__cplusplus)
+
+#if defined(__clang__)
+/* clang-format off */
+/* had to disable clang-format here because it malforms the pragmas */
+#define UTEST_AUTO(x)                                                          \
+  _Pragma("clang diagnostic push")                                             \
+      _Pragma("clang diagnostic ignored \"-Wgnu-auto-type\"") __auto_type      \
+          _Pragma("clang diagnostic pop")
+/* clang-format on */
+#else
+#define UTEST_AUTO(x) __typeof__(x + 0)
+#endif
+
+#else
+#define UTEST_AUTO(x) typeof(x + 0)
+#endif
+
+#if defined(__clang__)
+#define UTEST_STRNCMP(x, y, size)                                              \
+  _Pragma("clang diagnostic push")                                             \
+      _Pragma("clang diagnostic ignored \"-Wdisabled-macro-expansion\"")       \
+          strncmp(x, y, size) _Pragma("clang diagnostic pop")
+#else
+#define UTEST_STRNCMP(x, y, size) strncmp(x, y, size)
+#endif
+
+#if defined(_MSC_VER)
+#define UTEST_STRNCPY(x, y, size) strcpy_s(x, size, y)
+#elif !defined(__clang__) && defined(__GNUC__)
+static UTEST_INLINE char *
+utest_strncpy_gcc(char *const dst, const char *const src, const size_t size) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+  return strncpy(dst, src, size);
+#pragma GCC diagnostic pop
+}
+
+#define UTEST_STRNCPY(x, y, size) utest_strncpy_gcc(x, y, size)
+#else
+#define UTEST_STRNCPY(x, y, size) strncpy(x, y, size)
+#endif
+
+/*
+   a failed ASSERT returns from the function it is in. In the child of a death
+   test that ends the statement being run there, so the child reports that it
+   returned and exits rather than running on through the rest of the test.
+*/
+#define UTEST_ASSERT_RETURN()                                                  \
+  do {                                                                         \
+    utest_death_return('r');                                                   \
+    return;                                                                    \
+  } while (0)
+
+#define UTEST_SKIP(msg)                                                        \
+  do {                                                                         \
+    UTEST_PRINTF("   Skipped : '%s'\n", (msg));                                \
+    *utest_result = UTEST_TEST_SKIPPED;                                        \
+    return;                                                                    \
+  } while (0)
+
+#if defined(__clang__)
+#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    _Pragma("clang diagnostic push")                                           \
+        _Pragma("clang diagnostic ignored \"-Wlanguage-extension-token\"")     \
+            _Pragma("clang diagnostic ignored \"-Wc++98-compat-pedantic\"")    \
+                _Pragma("clang diagnostic ignored \"-Wfloat-equal\"")          \
+                    UTEST_AUTO(x) xEval = (x);                                 \
+    UTEST_AUTO(y) yEval = (y);                                                 \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(!((xEval)cond(yEval)))) {                               \
+      _Pragma("clang diagnostic pop")                                          \
+          utest_cond_failed(utest_result, __FILE__, __LINE__, #x, #cond, #y,   \
+                            utest_make_value(xEval), utest_make_value(yEval),  \
+                            msg);                                              \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
     }                                                                          \
-    utest_run_##FIXTURE##_##NAME(utest_result, &fixture);                      \
-    utest_f_teardown_##FIXTURE(utest_result, &fixture);                        \
   }                                                                            \
-  UTEST_INITIALIZER(utest_register_##FIXTURE##_##NAME) {                       \
-    const size_t index = utest_state.tests_length++;                           \
-    const char *name_part = #FIXTURE "." #NAME;                                \
-    const size_t name_size = strlen(name_part) + 1;                            \
-    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
-    utest_state.tests = UTEST_PTR_CAST(                                        \
-        struct utest_test_state_s *,                                           \
-        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
-                      sizeof(struct utest_test_state_s) *                      \
-                          utest_state.tests_length));                          \
-    if (utest_state.tests) {                                                   \
-      utest_state.tests[index].func = &utest_f_##FIXTURE##_##NAME;             \
-      utest_state.tests[index].name = name;                                    \
-      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
-    } else if (name) {                                                         \
-      free(name);                                                              \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+#elif defined(__GNUC__) || defined(__TINYC__)
+#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_AUTO(x) xEval = (x);                                                 \
+    UTEST_AUTO(y) yEval = (y);                                                 \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(!((xEval)cond(yEval)))) {                               \
+      utest_cond_failed(utest_result, __FILE__, __LINE__, #x, #cond, #y,       \
+                        utest_make_value(xEval), utest_make_value(yEval),      \
+                        msg);                                                  \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
     }                                                                          \
   }                                                                            \
-  UTEST_FIXTURE_SURPRESS_WARNINGS_END                                          \
-  void utest_run_##FIXTURE##_##NAME(int *utest_result,                         \
-                                    struct FIXTURE *utest_fixture)
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+#else
+#define UTEST_COND(x, y, cond, msg, is_assert)                                 \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(!((x)cond(y)))) {                                       \
+      utest_cond_failed_untyped(utest_result, __FILE__, __LINE__, #cond, msg); \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+#endif
+
+#define EXPECT_EQ(x, y) UTEST_COND(x, y, ==, "", 0)
+#define EXPECT_EQ_MSG(x, y, msg) UTEST_COND(x, y, ==, msg, 0)
+#define ASSERT_EQ(x, y) UTEST_COND(x, y, ==, "", 1)
+#define ASSERT_EQ_MSG(x, y, msg) UTEST_COND(x, y, ==, msg, 1)
+
+#define EXPECT_NE(x, y) UTEST_COND(x, y, !=, "", 0)
+#define EXPECT_NE_MSG(x, y, msg) UTEST_COND(x, y, !=, msg, 0)
+#define ASSERT_NE(x, y) UTEST_COND(x, y, !=, "", 1)
+#define ASSERT_NE_MSG(x, y, msg) UTEST_COND(x, y, !=, msg, 1)
+
+#define EXPECT_LT(x, y) UTEST_COND(x, y, <, "", 0)
+#define EXPECT_LT_MSG(x, y, msg) UTEST_COND(x, y, <, msg, 0)
+#define ASSERT_LT(x, y) UTEST_COND(x, y, <, "", 1)
+#define ASSERT_LT_MSG(x, y, msg) UTEST_COND(x, y, <, msg, 1)
+
+#define EXPECT_LE(x, y) UTEST_COND(x, y, <=, "", 0)
+#define EXPECT_LE_MSG(x, y, msg) UTEST_COND(x, y, <=, msg, 0)
+#define ASSERT_LE(x, y) UTEST_COND(x, y, <=, "", 1)
+#define ASSERT_LE_MSG(x, y, msg) UTEST_COND(x, y, <=, msg, 1)
+
+#define EXPECT_GT(x, y) UTEST_COND(x, y, >, "", 0)
+#define EXPECT_GT_MSG(x, y, msg) UTEST_COND(x, y, >, msg, 0)
+#define ASSERT_GT(x, y) UTEST_COND(x, y, >, "", 1)
+#define ASSERT_GT_MSG(x, y, msg) UTEST_COND(x, y, >, msg, 1)
+
+#define EXPECT_GE(x, y) UTEST_COND(x, y, >=, "", 0)
+#define EXPECT_GE_MSG(x, y, msg) UTEST_COND(x, y, >=, msg, 0)
+#define ASSERT_GE(x, y) UTEST_COND(x, y, >=, "", 1)
+#define ASSERT_GE_MSG(x, y, msg) UTEST_COND(x, y, >=, msg, 1)
+
+#define UTEST_TRUE(x, msg, is_assert)                                          \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(!(x))) {                                                \
+      utest_bool_failed(utest_result, __FILE__, __LINE__, 1, msg);             \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_TRUE(x) UTEST_TRUE(x, "", 0)
+#define EXPECT_TRUE_MSG(x, msg) UTEST_TRUE(x, msg, 0)
+#define ASSERT_TRUE(x) UTEST_TRUE(x, "", 1)
+#define ASSERT_TRUE_MSG(x, msg) UTEST_TRUE(x, msg, 1)
+
+#define UTEST_FALSE(x, msg, is_assert)                                         \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(x)) {                                                   \
+      utest_bool_failed(utest_result, __FILE__, __LINE__, 0, msg);             \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_FALSE(x) UTEST_FALSE(x, "", 0)
+#define EXPECT_FALSE_MSG(x, msg) UTEST_FALSE(x, msg, 0)
+#define ASSERT_FALSE(x) UTEST_FALSE(x, "", 1)
+#define ASSERT_FALSE_MSG(x, msg) UTEST_FALSE(x, msg, 1)
+
+#define UTEST_STREQ(x, y, msg, is_assert)                                      \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    const char *xEval = (x);                                                   \
+    const char *yEval = (y);                                                   \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(UTEST_NULL == xEval || UTEST_NULL == yEval ||           \
+                       0 != strcmp(xEval, yEval))) {                           \
+      utest_str_failed(utest_result, __FILE__, __LINE__, xEval, yEval, -1,     \
+                       msg);                                                   \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_STREQ(x, y) UTEST_STREQ(x, y, "", 0)
+#define EXPECT_STREQ_MSG(x, y, msg) UTEST_STREQ(x, y, msg, 0)
+#define ASSERT_STREQ(x, y) UTEST_STREQ(x, y, "", 1)
+#define ASSERT_STREQ_MSG(x, y, msg) UTEST_STREQ(x, y, msg, 1)
+
+#define UTEST_STRNE(x, y, msg, is_assert)                                      \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    const char *xEval = (x);                                                   \
+    const char *yEval = (y);                                                   \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(UTEST_NULL == xEval || UTEST_NULL == yEval ||           \
+                       0 == strcmp(xEval, yEval))) {                           \
+      utest_str_failed(utest_result, __FILE__, __LINE__, xEval, yEval, -1,     \
+                       msg);                                                   \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_STRNE(x, y) UTEST_STRNE(x, y, "", 0)
+#define EXPECT_STRNE_MSG(x, y, msg) UTEST_STRNE(x, y, msg, 0)
+#define ASSERT_STRNE(x, y) UTEST_STRNE(x, y, "", 1)
+#define ASSERT_STRNE_MSG(x, y, msg) UTEST_STRNE(x, y, msg, 1)
+
+#define UTEST_STRNEQ(x, y, n, msg, is_assert)                                  \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    const char *xEval = (x);                                                   \
+    const char *yEval = (y);                                                   \
+    const size_t nEval = UTEST_CAST(size_t, n);                                \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(UTEST_NULL == xEval || UTEST_NULL == yEval ||           \
+                       0 != UTEST_STRNCMP(xEval, yEval, nEval))) {             \
+      utest_str_failed(utest_result, __FILE__, __LINE__, xEval, yEval,         \
+                       UTEST_CAST(int, nEval), msg);                           \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_STRNEQ(x, y, n) UTEST_STRNEQ(x, y, n, "", 0)
+#define EXPECT_STRNEQ_MSG(x, y, n, msg) UTEST_STRNEQ(x, y, n, msg, 0)
+#define ASSERT_STRNEQ(x, y, n) UTEST_STRNEQ(x, y, n, "", 1)
+#define ASSERT_STRNEQ_MSG(x, y, n, msg) UTEST_STRNEQ(x, y, n, msg, 1)
+
+#define UTEST_STRNNE(x, y, n, msg, is_assert)                                  \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    const char *xEval = (x);                                                   \
+    const char *yEval = (y);                                                   \
+    const size_t nEval = UTEST_CAST(size_t, n);                                \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(UTEST_NULL == xEval || UTEST_NULL == yEval ||           \
+                       0 == UTEST_STRNCMP(xEval, yEval, nEval))) {             \
+      utest_str_failed(utest_result, __FILE__, __LINE__, xEval, yEval,         \
+                       UTEST_CAST(int, nEval), msg);                           \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_STRNNE(x, y, n) UTEST_STRNNE(x, y, n, "", 0)
+#define EXPECT_STRNNE_MSG(x, y, n, msg) UTEST_STRNNE(x, y, n, msg, 0)
+#define ASSERT_STRNNE(x, y, n) UTEST_STRNNE(x, y, n, "", 1)
+#define ASSERT_STRNNE_MSG(x, y, n, msg) UTEST_STRNNE(x, y, n, msg, 1)
+
+#define UTEST_NEAR(x, y, epsilon, msg, is_assert)                              \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    const double diff =                                                        \
+        utest_fabs(UTEST_CAST(double, x) - UTEST_CAST(double, y));             \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(diff > UTEST_CAST(double, epsilon) ||                   \
+                       utest_isnan(diff))) {                                   \
+      utest_near_failed(utest_result, __FILE__, __LINE__,                      \
+                        UTEST_CAST(double, x), UTEST_CAST(double, y), msg);    \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_NEAR(x, y, epsilon) UTEST_NEAR(x, y, epsilon, "", 0)
+#define EXPECT_NEAR_MSG(x, y, epsilon, msg) UTEST_NEAR(x, y, epsilon, msg, 0)
+#define ASSERT_NEAR(x, y, epsilon) UTEST_NEAR(x, y, epsilon, "", 1)
+#define ASSERT_NEAR_MSG(x, y, epsilon, msg) UTEST_NEAR(x, y, epsilon, msg, 1)
+
+#define UTEST_MATCHES_SNAPSHOT(buffer, size, is_assert)                        \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (utest_check_snapshot(utest_result, __FILE__, __LINE__, buffer,         \
+                             size)) {                                          \
+      utest_set_result(utest_result, UTEST_TEST_FAILURE);                      \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_MATCHES_SNAPSHOT(buffer, size)                                  \
+  UTEST_MATCHES_SNAPSHOT(buffer, size, 0)
+#define ASSERT_MATCHES_SNAPSHOT(buffer, size)                                  \
+  UTEST_MATCHES_SNAPSHOT(buffer, size, 1)
+
+#ifndef UTEST_MAX_MISMATCHES
+#define UTEST_MAX_MISMATCHES 8
+#endif
+
+/*
+   print the 16 byte rows of x and y that hold the first UTEST_MAX_MISMATCHES
+   differing bytes, with the differences underlined.
+*/
+UTEST_WEAK
+void utest_print_hex_diff(const unsigned char *x, const unsigned char *y,
+                          size_t size);
+UTEST_WEAK
+void utest_print_hex_diff(const unsigned char *x, const unsigned char *y,
+                          size_t size) {
+  size_t shown = 0;
+  size_t row;
+
+  for (row = 0; (row < size) && (UTEST_MAX_MISMATCHES > shown); row += 16) {
+    const size_t row_size = (16 < size - row) ? 16 : size - row;
+    char marks[16 * 3 + 1];
+    char label[32];
+    size_t index;
+
+    if (0 == memcmp(x + row, y + row, row_size)) {
+      continue;
+    }
+
+    UTEST_SNPRINTF(label, sizeof(label), "x+0x%lx",
+                   UTEST_CAST(unsigned long, row));
+    UTEST_PRINTF("%10s :", label);
+    for (index = 0; index < row_size; index++) {
+      UTEST_PRINTF(" %02x", UTEST_CAST(unsigned, x[row + index]));
+    }
+
+    UTEST_SNPRINTF(label, sizeof(label), "y+0x%lx",
+                   UTEST_CAST(unsigned long, row));
+    UTEST_PRINTF("\n%10s :", label);
+    for (index = 0; index < row_size; index++) {
+      UTEST_PRINTF(" %02x", UTEST_CAST(unsigned, y[row + index]));
+    }
+
+    for (index = 0; index < row_size; index++) {
+      const int differs = x[row + index] != y[row + index];
+      marks[index * 3 + 0] = ' ';
+      marks[index * 3 + 1] = differs ? '^' : ' ';
+      marks[index * 3 + 2] = differs ? '^' : ' ';
+      shown += differs ? 1 : 0;
+    }
+
+    /* trim the marks so that the line has no trailing whitespace */
+    index = row_size * 3;
+    while ((0 < index) && (' ' == marks[index - 1])) {
+      index--;
+    }
+    marks[index] = '\0';
+    UTEST_PRINTF("\n           %s\n", marks);
+  }
+}
+
+/*
+   compare two blocks of memory with memcmp, and only when they differ count
+   the differing bytes and print where they are. Returns non-zero if the blocks
+   differ.
+*/
+UTEST_WEAK
+int utest_check_memeq(int *const result, const char *file, int line,
+                      const char *x_text, const char *y_text, const void *x,
+                      const void *y, size_t size, const char *msg);
+UTEST_WEAK
+int utest_check_memeq(int *const result, const char *file, int line,
+                      const char *x_text, const char *y_text, const void *x,
+                      const void *y, size_t size, const char *msg) {
+  const unsigned char *const x_bytes = UTEST_PTR_CAST(const unsigned char *, x);
+  const unsigned char *const y_bytes = UTEST_PTR_CAST(const unsigned char *, y);
+  size_t first = size;
+  size_t differ = 0;
+  size_t index;
+
+  if ((0 == size) || (0 == memcmp(x, y, size))) {
+    return 0;
+  }
+
+  for (index = 0; index < size; index++) {
+    if (x_bytes[index] != y_bytes[index]) {
+      first = (size == first) ? index : first;
+      differ++;
+    }
+  }
+
+  if (!utest_count_failure(result)) {
+    return 1;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : (%s) and (%s) to hold the same %lu bytes\n",
+               x_text, y_text, UTEST_CAST(unsigned long, size));
+  UTEST_PRINTF("    Actual : %lu bytes differ, the first at offset %lu\n",
+               UTEST_CAST(unsigned long, differ),
+               UTEST_CAST(unsigned long, first));
+  utest_print_hex_diff(x_bytes, y_bytes, size);
+  if (strlen(msg) > 0) {
+    UTEST_PRINTF("   Message : %s\n", msg);
+  }
+  return 1;
+}
+
+#define UTEST_MEMEQ(x, y, size, msg, is_assert)                                \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (utest_check_memeq(utest_result, __FILE__, __LINE__, #x, #y, x, y,      \
+                          size, msg)) {                                        \
+      utest_set_result(utest_result, UTEST_TEST_FAILURE);                      \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_MEMEQ(x, y, size) UTEST_MEMEQ(x, y, size, "", 0)
+#define EXPECT_MEMEQ_MSG(x, y, size, msg) UTEST_MEMEQ(x, y, size, msg, 0)
+#define ASSERT_MEMEQ(x, y, size) UTEST_MEMEQ(x, y, size, "", 1)
+#define ASSERT_MEMEQ_MSG(x, y, size, msg) UTEST_MEMEQ(x, y, size, msg, 1)
+
+#if defined(__clang__)
+#define UTEST_FLOAT_EQUAL_BEGIN                                                \
+  _Pragma("clang diagnostic push")                                             \
+      _Pragma("clang diagnostic ignored \"-Wfloat-equal\"")
+#define UTEST_FLOAT_EQUAL_END _Pragma("clang diagnostic pop")
+#else
+#define UTEST_FLOAT_EQUAL_BEGIN
+#define UTEST_FLOAT_EQUAL_END
+#endif
+
+#if defined(__clang__) || defined(__GNUC__) || defined(__TINYC__)
+/*
+   the failure path of EXPECT_ARRAY_EQ, split in three around the loop that
+   finds the elements to show (which has to stay in the macro, as only it knows
+   their type). utest_array_eq_failed returns whether the failure is printed.
+*/
+UTEST_WEAK UTEST_COLD int
+utest_array_eq_failed(int *const result, const char *const file,
+                      const int line, const char *const x_text,
+                      const char *const y_text, const size_t count,
+                      const size_t mismatches);
+UTEST_WEAK UTEST_COLD int
+utest_array_eq_failed(int *const result, const char *const file,
+                      const int line, const char *const x_text,
+                      const char *const y_text, const size_t count,
+                      const size_t mismatches) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return 0;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : (%s)[i] == (%s)[i] for i < %lu\n", x_text, y_text,
+               UTEST_CAST(unsigned long, count));
+  UTEST_PRINTF("    Actual : %lu elements differ\n",
+               UTEST_CAST(unsigned long, mismatches));
+  return 1;
+}
+
+UTEST_WEAK UTEST_COLD void
+utest_array_eq_element(const size_t index, const struct utest_value_s x,
+                       const struct utest_value_s y);
+UTEST_WEAK UTEST_COLD void
+utest_array_eq_element(const size_t index, const struct utest_value_s x,
+                       const struct utest_value_s y) {
+  char label[32];
+  UTEST_SNPRINTF(label, sizeof(label), "[%lu]",
+                 UTEST_CAST(unsigned long, index));
+  UTEST_PRINTF("%10s : ", label);
+  utest_print_value(x);
+  UTEST_PRINTF(" vs ");
+  utest_print_value(y);
+  UTEST_PRINTF("\n");
+}
+
+UTEST_WEAK UTEST_COLD void utest_array_eq_end(const size_t mismatches,
+                                              const size_t shown,
+                                              const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_array_eq_end(const size_t mismatches,
+                                              const size_t shown,
+                                              const char *const msg) {
+  if (mismatches > shown) {
+    UTEST_PRINTF("           ... and %lu more\n",
+                 UTEST_CAST(unsigned long, mismatches - shown));
+  }
+  utest_failure_message(msg);
+}
+
+/*
+   arrays whose elements are bitwise identical are equal, which memcmp (that
+   the C library vectorises) can tell us quickly. Only when that fails are the
+   elements compared with == (so that EG. 0.0 and -0.0 are equal), and the
+   first UTEST_MAX_MISMATCHES that differ are printed.
+*/
+#define UTEST_ARRAY_EQ(x, y, count, msg, is_assert)                            \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_AUTO(x) xEval = (x);                                                 \
+    UTEST_AUTO(y) yEval = (y);                                                 \
+    const size_t utest_count = UTEST_CAST(size_t, count);                      \
+    size_t utest_mismatches = 0;                                               \
+    size_t utest_shown = 0;                                                    \
+    size_t utest_i;                                                            \
+    UTEST_CHECKED();                                                           \
+    if (UTEST_UNLIKELY(                                                        \
+            (sizeof(*xEval) != sizeof(*yEval)) ||                              \
+            ((0 < utest_count) &&                                              \
+             (0 != memcmp(xEval, yEval, sizeof(*xEval) * utest_count))))) {    \
+      UTEST_FLOAT_EQUAL_BEGIN                                                  \
+      for (utest_i = 0; utest_i < utest_count; utest_i++) {                    \
+        utest_mismatches += (xEval[utest_i] == yEval[utest_i]) ? 0 : 1;        \
+      }                                                                        \
+      if (utest_mismatches) {                                                  \
+        if (utest_array_eq_failed(utest_result, __FILE__, __LINE__, #x, #y,    \
+                                  utest_count, utest_mismatches)) {            \
+          for (utest_i = 0; (utest_i < utest_count) &&                         \
+                            (UTEST_MAX_MISMATCHES > utest_shown);              \
+               utest_i++) {                                                    \
+            if (!(xEval[utest_i] == yEval[utest_i])) {                         \
+              utest_array_eq_element(utest_i,                                  \
+                                     utest_make_value(xEval[utest_i]),         \
+                                     utest_make_value(yEval[utest_i]));        \
+              utest_shown++;                                                   \
+            }                                                                  \
+          }                                                                    \
+          utest_array_eq_end(utest_mismatches, utest_shown, msg);              \
+        }                                                                      \
+        if (is_assert) UTEST_ASSERT_RETURN();                                  \
+      }                                                                        \
+      UTEST_FLOAT_EQUAL_END                                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+#else
+/* without a way to copy the arrays' types, fall back to comparing bytes */
+#define UTEST_ARRAY_EQ(x, y, count, msg, is_assert)                            \
+  UTEST_MEMEQ(x, y, sizeof(*(x)) * UTEST_CAST(size_t, count), msg, is_assert)
+#endif
+
+#define EXPECT_ARRAY_EQ(x, y, count) UTEST_ARRAY_EQ(x, y, count, "", 0)
+#define EXPECT_ARRAY_EQ_MSG(x, y, count, msg)                                  \
+  UTEST_ARRAY_EQ(x, y, count, msg, 0)
+#define ASSERT_ARRAY_EQ(x, y, count) UTEST_ARRAY_EQ(x, y, count, "", 1)
+#define ASSERT_ARRAY_EQ_MSG(x, y, count, msg)                                  \
+  UTEST_ARRAY_EQ(x, y, count, msg, 1)
+
+UTEST_WEAK
+double utest_fabs(double d);
+UTEST_WEAK
+double utest_fabs(double d) {
+  union {
+    double d;
+    utest_uint64_t u;
+  } both;
+  both.d = d;
+  both.u &= 0x7fffffffffffffffu;
+  return both.d;
+}
+
+/*
+   a square root by Newton's method, so that utest.h doesn't need libm. The
+   first guess halves d's exponent, so that even a very large or very small d
+   is converged on well within the iterations.
+*/
+UTEST_WEAK
+double utest_sqrt(double d);
+UTEST_WEAK
+double utest_sqrt(double d) {
+  union {
+    double d;
+    utest_uint64_t u;
+  } root;
+  int iteration;
+
+  if (!(0.0 < d)) {
+    return 0.0;
+  }
+
+  root.d = d;
+  if (0x7ff0000000000000u == root.u) {
+    return d;
+  }
+
+  root.u = (root.u >> 1) + (0x3ff0000000000000u >> 1);
+
+  for (iteration = 0; iteration < 64; iteration++) {
+    root.d = 0.5 * (root.d + d / root.d);
+  }
+
+  return root.d;
+}
+
+UTEST_WEAK
+int utest_isnan(double d);
+UTEST_WEAK
+int utest_isnan(double d) {
+  union {
+    double d;
+    utest_uint64_t u;
+  } both;
+  both.d = d;
+  both.u &= 0x7fffffffffffffffu;
+  return both.u > 0x7ff0000000000000u;
+}
+
+/* treat a NaN in x as equal to a NaN in y (see EXPECT_ARRAY_CLOSE) */
+#define UTEST_NAN_EQUAL 1
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wfloat-equal"
+#endif
+
+/*
+   the distance between two floats in ULPs, found by mapping their bits onto a
+   line where adjacent floats are adjacent integers (and -0.0 meets 0.0). This
+   and utest_within_tolerance are written without branches, so that the loops
+   calling them can be vectorised.
+*/
+static UTEST_INLINE utest_uint64_t utest_ulps_float(float a, float b) {
+  union {
+    float f;
+    utest_uint32_t u;
+  } x, y;
+  utest_uint64_t x_line, y_line;
+  x.f = a;
+  y.f = b;
+  x_line = (x.u & 0x80000000u) ? 0x80000000u - (x.u & 0x7fffffffu)
+                               : 0x80000000u + UTEST_CAST(utest_uint64_t, x.u);
+  y_line = (y.u & 0x80000000u) ? 0x80000000u - (y.u & 0x7fffffffu)
+                               : 0x80000000u + UTEST_CAST(utest_uint64_t, y.u);
+  return (x_line > y_line) ? x_line - y_line : y_line - x_line;
+}
+
+static UTEST_INLINE utest_uint64_t utest_ulps_double(double a, double b) {
+  union {
+    double d;
+    utest_uint64_t u;
+  } x, y;
+  utest_uint64_t x_line, y_line;
+  x.d = a;
+  y.d = b;
+  x_line = (x.u & 0x8000000000000000u)
+               ? 0x8000000000000000u - (x.u & 0x7fffffffffffffffu)
+               : 0x8000000000000000u + x.u;
+  y_line = (y.u & 0x8000000000000000u)
+               ? 0x8000000000000000u - (y.u & 0x7fffffffffffffffu)
+               : 0x8000000000000000u + y.u;
+  return (x_line > y_line) ? x_line - y_line : y_line - x_line;
+}
+
+/*
+   whether x and y are close: within the absolute tolerance, within the
+   relative tolerance of the larger magnitude, or within the ULP tolerance.
+*/
+static UTEST_INLINE int utest_within_tolerance(double x, double y,
+                                               utest_uint64_t distance,
+                                               double absolute, double relative,
+                                               utest_uint64_t ulps,
+                                               int nan_equal) {
+  const int x_nan = x != x;
+  const int y_nan = y != y;
+  const double difference = utest_fabs(x - y);
+  const double x_magnitude = utest_fabs(x);
+  const double y_magnitude = utest_fabs(y);
+  const double magnitude =
+      (x_magnitude > y_magnitude) ? x_magnitude : y_magnitude;
+
+  return (difference <= absolute) | (difference <= relative * magnitude) |
+         ((distance <= ulps) & !(x_nan | y_nan)) |
+         (nan_equal & x_nan & y_nan);
+}
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+/* count how many elements of x and y are not close */
+UTEST_WEAK
+size_t utest_array_near_failures(const void *x, const void *y, size_t count,
+                                 size_t element_size, double absolute,
+                                 double relative, utest_uint64_t ulps,
+                                 int nan_equal);
+UTEST_WEAK
+size_t utest_array_near_failures(const void *x, const void *y, size_t count,
+                                 size_t element_size, double absolute,
+                                 double relative, utest_uint64_t ulps,
+                                 int nan_equal) {
+  size_t failures = 0;
+  size_t i;
+
+  if (sizeof(float) == element_size) {
+    const float *const xf = UTEST_PTR_CAST(const float *, x);
+    const float *const yf = UTEST_PTR_CAST(const float *, y);
+
+    for (i = 0; i < count; i++) {
+      failures += UTEST_CAST(
+          size_t, !utest_within_tolerance(
+                      UTEST_CAST(double, xf[i]), UTEST_CAST(double, yf[i]),
+                      utest_ulps_float(xf[i], yf[i]), absolute, relative, ulps,
+                      nan_equal));
+    }
+  } else {
+    const double *const xd = UTEST_PTR_CAST(const double *, x);
+    const double *const yd = UTEST_PTR_CAST(const double *, y);
+
+    for (i = 0; i < count; i++) {
+      failures += UTEST_CAST(
+          size_t, !utest_within_tolerance(xd[i], yd[i],
+                                          utest_ulps_double(xd[i], yd[i]),
+                                          absolute, relative, ulps, nan_equal));
+    }
+  }
+
+  return failures;
+}
+
+/*
+   check that float or double arrays x and y are close (see
+   utest_within_tolerance), and if not print the largest error, the largest
+   distance in ULPs, the first few elements that aren't close and a histogram
+   of the ULP distances. Returns non-zero if the check failed.
+*/
+UTEST_WEAK
+int utest_check_array_near(int *const result, const char *file, int line,
+                           const char *x_text, const char *y_text,
+                           const void *x, const void *y, size_t count,
+                           size_t x_size, size_t y_size, double absolute,
+                           double relative, utest_uint64_t ulps, int flags,
+                           const char *msg);
+UTEST_WEAK
+int utest_check_array_near(int *const result, const char *file, int line,
+                           const char *x_text, const char *y_text,
+                           const void *x, const void *y, size_t count,
+                           size_t x_size, size_t y_size, double absolute,
+                           double relative, utest_uint64_t ulps, int flags,
+                           const char *msg) {
+  /* bucket 0 counts distances of 0, bucket n counts [2^(n-1), 2^n) */
+  size_t histogram[65];
+  const int nan_equal = (flags & UTEST_NAN_EQUAL) ? 1 : 0;
+  const int precision = (sizeof(float) == x_size) ? 9 : 17;
+  size_t failures;
+  size_t nans = 0;
+  size_t shown = 0;
+  size_t max_error_index = 0;
+  size_t max_ulps_index = 0;
+  double max_error = 0;
+  utest_uint64_t max_ulps = 0;
+  size_t i;
+
+  if ((x_size != y_size) ||
+      ((sizeof(float) != x_size) && (sizeof(double) != x_size))) {
+    if (!utest_count_failure(result)) {
+      return 1;
+    }
+
+    UTEST_PRINTF("%s:%i: Failure\n", file, line);
+    UTEST_PRINTF("  Expected : (%s) and (%s) to both be float or double "
+                 "arrays\n",
+                 x_text, y_text);
+    return 1;
+  }
+
+  failures = utest_array_near_failures(x, y, count, x_size, absolute, relative,
+                                       ulps, nan_equal);
+
+  if (0 == failures) {
+    return 0;
+  }
+
+  if (!utest_count_failure(result)) {
+    return 1;
+  }
+
+  memset(histogram, 0, sizeof(histogram));
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : (%s)[i] near (%s)[i] for i < %lu (within %g, %g "
+               "relative or %lu ULPs)\n",
+               x_text, y_text, UTEST_CAST(unsigned long, count), absolute,
+               relative, UTEST_CAST(unsigned long, ulps));
+  UTEST_PRINTF("    Actual : %lu elements differ\n",
+               UTEST_CAST(unsigned long, failures));
+
+  for (i = 0; i < count; i++) {
+    double xi, yi, error;
+    utest_uint64_t distance;
+    size_t bucket;
+
+    if (sizeof(float) == x_size) {
+      const float xf = UTEST_PTR_CAST(const float *, x)[i];
+      const float yf = UTEST_PTR_CAST(const float *, y)[i];
+      xi = UTEST_CAST(double, xf);
+      yi = UTEST_CAST(double, yf);
+      distance = utest_ulps_float(xf, yf);
+    } else {
+      xi = UTEST_PTR_CAST(const double *, x)[i];
+      yi = UTEST_PTR_CAST(const double *, y)[i];
+      distance = utest_ulps_double(xi, yi);
+    }
+
+    if (utest_isnan(xi) || utest_isnan(yi)) {
+      nans++;
+    } else {
+      error = utest_fabs(xi - yi);
+
+      if (error > max_error) {
+        max_error = error;
+        max_error_index = i;
+      }
+
+      if (distance > max_ulps) {
+        max_ulps = distance;
+        max_ulps_index = i;
+      }
+
+      bucket = 0;
+      while ((bucket < 64) && (distance >> bucket)) {
+        bucket++;
+      }
+
+      histogram[bucket]++;
+    }
+
+    if ((UTEST_MAX_MISMATCHES > shown) &&
+        !utest_within_tolerance(xi, yi, distance, absolute, relative, ulps,
+                                nan_equal)) {
+      char label[32];
+      UTEST_SNPRINTF(label, sizeof(label), "[%lu]",
+                     UTEST_CAST(unsigned long, i));
+      UTEST_PRINTF("%10s : %.*g vs %.*g\n", label, precision, xi, precision,
+                   yi);
+      shown++;
+    }
+  }
+
+  if (failures > shown) {
+    UTEST_PRINTF("           ... and %lu more\n",
+                 UTEST_CAST(unsigned long, failures - shown));
+  }
+
+  UTEST_PRINTF(" Max Error : %g at [%lu]\n", max_error,
+               UTEST_CAST(unsigned long, max_error_index));
+  UTEST_PRINTF("  Max ULPs : %lu at [%lu]\n",
+               UTEST_CAST(unsigned long, max_ulps),
+               UTEST_CAST(unsigned long, max_ulps_index));
+
+  for (i = 0; i < sizeof(histogram) / sizeof(histogram[0]); i++) {
+    char range[64];
+
+    if (0 == histogram[i]) {
+      continue;
+    } else if (2 > i) {
+      UTEST_SNPRINTF(range, sizeof(range), "%lu", UTEST_CAST(unsigned long, i));
+    } else {
+      UTEST_SNPRINTF(range, sizeof(range), "[2^%lu, 2^%lu)",
+                     UTEST_CAST(unsigned long, i - 1),
+                     UTEST_CAST(unsigned long, i));
+    }
+
+    UTEST_PRINTF("      ULPs : %-16s %lu\n", range,
+                 UTEST_CAST(unsigned long, histogram[i]));
+  }
+
+  if (nans) {
+    UTEST_PRINTF("      ULPs : %-16s %lu\n", "NaN",
+                 UTEST_CAST(unsigned long, nans));
+  }
+
+  if (strlen(msg) > 0) {
+    UTEST_PRINTF("   Message : %s\n", msg);
+  }
+
+  return 1;
+}
+
+/*
+   the size of the elements of x, which must be float or double. Where the
+   compiler lets us, any other element type is rejected at compile time;
+   otherwise only elements that aren't the size of a float or a double are
+   caught (at runtime), and EG. an int32_t array would be read as floats.
+*/
+#if defined(__cplusplus)
+static UTEST_INLINE size_t utest_float_element_size(const float *) {
+  return sizeof(float);
+}
+static UTEST_INLINE size_t utest_float_element_size(const double *) {
+  return sizeof(double);
+}
+#define UTEST_FLOAT_ELEMENT_SIZE(x) utest_float_element_size(x)
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#define UTEST_FLOAT_ELEMENT_SIZE(x)                                            \
+  _Generic(*(x), float : sizeof(float), double : sizeof(double))
+#elif defined(__clang__) || defined(__GNUC__)
+#define UTEST_FLOAT_ELEMENT_SIZE(x)                                            \
+  (sizeof(*(x)) +                                                              \
+   0 * sizeof(char[(__builtin_types_compatible_p(__typeof__(*(x)), float) ||   \
+                    __builtin_types_compatible_p(__typeof__(*(x)), double))    \
+                       ? 1                                                     \
+                       : -1]))
+#else
+#define UTEST_FLOAT_ELEMENT_SIZE(x) sizeof(*(x))
+#endif
+
+#define UTEST_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags, msg,   \
+                          is_assert)                                           \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    UTEST_CHECKED();                                                           \
+    if (utest_check_array_near(                                                \
+            utest_result, __FILE__, __LINE__, #x, #y, x, y,                    \
+            UTEST_CAST(size_t, count), UTEST_FLOAT_ELEMENT_SIZE(x),            \
+            UTEST_FLOAT_ELEMENT_SIZE(y), UTEST_CAST(double, absolute),         \
+            UTEST_CAST(double, relative), UTEST_CAST(utest_uint64_t, ulps),    \
+            flags, msg)) {                                                     \
+      utest_set_result(utest_result, UTEST_TEST_FAILURE);                      \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_ARRAY_NEAR(x, y, count, epsilon)                                \
+  UTEST_ARRAY_CLOSE(x, y, count, epsilon, 0, 0, 0, "", 0)
+#define ASSERT_ARRAY_NEAR(x, y, count, epsilon)                                \
+  UTEST_ARRAY_CLOSE(x, y, count, epsilon, 0, 0, 0, "", 1)
+#define EXPECT_ARRAY_ULP(x, y, count, ulps)                                    \
+  UTEST_ARRAY_CLOSE(x, y, count, 0, 0, ulps, 0, "", 0)
+#define ASSERT_ARRAY_ULP(x, y, count, ulps)                                    \
+  UTEST_ARRAY_CLOSE(x, y, count, 0, 0, ulps, 0, "", 1)
+#define EXPECT_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags)       \
+  UTEST_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags, "", 0)
+#define ASSERT_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags)       \
+  UTEST_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags, "", 1)
+#define EXPECT_ARRAY_NEAR_MSG(x, y, count, epsilon, msg)                       \
+  UTEST_ARRAY_CLOSE(x, y, count, epsilon, 0, 0, 0, msg, 0)
+#define ASSERT_ARRAY_NEAR_MSG(x, y, count, epsilon, msg)                       \
+  UTEST_ARRAY_CLOSE(x, y, count, epsilon, 0, 0, 0, msg, 1)
+#define EXPECT_ARRAY_ULP_MSG(x, y, count, ulps, msg)                           \
+  UTEST_ARRAY_CLOSE(x, y, count, 0, 0, ulps, 0, msg, 0)
+#define ASSERT_ARRAY_ULP_MSG(x, y, count, ulps, msg)                           \
+  UTEST_ARRAY_CLOSE(x, y, count, 0, 0, ulps, 0, msg, 1)
+#define EXPECT_ARRAY_CLOSE_MSG(x, y, count, absolute, relative, ulps, flags,   \
+                               msg)                                            \
+  UTEST_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags, msg, 0)
+#define ASSERT_ARRAY_CLOSE_MSG(x, y, count, absolute, relative, ulps, flags,   \
+                               msg)                                            \
+  UTEST_ARRAY_CLOSE(x, y, count, absolute, relative, ulps, flags, msg, 1)
+
+#if defined(UTEST_HAS_EXCEPTIONS)
+/* caught is 0 if nothing was thrown, or 2 if something else was */
+UTEST_WEAK UTEST_COLD void
+utest_exception_failed(int *const result, const char *const file,
+                       const int line, const char *const type_text,
+                       const int caught, const char *const msg);
+UTEST_WEAK UTEST_COLD void
+utest_exception_failed(int *const result, const char *const file,
+                       const int line, const char *const type_text,
+                       const int caught, const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : %s exception\n", type_text);
+  UTEST_PRINTF("    Actual : %s\n",
+               (2 == caught) ? "Unexpected exception" : "No exception");
+  utest_failure_message(msg);
+}
+
+UTEST_WEAK UTEST_COLD void utest_exception_message_failed(
+    int *const result, const char *const file, const int line,
+    const char *const type_text, const char *const expected,
+    const char *const actual, const char *const msg);
+UTEST_WEAK UTEST_COLD void utest_exception_message_failed(
+    int *const result, const char *const file, const int line,
+    const char *const type_text, const char *const expected,
+    const char *const actual, const char *const msg) {
+  utest_set_result(result, UTEST_TEST_FAILURE);
+  if (!utest_count_failure(result)) {
+    return;
+  }
+
+  UTEST_PRINTF("%s:%i: Failure\n", file, line);
+  UTEST_PRINTF("  Expected : %s exception with message %s\n", type_text,
+               expected);
+  UTEST_PRINTF("    Actual message : %s\n", actual);
+  utest_failure_message(msg);
+}
+
+#define UTEST_EXCEPTION(x, exception_type, msg, is_assert)                     \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    int exception_caught = 0;                                                  \
+    UTEST_CHECKED();                                                           \
+    try {                                                                      \
+      x;                                                                       \
+    } catch (const exception_type &) {                                         \
+      exception_caught = 1;                                                    \
+    } catch (...) {                                                            \
+      exception_caught = 2;                                                    \
+    }                                                                          \
+    if (UTEST_UNLIKELY(1 != exception_caught)) {                               \
+      utest_exception_failed(utest_result, __FILE__, __LINE__,                 \
+                             #exception_type, exception_caught, msg);          \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_EXCEPTION(x, exception_type)                                    \
+  UTEST_EXCEPTION(x, exception_type, "", 0)
+#define EXPECT_EXCEPTION_MSG(x, exception_type, msg)                           \
+  UTEST_EXCEPTION(x, exception_type, msg, 0)
+#define ASSERT_EXCEPTION(x, exception_type)                                    \
+  UTEST_EXCEPTION(x, exception_type, "", 1)
+#define ASSERT_EXCEPTION_MSG(x, exception_type, msg)                           \
+  UTEST_EXCEPTION(x, exception_type, msg, 1)
+
+#define UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message,     \
+                                     msg, is_assert)                           \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    int exception_caught = 0;                                                  \
+    UTEST_CHECKED();                                                           \
+    try {                                                                      \
+      x;                                                                       \
+    } catch (const exception_type &e) {                                        \
+      const char *const what = e.what();                                       \
+      exception_caught = 1;                                                    \
+      if (UTEST_UNLIKELY(0 != UTEST_STRNCMP(what, exception_message,           \
+                                            strlen(exception_message)))) {     \
+        utest_exception_message_failed(utest_result, __FILE__, __LINE__,       \
+                                       #exception_type, exception_message,     \
+                                       what, msg);                             \
+        exception_caught = 3;                                                  \
+      }                                                                        \
+    } catch (...) {                                                            \
+      exception_caught = 2;                                                    \
+    }                                                                          \
+    if (UTEST_UNLIKELY(1 != exception_caught)) {                               \
+      if (3 != exception_caught) {                                             \
+        utest_exception_failed(utest_result, __FILE__, __LINE__,               \
+                               #exception_type, exception_caught, msg);        \
+      }                                                                        \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message)    \
+  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, "", 0)
+#define EXPECT_EXCEPTION_WITH_MESSAGE_MSG(x, exception_type,                   \
+                                          exception_message, msg)              \
+  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, msg, 0)
+#define ASSERT_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message)    \
+  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, "", 1)
+#define ASSERT_EXCEPTION_WITH_MESSAGE_MSG(x, exception_type,                   \
+                                          exception_message, msg)              \
+  UTEST_EXCEPTION_WITH_MESSAGE(x, exception_type, exception_message, msg, 1)
+#endif
+
+#define UTEST(SET, NAME)                                                       \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *utest_result);                     \
+  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
+    (void)utest_index;                                                         \
+    utest_run_##SET##_##NAME(utest_result);                                    \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    const size_t index = utest_state.tests_length++;                           \
+    const char *name_part = #SET "." #NAME;                                    \
+    const size_t name_size = strlen(name_part) + 1;                            \
+    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
+    utest_state.tests = UTEST_PTR_CAST(                                        \
+        struct utest_test_state_s *,                                           \
+        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
+                      sizeof(struct utest_test_state_s) *                      \
+                          utest_state.tests_length));                          \
+    if (utest_state.tests) {                                                   \
+      utest_state.tests[index].func = &utest_##SET##_##NAME;                   \
+      utest_state.tests[index].name = name;                                    \
+      utest_state.tests[index].index = 0;                                      \
+      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
+    } else if (name) {                                                         \
+      free(name);                                                              \
+    }                                                                          \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result)
+
+#define UTEST_F_SETUP(FIXTURE)                                                 \
+  static void utest_f_setup_##FIXTURE(int *utest_result,                       \
+                                      struct FIXTURE *utest_fixture)
+
+#define UTEST_F_TEARDOWN(FIXTURE)                                              \
+  static void utest_f_teardown_##FIXTURE(int *utest_result,                    \
+                                         struct FIXTURE *utest_fixture)
+
+#define UTEST_F_POOL(FIXTURE, RESET)                                           \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_f_setup_##FIXTURE(int *, struct FIXTURE *);                \
+  static void utest_f_teardown_##FIXTURE(int *, struct FIXTURE *);             \
+  static void utest_f_pool_setup_##FIXTURE(int *utest_result, void *fixture) { \
+    utest_f_setup_##FIXTURE(utest_result,                                      \
+                            UTEST_PTR_CAST(struct FIXTURE *, fixture));        \
+  }                                                                            \
+  static void utest_f_pool_teardown_##FIXTURE(int *utest_result,               \
+                                              void *fixture) {                 \
+    utest_f_teardown_##FIXTURE(utest_result,                                   \
+                               UTEST_PTR_CAST(struct FIXTURE *, fixture));     \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_pool_##FIXTURE) {                           \
+    utest_fixture_pool_register(#FIXTURE, __FILE__, sizeof(struct FIXTURE),    \
+                                &utest_f_pool_setup_##FIXTURE,                 \
+                                &utest_f_pool_teardown_##FIXTURE, RESET);      \
+  }
+
+/*
+   declaring a reset hook for a fixture opts it into the fixture pool - the
+   fixture is set up once, and between tests the reset hook is called instead
+   of a teardown/setup pair. If the reset hook fails (EG. an ASSERT_* within it
+   fires) the pooled fixture is torn down and set up from scratch instead.
+*/
+#define UTEST_F_RESET(FIXTURE)                                                 \
+  static void utest_f_reset_##FIXTURE(int *, struct FIXTURE *);                \
+  static void utest_f_pool_reset_##FIXTURE(int *, void *);                     \
+  UTEST_F_POOL(FIXTURE, &utest_f_pool_reset_##FIXTURE)                         \
+  static void utest_f_pool_reset_##FIXTURE(int *utest_result, void *fixture) { \
+    utest_f_reset_##FIXTURE(utest_result,                                      \
+                            UTEST_PTR_CAST(struct FIXTURE *, fixture));        \
+  }                                                                            \
+  static void utest_f_reset_##FIXTURE(int *utest_result,                       \
+                                      struct FIXTURE *utest_fixture)
+
+/*
+   declaring a fixture as a snapshot means its setup is run once in the test
+   runner, and each test using the fixture is then run in a forked child
+   process that inherits the fixture via copy-on-write pages. Tests can mutate
+   the fixture freely without the next test seeing it. On platforms without
+   fork the fixture is instead torn down and set up again for every test.
+*/
+#define UTEST_F_SNAPSHOT(FIXTURE) UTEST_F_POOL(FIXTURE, UTEST_NULL)
+
+UTEST_WEAK
+void utest_fixture_pool_register(const char *name, const char *file,
+                                 size_t size, utest_fixture_hook_t setup,
+                                 utest_fixture_hook_t teardown,
+                                 utest_fixture_hook_t reset);
+UTEST_WEAK
+void utest_fixture_pool_register(const char *name, const char *file,
+                                 size_t size, utest_fixture_hook_t setup,
+                                 utest_fixture_hook_t teardown,
+                                 utest_fixture_hook_t reset) {
+  const size_t index = utest_state.fixture_pools_length++;
+  utest_state.fixture_pools = UTEST_PTR_CAST(
+      struct utest_fixture_pool_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.fixture_pools),
+                    sizeof(struct utest_fixture_pool_s) *
+                        utest_state.fixture_pools_length));
+  if (utest_state.fixture_pools) {
+    utest_state.fixture_pools[index].name = name;
+    utest_state.fixture_pools[index].file = file;
+    utest_state.fixture_pools[index].fixture = UTEST_NULL;
+    utest_state.fixture_pools[index].size = size;
+    utest_state.fixture_pools[index].setup = setup;
+    utest_state.fixture_pools[index].teardown = teardown;
+    utest_state.fixture_pools[index].reset = reset;
+  } else {
+    utest_state.fixture_pools_length = 0;
+  }
+}
+
+/*
+   fixtures are looked up by name and by the file that declared them, as the
+   same fixture name can be (and is!) reused across translation units.
+*/
+UTEST_WEAK
+struct utest_fixture_pool_s *utest_fixture_pool_find(const char *name,
+                                                     const char *file);
+UTEST_WEAK
+struct utest_fixture_pool_s *utest_fixture_pool_find(const char *name,
+                                                     const char *file) {
+  size_t index;
+
+  for (index = 0; index < utest_state.fixture_pools_length; index++) {
+    struct utest_fixture_pool_s *const pool = &utest_state.fixture_pools[index];
+
+    if ((0 == strcmp(pool->name, name)) && (0 == strcmp(pool->file, file))) {
+      return pool;
+    }
+  }
+
+  return UTEST_NULL;
+}
+
+/*
+   get the pooled fixture ready for the next test, building it if it doesn't
+   exist yet, and falling back to a full teardown/setup if the reset failed.
+   The reset and the teardown after it aren't part of the test, so they fail
+   into results of their own - but if the fixture couldn't even be torn down
+   there is nothing left to build the test's fixture from, and the test fails.
+*/
+UTEST_WEAK
+void *utest_fixture_pool_acquire(struct utest_fixture_pool_s *pool,
+                                 int *utest_result);
+UTEST_WEAK
+void *utest_fixture_pool_acquire(struct utest_fixture_pool_s *pool,
+                                 int *utest_result) {
+  if ((UTEST_NULL != pool->fixture) && (UTEST_NULL == pool->reset)) {
+    /* snapshots are never modified by the tests that use them */
+    return pool->fixture;
+  } else if (UTEST_NULL != pool->fixture) {
+    int reset_result = UTEST_TEST_PASSED;
+    int teardown_result = UTEST_TEST_PASSED;
+    pool->reset(&reset_result, pool->fixture);
+
+    if (UTEST_TEST_PASSED == reset_result) {
+      return pool->fixture;
+    }
+
+    UTEST_PRINTF("     Reset : pooled fixture %s failed to reset, so it is "
+                 "being set up again\n",
+                 pool->name);
+    pool->teardown(&teardown_result, pool->fixture);
+
+    if (UTEST_TEST_FAILURE == teardown_result) {
+      UTEST_PRINTF("  Teardown : pooled fixture %s failed to tear down\n",
+                   pool->name);
+      free(pool->fixture);
+      pool->fixture = UTEST_NULL;
+      *utest_result = UTEST_TEST_FAILURE;
+      return UTEST_NULL;
+    }
+  } else {
+    pool->fixture = malloc(pool->size);
+
+    if (UTEST_NULL == pool->fixture) {
+      *utest_result = UTEST_TEST_FAILURE;
+      return UTEST_NULL;
+    }
+  }
+
+  memset(pool->fixture, 0, pool->size);
+  pool->setup(utest_result, pool->fixture);
+
+  if (UTEST_TEST_PASSED != *utest_result) {
+    /* release whatever the setup did acquire before it failed */
+    int teardown_result = UTEST_TEST_PASSED;
+    pool->teardown(&teardown_result, pool->fixture);
+    free(pool->fixture);
+    pool->fixture = UTEST_NULL;
+  }
+
+  return pool->fixture;
+}
+
+#if defined(UTEST_HAS_FORK)
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+/*
+   a test run in a forked process (against a snapshot, or by a worker of the
+   --processes pool) sends its result back to its parent down a pipe, followed
+   by the properties it recorded.
+*/
+struct utest_child_result_s {
+  utest_uint64_t result;
+  utest_uint64_t ns;
+  utest_uint64_t checked;
+  utest_uint64_t assertions_failed;
+  /* the length of the test's properties, which are sent after the result */
+  utest_uint64_t properties_length;
+};
+
+#if defined(UTEST_HAS_FORK)
+/* read or write all of size bytes, returning non-zero if they couldn't be */
+static UTEST_INLINE int utest_read_all(const int fd, void *data, size_t size) {
+  char *bytes = UTEST_PTR_CAST(char *, data);
+
+  while (0 < size) {
+    const ssize_t got = read(fd, bytes, size);
+
+    if ((0 > got) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= got) {
+      return 1;
+    }
+
+    bytes += got;
+    size -= UTEST_CAST(size_t, got);
+  }
+
+  return 0;
+}
+
+static UTEST_INLINE int utest_write_all(const int fd, const void *data,
+                                        size_t size) {
+  const char *bytes = UTEST_PTR_CAST(const char *, data);
+
+  while (0 < size) {
+    const ssize_t wrote = write(fd, bytes, size);
+
+    if ((0 > wrote) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= wrote) {
+      return 1;
+    }
+
+    bytes += wrote;
+    size -= UTEST_CAST(size_t, wrote);
+  }
+
+  return 0;
+}
+
+/* append the size bytes of properties a child sent to the running test's */
+static UTEST_INLINE int utest_read_properties(const int fd, const size_t size) {
+  if ((0 != utest_properties_reserve(size)) ||
+      (0 != utest_read_all(fd, utest_state.properties +
+                                   utest_state.properties_length,
+                           size))) {
+    return 1;
+  }
+
+  utest_state.properties_length += size;
+  utest_state.properties[utest_state.properties_length] = '\0';
+  return 0;
+}
+#endif
+
+/*
+   for a snapshot fixture, fork a child to run the test in. Returns non-zero if
+   the caller should run the test (because it is the child, or because the
+   fixture is not a snapshot), and zero in the parent once the child has
+   finished and its result, assertion counts and properties have been taken.
+*/
+UTEST_WEAK
+int utest_fixture_pool_fork(struct utest_fixture_pool_s *pool,
+                            int *utest_result);
+UTEST_WEAK
+int utest_fixture_pool_fork(struct utest_fixture_pool_s *pool,
+                            int *utest_result) {
+#if defined(UTEST_HAS_FORK)
+  struct utest_child_result_s message;
+  int results[2];
+  pid_t pid;
+  int status = 0;
+
+  if (UTEST_NULL != pool->reset) {
+    return 1;
+  }
+
+  if (0 != pipe(results)) {
+    UTEST_PRINTF("  Snapshot : failed to create a pipe (errno %d)\n", errno);
+    *utest_result = UTEST_TEST_FAILURE;
+    return 0;
+  }
+
+  /* flush before forking so the child doesn't inherit buffered output */
+  fflush(stdout);
+  if (utest_state.output) {
+    fflush(utest_state.output);
+  }
+
+  pid = fork();
+
+  if (0 == pid) {
+    /* the child counts its own assertions, and the parent adds them to its */
+    close(results[0]);
+    utest_state.snapshot = pool;
+    utest_state.child_pipe = results[1];
+    utest_state.assertions_failed = 0;
+    utest_thread_context()->assertions_checked = 0;
+    return 1;
+  }
+
+  close(results[1]);
+
+  if (0 > pid) {
+    close(results[0]);
+    UTEST_PRINTF("  Snapshot : failed to fork (errno %d)\n", errno);
+    *utest_result = UTEST_TEST_FAILURE;
+    return 0;
+  }
+
+  /* take what the child sent before reaping it, so it can't fill the pipe */
+  if (0 == utest_read_all(results[0], &message, sizeof(message))) {
+    utest_thread_context()->assertions_checked += message.checked;
+    utest_state.assertions_failed += message.assertions_failed;
+    utest_read_properties(results[0],
+                          UTEST_CAST(size_t, message.properties_length));
+  }
+
+  close(results[0]);
+
+  while ((0 > waitpid(pid, &status, 0)) && (EINTR == errno)) {
+  }
+
+  /* the child wrote to the output file behind our back, so catch up to it */
+  if (utest_state.output) {
+    fseek(utest_state.output, 0, SEEK_END);
+  }
+
+  if (WIFEXITED(status)) {
+    *utest_result = WEXITSTATUS(status);
+  } else {
+    if (WIFSIGNALED(status)) {
+      UTEST_PRINTF("  Snapshot : test process killed by signal %d\n",
+                   WTERMSIG(status));
+    }
+    *utest_result = UTEST_TEST_FAILURE;
+  }
+
+  return 0;
+#else
+  (void)pool;
+  (void)utest_result;
+  return 1;
+#endif
+}
+
+/*
+   a forked child that ran a test against a snapshot reports the result back to
+   the parent through its exit code, and sends the assertions it checked and
+   the properties it recorded down the pipe it was given.
+*/
+UTEST_WEAK
+void utest_fixture_pool_exit_child(int result, utest_uint64_t checked);
+UTEST_WEAK
+void utest_fixture_pool_exit_child(int result, utest_uint64_t checked) {
+#if defined(UTEST_HAS_FORK)
+  if (UTEST_NULL != utest_state.snapshot) {
+    struct utest_child_result_s message;
+
+    fflush(stdout);
+    if (utest_state.output) {
+      fflush(utest_state.output);
+    }
+
+    memset(&message, 0, sizeof(message));
+    message.result = UTEST_CAST(utest_uint64_t, result);
+    message.checked = checked;
+    message.assertions_failed = utest_state.assertions_failed;
+    message.properties_length = utest_state.properties_length;
+
+    if (0 == utest_write_all(utest_state.child_pipe, &message,
+                             sizeof(message))) {
+      utest_write_all(utest_state.child_pipe, utest_state.properties,
+                      utest_state.properties_length);
+    }
+
+    _exit(result);
+  }
+#else
+  (void)result;
+  (void)checked;
+#endif
+}
+
+/*
+   a pooled fixture is kept for the next test, unless the test failed - in
+   which case we cannot trust its state and tear it down right away. Snapshot
+   fixtures that could not be forked have to be torn down after every test.
+*/
+UTEST_WEAK
+void utest_fixture_pool_release(struct utest_fixture_pool_s *pool,
+                                int *utest_result);
+UTEST_WEAK
+void utest_fixture_pool_release(struct utest_fixture_pool_s *pool,
+                                int *utest_result) {
+  if (UTEST_NULL != utest_state.snapshot) {
+    /* the child's copy of the snapshot just goes away with the child */
+    return;
+  }
+
+  if ((UTEST_TEST_FAILURE == *utest_result) || (UTEST_NULL == pool->reset)) {
+    pool->teardown(utest_result, pool->fixture);
+    free(pool->fixture);
+    pool->fixture = UTEST_NULL;
+  }
+}
+
+/*
+   tear down the fixtures that were still being kept in their fixture pools,
+   returning how many of the teardowns failed.
+*/
+UTEST_WEAK
+utest_uint64_t utest_fixture_pools_teardown(const char *red, const char *reset);
+UTEST_WEAK
+utest_uint64_t utest_fixture_pools_teardown(const char *red,
+                                            const char *reset) {
+  utest_uint64_t failed = 0;
+  size_t index;
+
+  for (index = 0; index < utest_state.fixture_pools_length; index++) {
+    struct utest_fixture_pool_s *const pool = &utest_state.fixture_pools[index];
+    int result = UTEST_TEST_PASSED;
+
+    if (UTEST_NULL == pool->fixture) {
+      continue;
+    }
+
+    pool->teardown(&result, pool->fixture);
+    free(pool->fixture);
+    pool->fixture = UTEST_NULL;
+
+    if (UTEST_TEST_FAILURE == result) {
+      printf("%s[  FAILED  ]%s %s (pooled fixture teardown)\n", red, reset,
+             pool->name);
+      failed++;
+    }
+  }
+
+  return failed;
+}
+
+/*
+   death tests run their statement in a forked child, so that the statement can
+   crash or exit without taking the runner down with it. The child's stderr goes
+   down a pipe for the parent to match against a regex, and if the statement
+   returns (or throws) the child says so down a second pipe before it exits.
+*/
+struct utest_death_s {
+  int pid;
+  /* the read ends of the child's stderr, and of the pipe it reports through */
+  int output;
+  int returned;
+};
+
+#if defined(UTEST_HAS_FORK)
+#include <regex.h>
+#include <sys/resource.h>
+#endif
+
+/* the outcomes EXPECT_EXIT can expect (EXPECT_DEATH takes any but a return) */
+#define UTEST_EXITED_WITH_CODE(code) (code)
+#define UTEST_KILLED_BY_SIGNAL(signal) (-(signal))
+
+/*
+   fork a child to run a death test's statement in. Returns 1 in the child,
+   which should run the statement and then call utest_death_return, and 0 in
+   the parent (with death->pid negative if the child couldn't be forked).
+*/
+UTEST_WEAK int utest_death_fork(struct utest_death_s *death);
+UTEST_WEAK int utest_death_fork(struct utest_death_s *death) {
+#if defined(UTEST_HAS_FORK)
+  int output[2];
+  int returned[2];
+  pid_t pid;
+
+  death->pid = -1;
+
+  if (0 != pipe(output)) {
+    return 0;
+  }
+
+  if (0 != pipe(returned)) {
+    close(output[0]);
+    close(output[1]);
+    return 0;
+  }
+
+  /* flush before forking so the child doesn't inherit buffered output */
+  fflush(stdout);
+  fflush(stderr);
+  if (utest_state.output) {
+    fflush(utest_state.output);
+  }
+
+  pid = fork();
+
+  if (0 == pid) {
+    struct rlimit core;
+
+    close(output[0]);
+    close(returned[0]);
+    dup2(output[1], STDERR_FILENO);
+    close(output[1]);
+
+    /* the child is expected to crash, and dumping its core is slow */
+    core.rlim_cur = 0;
+    core.rlim_max = 0;
+    setrlimit(RLIMIT_CORE, &core);
+
+    /* the statement reports how it finished, even within a snapshot's child */
+    utest_state.output = UTEST_NULL;
+    utest_state.snapshot = UTEST_NULL;
+    utest_state.death_child = 1;
+    utest_state.child_pipe = returned[1];
+    return 1;
+  }
+
+  close(output[1]);
+  close(returned[1]);
+
+  if (0 > pid) {
+    close(output[0]);
+    close(returned[0]);
+    return 0;
+  }
+
+  death->pid = UTEST_CAST(int, pid);
+  death->output = output[0];
+  death->returned = returned[0];
+  return 0;
+#else
+  death->pid = -1;
+  return 0;
+#endif
+}
+
+/*
+   in the child of a death test, report how the statement finished ('r' for
+   returned, 'e' for threw) and exit. Does nothing in any other process.
+*/
+UTEST_WEAK void utest_death_return(char how);
+UTEST_WEAK void utest_death_return(char how) {
+#if defined(UTEST_HAS_FORK)
+  if (utest_state.death_child) {
+    fflush(stdout);
+    if (1 != write(utest_state.child_pipe, &how, 1)) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+#else
+  (void)how;
+#endif
+}
+
+/*
+   wait for the child of a death test, and check it died the way it was
+   expected to with stderr matching regex (UTEST_NULL or "" matches anything).
+   When any is set the child can die any way but returning, otherwise expected
+   is one of UTEST_EXITED_WITH_CODE or UTEST_KILLED_BY_SIGNAL. Returns non-zero
+   if the check failed, or couldn't be made.
+*/
+UTEST_WEAK int utest_death_check(int *const result, const char *const file,
+                                 const int line, const char *const x_text,
+                                 struct utest_death_s *death, const int any,
+                                 const int expected, const char *const regex,
+                                 const char *const msg);
+UTEST_WEAK int utest_death_check(int *const result, const char *const file,
+                                 const int line, const char *const x_text,
+                                 struct utest_death_s *death, const int any,
+                                 const int expected, const char *const regex,
+                                 const char *const msg) {
+#if defined(UTEST_HAS_FORK)
+  char *output = UTEST_NULL;
+  size_t length = 0;
+  size_t capacity = 0;
+  char how = '\0';
+  int status = 0;
+  int died;
+  int matched = 1;
+  int invalid = 0;
+  ssize_t got;
+  regex_t compiled;
+
+  if (0 > death->pid) {
+    utest_set_result(result, UTEST_TEST_FAILURE);
+    if (utest_count_failure(result)) {
+      UTEST_PRINTF("%s:%i: Failure\n", file, line);
+      UTEST_PRINTF("     Death : failed to fork (errno %d)\n", errno);
+      utest_failure_message(msg);
+    }
+    return 1;
+  }
+
+  /* drain stderr before waiting, or a chatty child fills the pipe and stalls */
+  for (;;) {
+    if (capacity < length + 256) {
+      char *const grown =
+          UTEST_PTR_CAST(char *, realloc(output, 2 * capacity + 256));
+      if (UTEST_NULL == grown) {
+        break;
+      }
+      output = grown;
+      capacity = 2 * capacity + 256;
+    }
+
+    got = read(death->output, output + length, capacity - length - 1);
+
+    if ((0 > got) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= got) {
+      break;
+    }
+
+    length += UTEST_CAST(size_t, got);
+  }
+
+  close(death->output);
+
+  if (UTEST_NULL != output) {
+    output[length] = '\0';
+  }
+
+  while ((0 > waitpid(UTEST_CAST(pid_t, death->pid), &status, 0)) &&
+         (EINTR == errno)) {
+  }
+
+  while ((0 > read(death->returned, &how, 1)) && (EINTR == errno)) {
+  }
+
+  close(death->returned);
+
+  if ('\0' != how) {
+    died = 0;
+  } else if (any) {
+    died = WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status));
+  } else if (0 > expected) {
+    died = WIFSIGNALED(status) && (-expected == WTERMSIG(status));
+  } else {
+    died = WIFEXITED(status) && (expected == WEXITSTATUS(status));
+  }
+
+  if ((UTEST_NULL != regex) && ('\0' != *regex)) {
+    if (0 != regcomp(&compiled, regex, REG_EXTENDED | REG_NOSUB)) {
+      invalid = 1;
+      matched = 0;
+    } else {
+      matched = 0 == regexec(&compiled, output ? output : "", 0, UTEST_NULL, 0);
+      regfree(&compiled);
+    }
+  }
+
+  if (died && matched) {
+    free(output);
+    return 0;
+  }
+
+  utest_set_result(result, UTEST_TEST_FAILURE);
+
+  if (utest_count_failure(result)) {
+    UTEST_PRINTF("%s:%i: Failure\n", file, line);
+
+    if (!died) {
+      if (any) {
+        UTEST_PRINTF("  Expected : %s to die\n", x_text);
+      } else if (0 > expected) {
+        UTEST_PRINTF("  Expected : %s to be killed by signal %d\n", x_text,
+                     -expected);
+      } else {
+        UTEST_PRINTF("  Expected : %s to exit with code %d\n", x_text,
+                     expected);
+      }
+
+      if ('r' == how) {
+        UTEST_PRINTF("    Actual : returned\n");
+      } else if ('e' == how) {
+        UTEST_PRINTF("    Actual : threw an exception\n");
+      } else if (WIFSIGNALED(status)) {
+        UTEST_PRINTF("    Actual : killed by signal %d\n", WTERMSIG(status));
+      } else {
+        UTEST_PRINTF("    Actual : exited with code %d\n",
+                     WEXITSTATUS(status));
+      }
+    }
+
+    if (invalid) {
+      UTEST_PRINTF("     Regex : '%s' is not a valid extended regex\n", regex);
+    } else if (!matched) {
+      UTEST_PRINTF("  Expected : stderr matching '%s'\n", regex);
+      UTEST_PRINTF("    Actual : '%s'\n", output ? output : "");
+    }
+
+    utest_failure_message(msg);
+  }
+
+  free(output);
+  return 1;
+#else
+  (void)file;
+  (void)line;
+  (void)x_text;
+  (void)death;
+  (void)any;
+  (void)expected;
+  (void)regex;
+  (void)msg;
+  UTEST_PRINTF("   Skipped : 'death tests need fork()'\n");
+  utest_set_result(result, UTEST_TEST_SKIPPED);
+  return 1;
+#endif
+}
+
+#if defined(UTEST_HAS_EXCEPTIONS)
+#define UTEST_DEATH_STATEMENT(x)                                               \
+  try {                                                                        \
+    x;                                                                         \
+  } catch (...) {                                                              \
+    utest_death_return('e');                                                   \
+  }
+#else
+#define UTEST_DEATH_STATEMENT(x) x;
+#endif
+
+#define UTEST_DEATH(x, any, expected, regex, msg, is_assert)                   \
+  UTEST_SURPRESS_WARNING_BEGIN do {                                            \
+    struct utest_death_s utest_death;                                          \
+    UTEST_CHECKED();                                                           \
+    if (utest_death_fork(&utest_death)) {                                      \
+      UTEST_DEATH_STATEMENT(x)                                                 \
+      utest_death_return('r');                                                 \
+    }                                                                          \
+    if (utest_death_check(utest_result, __FILE__, __LINE__, #x, &utest_death,  \
+                          any, expected, regex, msg)) {                        \
+      if (is_assert) UTEST_ASSERT_RETURN();                                    \
+    }                                                                          \
+  }                                                                            \
+  while (0)                                                                    \
+  UTEST_SURPRESS_WARNING_END
+
+#define EXPECT_DEATH(x, regex) UTEST_DEATH(x, 1, 0, regex, "", 0)
+#define EXPECT_DEATH_MSG(x, regex, msg) UTEST_DEATH(x, 1, 0, regex, msg, 0)
+#define ASSERT_DEATH(x, regex) UTEST_DEATH(x, 1, 0, regex, "", 1)
+#define ASSERT_DEATH_MSG(x, regex, msg) UTEST_DEATH(x, 1, 0, regex, msg, 1)
+
+#define EXPECT_EXIT(x, expected, regex)                                        \
+  UTEST_DEATH(x, 0, expected, regex, "", 0)
+#define EXPECT_EXIT_MSG(x, expected, regex, msg)                               \
+  UTEST_DEATH(x, 0, expected, regex, msg, 0)
+#define ASSERT_EXIT(x, expected, regex)                                        \
+  UTEST_DEATH(x, 0, expected, regex, "", 1)
+#define ASSERT_EXIT_MSG(x, expected, regex, msg)                               \
+  UTEST_DEATH(x, 0, expected, regex, msg, 1)
+
+#if defined(__GNUC__) && __GNUC__ >= 8 && defined(__cplusplus)
+#define UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN                                  \
+  _Pragma("GCC diagnostic push")                                               \
+      _Pragma("GCC diagnostic ignored \"-Wclass-memaccess\"")
+#define UTEST_FIXTURE_SURPRESS_WARNINGS_END _Pragma("GCC diagnostic pop")
+#else
+#define UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN
+#define UTEST_FIXTURE_SURPRESS_WARNINGS_END
+#endif
+
+#define UTEST_F(FIXTURE, NAME)                                                 \
+  UTEST_FIXTURE_SURPRESS_WARNINGS_BEGIN                                        \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_f_setup_##FIXTURE(int *, struct FIXTURE *);                \
+  static void utest_f_teardown_##FIXTURE(int *, struct FIXTURE *);             \
+  static void utest_run_##FIXTURE##_##NAME(int *, struct FIXTURE *);           \
+  static void utest_f_##FIXTURE##_##NAME(int *utest_result,                    \
+                                         size_t utest_index) {                 \
+    struct FIXTURE fixture;                                                    \
+    struct utest_fixture_pool_s *const pool =                                  \
+        utest_fixture_pool_find(#FIXTURE, __FILE__);                           \
+    (void)utest_index;                                                         \
+    if (UTEST_NULL != pool) {                                                  \
+      struct FIXTURE *const pooled = UTEST_PTR_CAST(                           \
+          struct FIXTURE *, utest_fixture_pool_acquire(pool, utest_result));   \
+      if (UTEST_TEST_PASSED != *utest_result) {                                \
+        return;                                                                \
+      }                                                                        \
+      if (utest_fixture_pool_fork(pool, utest_result)) {                       \
+        utest_run_##FIXTURE##_##NAME(utest_result, pooled);                    \
+        utest_fixture_pool_release(pool, utest_result);                        \
+      }                                                                        \
+      return;                                                                  \
+    }                                                                          \
+    memset(&fixture, 0, sizeof(fixture));                                      \
+    utest_f_setup_##FIXTURE(utest_result, &fixture);                           \
+    if (UTEST_TEST_PASSED != *utest_result) {                                  \
+      return;                                                                  \
+    }                                                                          \
+    utest_run_##FIXTURE##_##NAME(utest_result, &fixture);                      \
+    utest_f_teardown_##FIXTURE(utest_result, &fixture);                        \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##FIXTURE##_##NAME) {                       \
+    const size_t index = utest_state.tests_length++;                           \
+    const char *name_part = #FIXTURE "." #NAME;                                \
+    const size_t name_size = strlen(name_part) + 1;                            \
+    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
+    utest_state.tests = UTEST_PTR_CAST(                                        \
+        struct utest_test_state_s *,                                           \
+        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
+                      sizeof(struct utest_test_state_s) *                      \
+                          utest_state.tests_length));                          \
+    if (utest_state.tests) {                                                   \
+      utest_state.tests[index].func = &utest_f_##FIXTURE##_##NAME;             \
+      utest_state.tests[index].name = name;                                    \
+      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
+    } else if (name) {                                                         \
+      free(name);                                                              \
+    }                                                                          \
+  }                                                                            \
+  UTEST_FIXTURE_SURPRESS_WARNINGS_END                                          \
+  void utest_run_##FIXTURE##_##NAME(int *utest_result,                         \
+                                    struct FIXTURE *utest_fixture)
+
+#define UTEST_I_SETUP(FIXTURE)                                                 \
+  static void utest_i_setup_##FIXTURE(                                         \
+      int *utest_result, struct FIXTURE *utest_fixture, size_t utest_index)
+
+#define UTEST_I_TEARDOWN(FIXTURE)                                              \
+  static void utest_i_teardown_##FIXTURE(                                      \
+      int *utest_result, struct FIXTURE *utest_fixture, size_t utest_index)
+
+#define UTEST_I(FIXTURE, NAME, INDEX)                                          \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##FIXTURE##_##NAME##_##INDEX(int *, struct FIXTURE *); \
+  static void utest_i_##FIXTURE##_##NAME##_##INDEX(int *utest_result,          \
+                                                   size_t index) {             \
+    struct FIXTURE fixture;                                                    \
+    memset(&fixture, 0, sizeof(fixture));                                      \
+    utest_i_setup_##FIXTURE(utest_result, &fixture, index);                    \
+    if (UTEST_TEST_PASSED != *utest_result) {                                  \
+      return;                                                                  \
+    }                                                                          \
+    utest_run_##FIXTURE##_##NAME##_##INDEX(utest_result, &fixture);            \
+    utest_i_teardown_##FIXTURE(utest_result, &fixture, index);                 \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##FIXTURE##_##NAME##_##INDEX) {             \
+    size_t i;                                                                  \
+    utest_uint64_t iUp;                                                        \
+    for (i = 0; i < (INDEX); i++) {                                            \
+      const size_t index = utest_state.tests_length++;                         \
+      const char *name_part = #FIXTURE "." #NAME;                              \
+      const size_t name_size = strlen(name_part) + 32;                         \
+      char *name = UTEST_PTR_CAST(char *, malloc(name_size));                  \
+      utest_state.tests = UTEST_PTR_CAST(                                      \
+          struct utest_test_state_s *,                                         \
+          utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),             \
+                        sizeof(struct utest_test_state_s) *                    \
+                            utest_state.tests_length));                        \
+      if (utest_state.tests) {                                                 \
+        utest_state.tests[index].func = &utest_i_##FIXTURE##_##NAME##_##INDEX; \
+        utest_state.tests[index].index = i;                                    \
+        utest_state.tests[index].name = name;                                  \
+        iUp = UTEST_CAST(utest_uint64_t, i);                                   \
+        UTEST_SNPRINTF(name, name_size, "%s/%" UTEST_PRIu64, name_part, iUp);  \
+      } else if (name) {                                                       \
+        free(name);                                                            \
+      }                                                                        \
+    }                                                                          \
+  }                                                                            \
+  void utest_run_##FIXTURE##_##NAME##_##INDEX(int *utest_result,               \
+                                              struct FIXTURE *utest_fixture)
+
+typedef void (*utest_p_namer_t)(char *, size_t, size_t);
+
+/*
+   register all the instances of a value-parameterised test at once, growing
+   the tests array by the whole count up front rather than one at a time.
+*/
+UTEST_WEAK
+void utest_p_register(const char *name_part, size_t count,
+                      utest_testcase_t func, utest_p_namer_t namer);
+UTEST_WEAK
+void utest_p_register(const char *name_part, size_t count,
+                      utest_testcase_t func, utest_p_namer_t namer) {
+  const size_t first = utest_state.tests_length;
+  const size_t name_part_length = strlen(name_part);
+  size_t i;
+
+  utest_state.tests = UTEST_PTR_CAST(
+      struct utest_test_state_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),
+                    sizeof(struct utest_test_state_s) * (first + count)));
+
+  if (UTEST_NULL == utest_state.tests) {
+    utest_state.tests_length = 0;
+    return;
+  }
+
+  for (i = 0; i < count; i++) {
+    /* sweeps can have millions of instances, so each name is sized exactly */
+    char param[256];
+    char *name;
+    size_t length;
+
+    UTEST_SNPRINTF(param, sizeof(param), "/%" UTEST_PRIu64 "(",
+                   UTEST_CAST(utest_uint64_t, i));
+    length = strlen(param);
+    namer(param + length, sizeof(param) - length - 1, i);
+    length = strlen(param);
+    name = UTEST_PTR_CAST(char *, malloc(name_part_length + length + 2));
+
+    if (UTEST_NULL == name) {
+      break;
+    }
+
+    memcpy(name, name_part, name_part_length);
+    memcpy(name + name_part_length, param, length);
+    name[name_part_length + length] = ')';
+    name[name_part_length + length + 1] = '\0';
+
+    utest_state.tests[first + i].func = func;
+    utest_state.tests[first + i].index = i;
+    utest_state.tests[first + i].name = name;
+    utest_state.tests_length++;
+  }
+}
+
+UTEST_WEAK
+void utest_p_format(char *buffer, size_t size, int is_float, int is_unsigned,
+                    double f, utest_int64_t i, utest_uint64_t u);
+UTEST_WEAK
+void utest_p_format(char *buffer, size_t size, int is_float, int is_unsigned,
+                    double f, utest_int64_t i, utest_uint64_t u) {
+  if (is_float) {
+    UTEST_SNPRINTF(buffer, size, "%g", f);
+  } else if (is_unsigned) {
+    UTEST_SNPRINTF(buffer, size, "%" UTEST_PRIu64, u);
+  } else {
+    UTEST_SNPRINTF(buffer, size, "%" UTEST_PRId64, i);
+  }
+}
+
+/*
+   parameters have to be arithmetic types, so we can work out how to print one
+   by checking whether its type can hold 1.5 (a bool would turn 0.5 into true),
+   and whether -1 wraps around.
+*/
+#define UTEST_P_IS_FLOAT(TYPE) (UTEST_CAST(TYPE, 1.5) > UTEST_CAST(TYPE, 1))
+#define UTEST_P_IS_UNSIGNED(TYPE)                                              \
+  (!UTEST_P_IS_FLOAT(TYPE) && (UTEST_CAST(TYPE, -1) > UTEST_CAST(TYPE, 0)))
+#define UTEST_P_FORMAT(BUFFER, SIZE, TYPE, VALUE)                              \
+  utest_p_format(                                                              \
+      BUFFER, SIZE, UTEST_P_IS_FLOAT(TYPE), UTEST_P_IS_UNSIGNED(TYPE),         \
+      UTEST_P_IS_FLOAT(TYPE) ? UTEST_CAST(double, VALUE) : 0.0,                \
+      (UTEST_P_IS_FLOAT(TYPE) || UTEST_P_IS_UNSIGNED(TYPE))                    \
+          ? 0                                                                  \
+          : UTEST_CAST(utest_int64_t, VALUE),                                  \
+      UTEST_P_IS_UNSIGNED(TYPE) ? UTEST_CAST(utest_uint64_t, VALUE) : 0u)
+
+/* a range whose step doesn't move its value would never end */
+UTEST_WEAK UTEST_COLD void utest_p_step_failed(const char *name);
+UTEST_WEAK UTEST_COLD void utest_p_step_failed(const char *name) {
+  fprintf(stderr,
+          "utest.h: a range of %s has a step of 0 (or one too small to move "
+          "its value)\n",
+          name);
+  abort();
+}
+
+/*
+   the number of values in the range [begin, end) when moving by step. We step
+   through the range exactly as the test instances will, so that floating
+   point ranges agree with the values the tests actually see.
+*/
+#define UTEST_P_RANGE_COUNT(NAME, TYPE, RANGE, COUNT)                          \
+  for (COUNT = 0;; COUNT++) {                                                  \
+    const TYPE utest_value =                                                   \
+        UTEST_CAST(TYPE, (RANGE)[0] + UTEST_CAST(TYPE, COUNT) * (RANGE)[2]);   \
+    const TYPE utest_next = UTEST_CAST(                                        \
+        TYPE, (RANGE)[0] + UTEST_CAST(TYPE, COUNT + 1) * (RANGE)[2]);          \
+    if (!(utest_next < utest_value) && !(utest_next > utest_value)) {          \
+      utest_p_step_failed(NAME);                                               \
+    } else if (((RANGE)[2] > UTEST_CAST(TYPE, 0))                              \
+                   ? !(utest_value < (RANGE)[1])                               \
+                   : !(utest_value > (RANGE)[1])) {                            \
+      break;                                                                   \
+    }                                                                          \
+  }
+
+#define UTEST_P_RANGES_IMPL(SET, NAME, TYPE, RANGES)                           \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static size_t                                                                \
+      utest_p_counts_##SET##_##NAME[sizeof(RANGES) / sizeof((RANGES)[0])];     \
+  static void utest_p_values_##SET##_##NAME(size_t index, TYPE *values) {      \
+    size_t d = sizeof(RANGES) / sizeof((RANGES)[0]);                           \
+    while (0 < d--) {                                                          \
+      const size_t count = utest_p_counts_##SET##_##NAME[d];                   \
+      values[d] = UTEST_CAST(                                                  \
+          TYPE, (RANGES)[d][0] +                                               \
+                    UTEST_CAST(TYPE, index % count) * (RANGES)[d][2]);         \
+      index /= count;                                                          \
+    }                                                                          \
+  }                                                                            \
+  static void utest_p_name_##SET##_##NAME(char *buffer, size_t size,           \
+                                          size_t index) {                      \
+    TYPE values[sizeof(RANGES) / sizeof((RANGES)[0])];                         \
+    size_t d;                                                                  \
+    utest_p_values_##SET##_##NAME(index, values);                              \
+    for (d = 0; d < sizeof(RANGES) / sizeof((RANGES)[0]); d++) {               \
+      const size_t written = strlen(buffer);                                   \
+      if (0 < d) {                                                             \
+        UTEST_SNPRINTF(buffer + written, size - written, ",");                 \
+      }                                                                        \
+      UTEST_P_FORMAT(buffer + strlen(buffer), size - strlen(buffer), TYPE,     \
+                     values[d]);                                               \
+    }                                                                          \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    size_t count = 1;                                                          \
+    size_t d;                                                                  \
+    for (d = 0; d < sizeof(RANGES) / sizeof((RANGES)[0]); d++) {               \
+      UTEST_P_RANGE_COUNT(#SET "." #NAME, TYPE, (RANGES)[d],                   \
+                          utest_p_counts_##SET##_##NAME[d])                    \
+      count *= utest_p_counts_##SET##_##NAME[d];                               \
+    }                                                                          \
+    utest_p_register(#SET "." #NAME, count, &utest_p_##SET##_##NAME,           \
+                     &utest_p_name_##SET##_##NAME);                            \
+  }
+
+#define UTEST_P_PARAM_FAILURE(SET, NAME)                                       \
+  if (UTEST_TEST_FAILURE == *utest_result) {                                   \
+    char param[256] = {0};                                                     \
+    utest_p_name_##SET##_##NAME(param, sizeof(param), utest_index);            \
+    UTEST_PRINTF("     Param : %s\n", param);                                  \
+  }
+
+/*
+   a value-parameterised test, with the parameter taken from each element of a
+   static array in turn.
+*/
+#define UTEST_P(SET, NAME, TYPE, ARRAY)                                        \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *utest_result, TYPE utest_param);   \
+  static void utest_p_name_##SET##_##NAME(char *buffer, size_t size,           \
+                                          size_t index) {                      \
+    UTEST_P_FORMAT(buffer, size, TYPE, (ARRAY)[index]);                        \
+  }                                                                            \
+  static void utest_p_##SET##_##NAME(int *utest_result, size_t utest_index) {  \
+    utest_run_##SET##_##NAME(utest_result, (ARRAY)[utest_index]);              \
+    UTEST_P_PARAM_FAILURE(SET, NAME)                                           \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    utest_p_register(#SET "." #NAME, sizeof(ARRAY) / sizeof((ARRAY)[0]),       \
+                     &utest_p_##SET##_##NAME, &utest_p_name_##SET##_##NAME);   \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result, TYPE utest_param)
+
+/*
+   a value-parameterised test, with the parameter taking each value in the
+   range [BEGIN, END) moving by STEP.
+*/
+#define UTEST_P_RANGE(SET, NAME, TYPE, BEGIN, END, STEP)                       \
+  static void utest_run_##SET##_##NAME(int *utest_result, TYPE utest_param);   \
+  static void utest_p_##SET##_##NAME(int *, size_t);                           \
+  static const TYPE utest_p_range_##SET##_##NAME[1][3] = {{BEGIN, END, STEP}}; \
+  UTEST_P_RANGES_IMPL(SET, NAME, TYPE, utest_p_range_##SET##_##NAME)           \
+  static void utest_p_##SET##_##NAME(int *utest_result, size_t utest_index) {  \
+    TYPE utest_param;                                                          \
+    utest_p_values_##SET##_##NAME(utest_index, &utest_param);                  \
+    utest_run_##SET##_##NAME(utest_result, utest_param);                       \
+    UTEST_P_PARAM_FAILURE(SET, NAME)                                           \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result, TYPE utest_param)
+
+/*
+   a value-parameterised test over the cartesian product of a static array of
+   {begin, end, step} ranges. The parameter is an array with one value for
+   each range.
+*/
+#define UTEST_P_PRODUCT(SET, NAME, TYPE, RANGES)                               \
+  static void utest_run_##SET##_##NAME(int *utest_result,                      \
+                                       const TYPE *utest_param);               \
+  static void utest_p_##SET##_##NAME(int *, size_t);                           \
+  UTEST_P_RANGES_IMPL(SET, NAME, TYPE, RANGES)                                 \
+  static void utest_p_##SET##_##NAME(int *utest_result, size_t utest_index) {  \
+    TYPE utest_param[sizeof(RANGES) / sizeof((RANGES)[0])];                    \
+    utest_p_values_##SET##_##NAME(utest_index, utest_param);                   \
+    utest_run_##SET##_##NAME(utest_result, utest_param);                       \
+    UTEST_P_PARAM_FAILURE(SET, NAME)                                           \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result, const TYPE *utest_param)
+
+#define UTEST_PROPERTY_GENERATE (0)
+#define UTEST_PROPERTY_REPLAY (1)
+#define UTEST_PROPERTY_REPLAY_AND_LOG (2)
+
+/*
+   the most times we'll re-run a failing property while trying to shrink its
+   input down to a minimal counterexample.
+*/
+#ifndef UTEST_PROPERTY_MAX_SHRINKS
+#define UTEST_PROPERTY_MAX_SHRINKS 1000
+#endif
+
+/*
+   property tests record every random choice their generators make. Shrinking
+   then works on that list of choices - deleting choices and making them
+   smaller - and replays the test with the result. Generators map a choice of
+   zero onto their simplest value, so smaller choices give simpler inputs.
+*/
+struct utest_property_s {
+  utest_uint64_t *choices;
+  size_t choices_length;
+  size_t choices_capacity;
+  size_t cursor;
+  char *log;
+  size_t log_length;
+  size_t log_capacity;
+  utest_uint32_t rng;
+  int mode;
+};
+
+typedef void (*utest_property_body_t)(int *, struct utest_property_s *);
+
+/* make a choice in the range [0, bound] */
+UTEST_WEAK
+utest_uint64_t utest_property_choice(struct utest_property_s *property,
+                                     utest_uint64_t bound);
+UTEST_WEAK
+utest_uint64_t utest_property_choice(struct utest_property_s *property,
+                                     utest_uint64_t bound) {
+  utest_uint64_t choice = 0;
+
+  if (UTEST_PROPERTY_GENERATE != property->mode) {
+    if (property->cursor < property->choices_length) {
+      choice = property->choices[property->cursor];
+    }
+
+    property->cursor++;
+    return (choice > bound) ? bound : choice;
+  }
+
+  choice = UTEST_CAST(utest_uint64_t, utest_random(&property->rng)) << 32;
+  choice |= utest_random(&property->rng);
+
+  if (~UTEST_CAST(utest_uint64_t, 0) != bound) {
+    choice %= bound + 1;
+  }
+
+  if (property->choices_length == property->choices_capacity) {
+    property->choices_capacity = 2 * property->choices_capacity + 16;
+    property->choices = UTEST_PTR_CAST(
+        utest_uint64_t *,
+        utest_realloc(UTEST_PTR_CAST(void *, property->choices),
+                      sizeof(utest_uint64_t) * property->choices_capacity));
+
+    if (UTEST_NULL == property->choices) {
+      property->choices_capacity = 0;
+      property->choices_length = 0;
+      return 0;
+    }
+  }
+
+  property->choices[property->choices_length++] = choice;
+  property->cursor++;
+  return choice;
+}
+
+/* record the generated inputs, but only when replaying the final failure */
+UTEST_WEAK
+void utest_property_log(struct utest_property_s *property, const char *text,
+                        size_t length);
+UTEST_WEAK
+void utest_property_log(struct utest_property_s *property, const char *text,
+                        size_t length) {
+  if (UTEST_PROPERTY_REPLAY_AND_LOG != property->mode) {
+    return;
+  }
+
+  if (property->log_length + length + 1 > property->log_capacity) {
+    property->log_capacity = 2 * (property->log_length + length + 1);
+    property->log = UTEST_PTR_CAST(
+        char *, utest_realloc(property->log, property->log_capacity));
+
+    if (UTEST_NULL == property->log) {
+      property->log_capacity = 0;
+      property->log_length = 0;
+      return;
+    }
+  }
+
+  memcpy(property->log + property->log_length, text, length);
+  property->log_length += length;
+  property->log[property->log_length] = '\0';
+}
+
+/*
+   generate an integer in [min, max]. Choices are mapped onto the range in
+   order of distance from the value closest to zero, so that shrinking the
+   choice shrinks the integer towards zero.
+*/
+UTEST_WEAK
+utest_int64_t utest_property_int(struct utest_property_s *property,
+                                 utest_int64_t min, utest_int64_t max);
+UTEST_WEAK
+utest_int64_t utest_property_int(struct utest_property_s *property,
+                                 utest_int64_t min, utest_int64_t max) {
+  const utest_int64_t target = (0 < min) ? min : ((0 > max) ? max : 0);
+  const utest_uint64_t up = UTEST_CAST(utest_uint64_t, max) -
+                            UTEST_CAST(utest_uint64_t, target);
+  const utest_uint64_t down = UTEST_CAST(utest_uint64_t, target) -
+                              UTEST_CAST(utest_uint64_t, min);
+  const utest_uint64_t nearest = (up < down) ? up : down;
+  utest_uint64_t choice;
+  utest_int64_t value;
+  char text[64];
+
+  if (max < min) {
+    return min;
+  }
+
+  choice = utest_property_choice(property, up + down);
+
+  if (choice <= 2 * nearest) {
+    /* alternate either side of the target while both sides have values */
+    value = UTEST_CAST(utest_int64_t,
+                       UTEST_CAST(utest_uint64_t, target) +
+                           ((choice & 1) ? (choice + 1) / 2 : 0u - choice / 2));
+  } else if (up > down) {
+    value = UTEST_CAST(utest_int64_t, UTEST_CAST(utest_uint64_t, target) +
+                                          (choice - nearest));
+  } else {
+    value = UTEST_CAST(utest_int64_t, UTEST_CAST(utest_uint64_t, target) -
+                                          (choice - nearest));
+  }
+
+  UTEST_SNPRINTF(text, sizeof(text), "int %" UTEST_PRId64 "\n", value);
+  utest_property_log(property, text, strlen(text));
+  return value;
+}
+
+/*
+   generate a double in [min, max], shrinking towards the value in the range
+   closest to zero.
+*/
+UTEST_WEAK
+double utest_property_double(struct utest_property_s *property, double min,
+                             double max);
+UTEST_WEAK
+double utest_property_double(struct utest_property_s *property, double min,
+                             double max) {
+  const double target = (0 < min) ? min : ((0 > max) ? max : 0);
+  const utest_uint64_t upwards = utest_property_choice(property, 1);
+  const utest_uint64_t magnitude =
+      utest_property_choice(property,
+                            (UTEST_CAST(utest_uint64_t, 1) << 53) - 1);
+  const double fraction = UTEST_CAST(double, magnitude) / 9007199254740992.0;
+  double value;
+  char text[64];
+
+  if (upwards) {
+    value = target + fraction * (max - target);
+  } else {
+    value = target - fraction * (target - min);
+  }
+
+  UTEST_SNPRINTF(text, sizeof(text), "double %.17g\n", value);
+  utest_property_log(property, text, strlen(text));
+  return value;
+}
+
+/*
+   fill buffer with up to capacity random bytes, returning how many were
+   generated. Shrinks towards fewer, zero valued, bytes.
+*/
+UTEST_WEAK
+size_t utest_property_bytes(struct utest_property_s *property, void *buffer,
+                            size_t capacity);
+UTEST_WEAK
+size_t utest_property_bytes(struct utest_property_s *property, void *buffer,
+                            size_t capacity) {
+  unsigned char *const bytes = UTEST_PTR_CAST(unsigned char *, buffer);
+  const size_t length = UTEST_CAST(
+      size_t, utest_property_choice(property,
+                                    UTEST_CAST(utest_uint64_t, capacity)));
+  size_t i;
+  char text[8];
+
+  for (i = 0; i < length; i++) {
+    bytes[i] = UTEST_CAST(unsigned char, utest_property_choice(property, 255));
+  }
+
+  if (UTEST_PROPERTY_REPLAY_AND_LOG == property->mode) {
+    UTEST_SNPRINTF(text, sizeof(text), "bytes");
+    utest_property_log(property, text, strlen(text));
+
+    for (i = 0; i < length; i++) {
+      UTEST_SNPRINTF(text, sizeof(text), " %02x",
+                     UTEST_CAST(unsigned, bytes[i]));
+      utest_property_log(property, text, strlen(text));
+    }
+
+    utest_property_log(property, "\n", 1);
+  }
+
+  return length;
+}
+
+/*
+   fill buffer with a null terminated string of printable ASCII characters,
+   of at most capacity - 1 characters, returning its length. Shrinks towards
+   shorter strings of 'a's.
+*/
+UTEST_WEAK
+size_t utest_property_string(struct utest_property_s *property, char *buffer,
+                             size_t capacity);
+UTEST_WEAK
+size_t utest_property_string(struct utest_property_s *property, char *buffer,
+                             size_t capacity) {
+  size_t length = 0;
+  size_t i;
+
+  if (0 == capacity) {
+    return 0;
+  }
+
+  length = UTEST_CAST(
+      size_t, utest_property_choice(property,
+                                    UTEST_CAST(utest_uint64_t, capacity - 1)));
+
+  for (i = 0; i < length; i++) {
+    /* map a choice of 0 to 'a', wrapping around the printable range */
+    const utest_uint64_t choice = utest_property_choice(property, 94);
+    buffer[i] = UTEST_CAST(char, ' ' + (choice + ('a' - ' ')) % 95);
+  }
+
+  buffer[length] = '\0';
+
+  if (UTEST_PROPERTY_REPLAY_AND_LOG == property->mode) {
+    utest_property_log(property, "string \"", 8);
+
+    for (i = 0; i < length; i++) {
+      if (('"' == buffer[i]) || ('\\' == buffer[i])) {
+        utest_property_log(property, "\\", 1);
+      }
+
+      utest_property_log(property, buffer + i, 1);
+    }
+
+    utest_property_log(property, "\"\n", 2);
+  }
+
+  return length;
+}
+
+/*
+   replay the body against the given choices, returning non-zero if it failed.
+   The choices are trimmed to those that the body actually consumed.
+*/
+UTEST_WEAK
+int utest_property_replay(struct utest_property_s *property,
+                          utest_property_body_t body, utest_uint64_t *choices,
+                          size_t length);
+UTEST_WEAK
+int utest_property_replay(struct utest_property_s *property,
+                          utest_property_body_t body, utest_uint64_t *choices,
+                          size_t length) {
+  int result = UTEST_TEST_PASSED;
+  utest_uint64_t *const original = property->choices;
+  const size_t original_length = property->choices_length;
+
+  property->mode = UTEST_PROPERTY_REPLAY;
+  property->choices = choices;
+  property->choices_length = length;
+  property->cursor = 0;
+  body(&result, property);
+  property->choices = original;
+  property->choices_length = original_length;
+
+  if (UTEST_TEST_FAILURE != result) {
+    return 0;
+  }
+
+  /* the candidate failed too, so it becomes our new smallest input */
+  if (property->cursor < length) {
+    length = property->cursor;
+  }
+
+  memmove(property->choices, choices, sizeof(utest_uint64_t) * length);
+  property->choices_length = length;
+  return 1;
+}
+
+/*
+   shrink the choices of a failing run, by deleting runs of choices and then
+   by making each choice as small as we can, until neither helps any more.
+*/
+UTEST_WEAK
+void utest_property_shrink(struct utest_property_s *property,
+                           utest_property_body_t body);
+UTEST_WEAK
+void utest_property_shrink(struct utest_property_s *property,
+                           utest_property_body_t body) {
+  utest_uint64_t *candidate = UTEST_NULL;
+  size_t attempts = 0;
+  int improved = 1;
+
+  while (improved && (attempts < UTEST_PROPERTY_MAX_SHRINKS)) {
+    size_t chunk;
+    size_t i;
+
+    improved = 0;
+    free(candidate);
+    candidate = UTEST_PTR_CAST(
+        utest_uint64_t *,
+        malloc(sizeof(utest_uint64_t) * (property->choices_length + 1)));
+
+    if (UTEST_NULL == candidate) {
+      return;
+    }
+
+    for (chunk = 8; 0 < chunk; chunk /= 2) {
+      for (i = 0; (i + chunk <= property->choices_length) &&
+                  (attempts < UTEST_PROPERTY_MAX_SHRINKS);
+           attempts++) {
+        const size_t length = property->choices_length - chunk;
+        memcpy(candidate, property->choices, sizeof(utest_uint64_t) * i);
+        memcpy(candidate + i, property->choices + i + chunk,
+               sizeof(utest_uint64_t) * (length - i));
+
+        if (utest_property_replay(property, body, candidate, length)) {
+          improved = 1;
+        } else {
+          i++;
+        }
+      }
+    }
+
+    for (i = 0; (i < property->choices_length) &&
+                (attempts < UTEST_PROPERTY_MAX_SHRINKS);
+         i++) {
+      utest_uint64_t lo = 0;
+      utest_uint64_t hi = property->choices[i];
+
+      /* binary search for the smallest value of this choice that fails */
+      while ((lo < hi) && (i < property->choices_length) &&
+             (attempts < UTEST_PROPERTY_MAX_SHRINKS)) {
+        const utest_uint64_t mid = lo + (hi - lo) / 2;
+        const size_t length = property->choices_length;
+        memcpy(candidate, property->choices, sizeof(utest_uint64_t) * length);
+        candidate[i] = mid;
+        attempts++;
+
+        if (utest_property_replay(property, body, candidate, length)) {
+          improved = 1;
+          hi = mid;
+        } else {
+          lo = mid + 1;
+        }
+      }
+    }
+  }
+
+  free(candidate);
+}
+
+UTEST_WEAK
+void utest_property_check(const char *name, size_t runs,
+                          utest_property_body_t body, int *utest_result);
+UTEST_WEAK
+void utest_property_check(const char *name, size_t runs,
+                          utest_property_body_t body, int *utest_result) {
+  struct utest_property_s property;
+  const utest_int64_t start = utest_ns();
+  utest_uint64_t seed = 2166136261u;
+  size_t run;
+
+  memset(&property, 0, sizeof(property));
+
+  if (utest_state.property_seeded) {
+    seed = utest_state.property_seed;
+  } else {
+    /* by default each property gets a fixed seed (an FNV-1a of its name) */
+    const char *c;
+    for (c = name; '\0' != *c; c++) {
+      seed = ((seed ^ UTEST_CAST(unsigned char, *c)) * 16777619u) & 0xffffffffu;
+    }
+  }
+
+  if (0 != utest_state.property_runs) {
+    runs = utest_state.property_runs;
+  }
+
+  for (run = 0; run < runs; run++) {
+    const utest_uint64_t run_seed =
+        (seed + UTEST_CAST(utest_uint64_t, run) * 2654435769u) & 0xffffffffu;
+    int result = UTEST_TEST_PASSED;
+
+    if ((0 != utest_state.property_time_ns) &&
+        (utest_ns() - start > utest_state.property_time_ns)) {
+      break;
+    }
+
+    property.mode = UTEST_PROPERTY_GENERATE;
+    property.rng = UTEST_CAST(utest_uint32_t, run_seed);
+    property.choices_length = 0;
+    property.cursor = 0;
+
+    utest_state.quiet++;
+    body(&result, &property);
+
+    if (UTEST_TEST_FAILURE == result) {
+      utest_property_shrink(&property, body);
+    }
+
+    utest_state.quiet--;
+
+    if (UTEST_TEST_FAILURE == result) {
+      /* replay the smallest failing input one last time, this time loudly */
+      property.mode = UTEST_PROPERTY_REPLAY_AND_LOG;
+      property.cursor = 0;
+      body(utest_result, &property);
+      *utest_result = UTEST_TEST_FAILURE;
+
+      UTEST_PRINTF("  Property : failed after %" UTEST_PRIu64
+                   " runs (replay with --property-seed=%" UTEST_PRIu64 ")\n",
+                   UTEST_CAST(utest_uint64_t, run + 1), run_seed);
+
+      if (UTEST_NULL != property.log) {
+        char *line = property.log;
+        char *end;
+
+        while (UTEST_NULL != (end = strchr(line, '\n'))) {
+          *end = '\0';
+          UTEST_PRINTF("     Input : %s\n", line);
+          line = end + 1;
+        }
+      }
+
+      break;
+    }
+  }
+
+  free(property.choices);
+  free(property.log);
+}
+
+/*
+   define a property test, whose body is run RUNS times against inputs from
+   the UTEST_GEN_* generators. Failing inputs are shrunk to a minimal
+   counterexample, which is printed along with the seed to replay it.
+*/
+#if defined(UTEST_HAS_EXCEPTIONS)
+#define UTEST_PROPERTY_CALL(SET, NAME)                                         \
+  try {                                                                        \
+    utest_run_##SET##_##NAME(utest_result, utest_property);                    \
+  } catch (const std::exception &err) {                                        \
+    UTEST_PRINTF(" Exception : %s\n", err.what());                             \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  } catch (...) {                                                              \
+    UTEST_PRINTF(" Exception : Unknown\n");                                    \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  }
+#else
+#define UTEST_PROPERTY_CALL(SET, NAME)                                         \
+  utest_run_##SET##_##NAME(utest_result, utest_property);
+#endif
+
+#define UTEST_PROPERTY(SET, NAME, RUNS)                                        \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *, struct utest_property_s *);      \
+  static void utest_property_##SET##_##NAME(                                   \
+      int *utest_result, struct utest_property_s *utest_property) {            \
+    UTEST_SURPRESS_WARNING_BEGIN                                               \
+    UTEST_PROPERTY_CALL(SET, NAME)                                             \
+    UTEST_SURPRESS_WARNING_END                                                 \
+  }                                                                            \
+  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
+    (void)utest_index;                                                         \
+    utest_property_check(#SET "." #NAME, RUNS,                                 \
+                         &utest_property_##SET##_##NAME, utest_result);        \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    const size_t index = utest_state.tests_length++;                           \
+    const char *name_part = #SET "." #NAME;                                    \
+    const size_t name_size = strlen(name_part) + 1;                            \
+    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
+    utest_state.tests = UTEST_PTR_CAST(                                        \
+        struct utest_test_state_s *,                                           \
+        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
+                      sizeof(struct utest_test_state_s) *                      \
+                          utest_state.tests_length));                          \
+    if (utest_state.tests) {                                                   \
+      utest_state.tests[index].func = &utest_##SET##_##NAME;                   \
+      utest_state.tests[index].name = name;                                    \
+      utest_state.tests[index].index = 0;                                      \
+      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
+    } else if (name) {                                                         \
+      free(name);                                                              \
+    }                                                                          \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result,                             \
+                                struct utest_property_s *utest_property)
+
+#define UTEST_GEN_INT(min, max)                                                \
+  utest_property_int(utest_property, UTEST_CAST(utest_int64_t, min),           \
+                     UTEST_CAST(utest_int64_t, max))
+#define UTEST_GEN_DOUBLE(min, max)                                             \
+  utest_property_double(utest_property, UTEST_CAST(double, min),               \
+                        UTEST_CAST(double, max))
+#define UTEST_GEN_FLOAT(min, max) UTEST_CAST(float, UTEST_GEN_DOUBLE(min, max))
+#define UTEST_GEN_BYTES(buffer, capacity)                                      \
+  utest_property_bytes(utest_property, buffer, capacity)
+#define UTEST_GEN_STRING(buffer, capacity)                                     \
+  utest_property_string(utest_property, buffer, capacity)
+
+/*
+   a fuzz target is registered twice: as an ordinary test, that runs the body
+   over its seed corpus, and as a target that UTEST_MAIN dispatches to from
+   LLVMFuzzerTestOneInput when the tests are built for fuzzing.
+*/
+UTEST_WEAK
+void utest_fuzz_register(const char *name_part, utest_testcase_t func,
+                         utest_fuzz_body_t body);
+UTEST_WEAK
+void utest_fuzz_register(const char *name_part, utest_testcase_t func,
+                         utest_fuzz_body_t body) {
+  const size_t index = utest_state.tests_length++;
+  const size_t target = utest_state.fuzz_targets_length++;
+  const size_t name_size = strlen(name_part) + 1;
+  char *name = UTEST_PTR_CAST(char *, malloc(name_size));
+
+  utest_state.tests = UTEST_PTR_CAST(
+      struct utest_test_state_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),
+                    sizeof(struct utest_test_state_s) *
+                        utest_state.tests_length));
+  utest_state.fuzz_targets = UTEST_PTR_CAST(
+      struct utest_fuzz_target_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.fuzz_targets),
+                    sizeof(struct utest_fuzz_target_s) *
+                        utest_state.fuzz_targets_length));
+
+  if (utest_state.tests && utest_state.fuzz_targets && name) {
+    UTEST_SNPRINTF(name, name_size, "%s", name_part);
+    utest_state.tests[index].func = func;
+    utest_state.tests[index].name = name;
+    utest_state.tests[index].index = 0;
+    utest_state.fuzz_targets[target].name = name;
+    utest_state.fuzz_targets[target].body = body;
+  } else if (name) {
+    free(name);
+  }
+}
+
+#if defined(UTEST_HAS_EXCEPTIONS)
+#define UTEST_FUZZ_CALL(SET, NAME)                                             \
+  try {                                                                        \
+    utest_run_##SET##_##NAME(utest_result, utest_data, utest_size);            \
+  } catch (const std::exception &err) {                                        \
+    UTEST_PRINTF(" Exception : %s\n", err.what());                             \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  } catch (...) {                                                              \
+    UTEST_PRINTF(" Exception : Unknown\n");                                    \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  }
+#else
+#define UTEST_FUZZ_CALL(SET, NAME)                                             \
+  utest_run_##SET##_##NAME(utest_result, utest_data, utest_size);
+#endif
+
+#define UTEST_FUZZ(SET, NAME, DATA, SIZE)                                      \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *, const unsigned char *, size_t);  \
+  static void utest_fuzz_##SET##_##NAME(                                       \
+      int *utest_result, const unsigned char *utest_data, size_t utest_size) { \
+    UTEST_SURPRESS_WARNING_BEGIN                                               \
+    UTEST_FUZZ_CALL(SET, NAME)                                                 \
+    UTEST_SURPRESS_WARNING_END                                                 \
+  }                                                                            \
+  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
+    (void)utest_index;                                                         \
+    utest_fuzz_corpus(#SET "." #NAME, &utest_fuzz_##SET##_##NAME,              \
+                      utest_result);                                           \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    utest_fuzz_register(#SET "." #NAME, &utest_##SET##_##NAME,                 \
+                        &utest_fuzz_##SET##_##NAME);                           \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result, const unsigned char *DATA,  \
+                                size_t SIZE)
+
+typedef void (*utest_data_body_t)(int *, const char *, const unsigned char *,
+                                  size_t);
+
+#if defined(UTEST_HAS_EXCEPTIONS)
+#define UTEST_DATA_CALL(SET, NAME)                                             \
+  try {                                                                        \
+    utest_run_##SET##_##NAME(utest_result, utest_path, utest_data,             \
+                             utest_size);                                      \
+  } catch (const std::exception &err) {                                        \
+    UTEST_PRINTF(" Exception : %s\n", err.what());                             \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  } catch (...) {                                                              \
+    UTEST_PRINTF(" Exception : Unknown\n");                                    \
+    *utest_result = UTEST_TEST_FAILURE;                                        \
+  }
+#else
+#define UTEST_DATA_CALL(SET, NAME)                                             \
+  utest_run_##SET##_##NAME(utest_result, utest_path, utest_data, utest_size);
+#endif
+
+#define UTEST_DATA(SET, NAME, GLOB)                                            \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *, const char *,                    \
+                                       const unsigned char *, size_t);         \
+  static void utest_data_##SET##_##NAME(int *utest_result,                     \
+                                        const char *utest_path,                \
+                                        const unsigned char *utest_data,       \
+                                        size_t utest_size) {                   \
+    UTEST_SURPRESS_WARNING_BEGIN                                               \
+    UTEST_DATA_CALL(SET, NAME)                                                 \
+    UTEST_SURPRESS_WARNING_END                                                 \
+  }                                                                            \
+  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
+    utest_data_run(utest_state.data_paths[utest_index],                        \
+                   &utest_data_##SET##_##NAME, utest_result);                  \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    utest_data_register(#SET "." #NAME, GLOB, &utest_##SET##_##NAME);          \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result, const char *utest_path,     \
+                                const unsigned char *utest_data,               \
+                                size_t utest_size)
+
+/*
+   stress tests run their workers on threads of their own: Windows threads,
+   which need nothing more, or pthreads - which some C libraries need -pthread
+   to link, so are only used when UTEST_USE_THREADS is defined.
+*/
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+#define UTEST_HAS_THREADS
+#include <process.h>
+#elif defined(UTEST_HAS_FORK)
+#if defined(UTEST_USE_THREADS)
+#define UTEST_HAS_THREADS
+#include <pthread.h>
+#endif
+#include <sched.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+/*
+   a stress test runs its body on several threads at once, each thread running
+   it a number of times. The threads all start up and then wait on a spin
+   barrier, so that they are released together.
+*/
+typedef void (*utest_stress_body_t)(int *);
+
+/* latencies are histogrammed into 8 buckets per power of two nanoseconds */
+#define UTEST_STRESS_BUCKETS 512
+
+struct utest_stress_s {
+  utest_stress_body_t body;
+  int *result;
+  size_t iterations;
+  int ready;
+  int go;
+};
+
+struct utest_stress_worker_s {
+  struct utest_stress_s *stress;
+  size_t thread;
+  size_t iterations;
+  utest_uint64_t max_ns;
+  size_t latencies[UTEST_STRESS_BUCKETS];
+};
+
+static UTEST_INLINE size_t utest_stress_bucket(const utest_uint64_t ns) {
+  size_t msb = 0;
+
+  if (8 > ns) {
+    return UTEST_CAST(size_t, ns);
+  }
+
+  while (ns >> (msb + 1)) {
+    msb++;
+  }
+
+  return (msb - 2) * 8 + UTEST_CAST(size_t, (ns >> (msb - 3)) & 7);
+}
+
+/* the largest latency that falls into the bucket */
+static UTEST_INLINE utest_uint64_t utest_stress_bucket_ns(const size_t bucket) {
+  if (8 > bucket) {
+    return bucket;
+  }
+
+  return (UTEST_CAST(utest_uint64_t, 9 + (bucket % 8)) << ((bucket / 8) - 1)) -
+         1;
+}
+
+static UTEST_INLINE void utest_stress_yield(void) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+  SwitchToThread();
+#elif defined(UTEST_HAS_THREADS)
+  sched_yield();
+#endif
+}
+
+/* pin the calling thread to a CPU, returning zero if it was */
+UTEST_WEAK int utest_pin_cpu(const size_t cpu);
+UTEST_WEAK int utest_pin_cpu(const size_t cpu) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+  if (cpu >= sizeof(utest_affinity_mask) * 8) {
+    return 1;
+  }
+
+  return 0 == SetThreadAffinityMask(GetCurrentThread(),
+                                    UTEST_CAST(utest_affinity_mask, 1) << cpu);
+#elif defined(__linux__) && defined(CPU_SET)
+  cpu_set_t set;
+
+  if (cpu >= CPU_SETSIZE) {
+    return 1;
+  }
+
+  CPU_ZERO(&set);
+  CPU_SET(UTEST_CAST(int, cpu), &set);
+  return 0 != sched_setaffinity(0, sizeof(set), &set);
+#elif defined(__linux__) && defined(SYS_sched_setaffinity) &&                  \
+    !defined(__STRICT_ANSI__)
+  /* without _GNU_SOURCE there is no CPU_SET, so build the mask ourselves */
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+  const size_t bits = 8 * sizeof(unsigned long);
+
+  if (cpu >= sizeof(mask) * 8) {
+    return 1;
+  }
+
+  memset(mask, 0, sizeof(mask));
+  mask[cpu / bits] = 1ul << (cpu % bits);
+  return 0 != syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+#else
+  (void)cpu;
+  return 1;
+#endif
+}
+
+/* the number of CPUs that are online */
+static UTEST_INLINE size_t utest_cpu_count(void) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+  return GetActiveProcessorCount(0xffff);
+#elif defined(UTEST_HAS_FORK) && defined(_SC_NPROCESSORS_ONLN)
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return 0 < cpus ? UTEST_CAST(size_t, cpus) : 1;
+#else
+  return 1;
+#endif
+}
+
+/*
+   pin a stress thread to a CPU, picked round robin by the worker's index
+   (starting from the CPU that --pin-cpu pinned the tests to).
+*/
+UTEST_WEAK void utest_stress_pin(const size_t thread);
+UTEST_WEAK void utest_stress_pin(const size_t thread) {
+  const size_t first =
+      0 <= utest_state.pin_cpu ? UTEST_CAST(size_t, utest_state.pin_cpu) : 0;
+
+  if (0 != utest_pin_cpu((first + thread) % utest_cpu_count())) {
+    UTEST_PRINTF("   Warning : could not pin thread %" UTEST_PRIu64 "\n",
+                 UTEST_CAST(utest_uint64_t, thread));
+  }
+}
+
+/*
+   the body of one stress thread: wait at the barrier, then run the body,
+   timing each run. A thread stops early once the test has failed.
+*/
+UTEST_WEAK void utest_stress_work(struct utest_stress_worker_s *const worker);
+UTEST_WEAK void utest_stress_work(struct utest_stress_worker_s *const worker) {
+  struct utest_stress_s *const stress = worker->stress;
+  struct utest_thread_s *const context = utest_thread_context();
+  utest_int64_t then;
+  size_t iteration;
+
+  context->stress_thread = worker->thread;
+
+  /* threads would otherwise inherit the one CPU --pin-cpu pinned them to */
+  if (utest_state.pin_threads || (0 <= utest_state.pin_cpu)) {
+    utest_stress_pin(worker->thread);
+  }
+
+  utest_atomic_increment(&stress->ready);
+
+  while (0 == utest_atomic_load(&stress->go)) {
+    utest_stress_yield();
+  }
+
+  then = utest_ns();
+
+  for (iteration = 0; iteration < stress->iterations; iteration++) {
+    utest_int64_t now;
+    utest_uint64_t ns;
+
+    if (UTEST_TEST_FAILURE == utest_atomic_load(stress->result)) {
+      break;
+    }
+
+    context->stress_iteration = iteration;
+    stress->body(stress->result);
+
+    now = utest_ns();
+    ns = UTEST_CAST(utest_uint64_t, now - then);
+    then = now;
+
+    worker->latencies[utest_stress_bucket(ns)]++;
+
+    if (ns > worker->max_ns) {
+      worker->max_ns = ns;
+    }
+  }
+
+  worker->iterations = iteration;
+}
+
+/* the smallest latency that at least per_mille of the iterations are within */
+static UTEST_INLINE utest_uint64_t utest_stress_percentile(
+    const struct utest_stress_worker_s *const worker, const size_t per_mille) {
+  const size_t wanted = (worker->iterations * per_mille + 999) / 1000;
+  size_t seen = 0;
+  size_t bucket;
+
+  for (bucket = 0; bucket < UTEST_STRESS_BUCKETS; bucket++) {
+    seen += worker->latencies[bucket];
+
+    if (seen >= wanted) {
+      break;
+    }
+  }
+
+  /* the bucket's bound can be more than the largest latency that was in it */
+  return utest_stress_bucket_ns(bucket) < worker->max_ns
+             ? utest_stress_bucket_ns(bucket)
+             : worker->max_ns;
+}
+
+/* report one run of a stress test, and return its throughput in ops/s */
+UTEST_WEAK double
+utest_stress_report(const struct utest_stress_worker_s *const workers,
+                    const size_t threads, const utest_int64_t ns);
+UTEST_WEAK double
+utest_stress_report(const struct utest_stress_worker_s *const workers,
+                    const size_t threads, const utest_int64_t ns) {
+  utest_uint64_t iterations = 0;
+  double throughput = 0.0;
+  char name[64];
+  char value[32];
+  size_t thread;
+
+  for (thread = 0; thread < threads; thread++) {
+    iterations += workers[thread].iterations;
+  }
+
+  if (0 < ns) {
+    throughput = UTEST_CAST(double, iterations) * 1e9 / UTEST_CAST(double, ns);
+  }
+
+  UTEST_PRINTF("    Stress : %" UTEST_PRIu64 " threads, %" UTEST_PRIu64
+               " iterations in %" UTEST_PRId64 "ns (%.0f ops/s)\n",
+               UTEST_CAST(utest_uint64_t, threads), iterations, ns,
+               throughput);
+
+  UTEST_SNPRINTF(name, sizeof(name), "stress.%" UTEST_PRIu64 ".ops_per_second",
+                 UTEST_CAST(utest_uint64_t, threads));
+  UTEST_SNPRINTF(value, sizeof(value), "%.0f", throughput);
+  utest_record_property(name, value);
+
+  for (thread = 0; thread < threads; thread++) {
+    const struct utest_stress_worker_s *const worker = workers + thread;
+    char label[32];
+
+    if (0 == worker->iterations) {
+      continue;
+    }
+
+    UTEST_SNPRINTF(label, sizeof(label), "Thread %" UTEST_PRIu64,
+                   UTEST_CAST(utest_uint64_t, thread));
+    UTEST_PRINTF("%10s : p50 %" UTEST_PRIu64 "ns, p99 %" UTEST_PRIu64
+                 "ns, max %" UTEST_PRIu64 "ns\n",
+                 label, utest_stress_percentile(worker, 500),
+                 utest_stress_percentile(worker, 990), worker->max_ns);
+  }
+
+  return throughput;
+}
+
+/*
+   report how the throughput of a stress test scaled with the number of
+   threads, relative to its throughput on the first (fewest) threads.
+*/
+UTEST_WEAK void utest_stress_scaling_report(const size_t *const threads,
+                                            const double *const throughputs,
+                                            const size_t length);
+UTEST_WEAK void utest_stress_scaling_report(const size_t *const threads,
+                                            const double *const throughputs,
+                                            const size_t length) {
+  size_t index;
+
+  if (0 == length) {
+    return;
+  }
+
+  UTEST_PRINTF("   Scaling : threads         ops/s   speedup  efficiency\n");
+
+  for (index = 0; index < length; index++) {
+    double speedup = 0.0;
+    double efficiency;
+    char name[64];
+    char value[32];
+
+    if (0.0 < throughputs[0]) {
+      speedup = throughputs[index] / throughputs[0];
+    }
+
+    efficiency = speedup * UTEST_CAST(double, threads[0]) /
+                 UTEST_CAST(double, threads[index]);
+
+    UTEST_PRINTF("             %7" UTEST_PRIu64 " %13.0f %8.2fx %10.1f%%\n",
+                 UTEST_CAST(utest_uint64_t, threads[index]),
+                 throughputs[index], speedup, efficiency * 100.0);
+
+    UTEST_SNPRINTF(name, sizeof(name), "stress.%" UTEST_PRIu64 ".speedup",
+                   UTEST_CAST(utest_uint64_t, threads[index]));
+    UTEST_SNPRINTF(value, sizeof(value), "%.3f", speedup);
+    utest_record_property(name, value);
+    UTEST_SNPRINTF(name, sizeof(name), "stress.%" UTEST_PRIu64 ".efficiency",
+                   UTEST_CAST(utest_uint64_t, threads[index]));
+    UTEST_SNPRINTF(value, sizeof(value), "%.3f", efficiency);
+    utest_record_property(name, value);
+  }
+}
+
+/*
+   the thread entry points, and the function that starts the threads, are
+   static so that only a file with a UTEST_STRESS in it needs the thread library
+   to link.
+*/
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+typedef void *utest_thread_handle;
+
+static UTEST_INLINE unsigned __stdcall utest_stress_entry(void *const worker) {
+  utest_stress_work(UTEST_PTR_CAST(struct utest_stress_worker_s *, worker));
+  utest_thread_detach();
+  return 0;
+}
+#elif defined(UTEST_HAS_THREADS)
+typedef pthread_t utest_thread_handle;
+
+static UTEST_INLINE void *utest_stress_entry(void *const worker) {
+  utest_stress_work(UTEST_PTR_CAST(struct utest_stress_worker_s *, worker));
+  utest_thread_detach();
+  return UTEST_NULL;
+}
+#endif
+
+/* run a stress test on the given threads once, and return its throughput */
+static UTEST_INLINE double utest_stress_once(const utest_stress_body_t body,
+                                             const size_t threads,
+                                             const size_t iterations,
+                                             int *const result,
+                                             const int report) {
+  struct utest_stress_s stress;
+  struct utest_stress_worker_s *workers;
+  utest_int64_t ns;
+  size_t started;
+  size_t thread;
+  double throughput = 0.0;
+#if defined(UTEST_HAS_THREADS)
+  utest_thread_handle *handles;
+#endif
+
+  stress.body = body;
+  stress.result = result;
+  stress.iterations = iterations;
+  stress.ready = 0;
+  stress.go = 0;
+
+  workers = UTEST_PTR_CAST(
+      struct utest_stress_worker_s *,
+      calloc(threads, sizeof(struct utest_stress_worker_s)));
+#if defined(UTEST_HAS_THREADS)
+  handles = UTEST_PTR_CAST(utest_thread_handle *,
+                           calloc(threads, sizeof(utest_thread_handle)));
+#endif
+
+  if (UTEST_NULL == workers
+#if defined(UTEST_HAS_THREADS)
+      || UTEST_NULL == handles
+#endif
+  ) {
+    UTEST_PRINTF("    Stress : out of memory for %" UTEST_PRIu64 " threads\n",
+                 UTEST_CAST(utest_uint64_t, threads));
+    utest_set_result(result, UTEST_TEST_FAILURE);
+    free(workers);
+#if defined(UTEST_HAS_THREADS)
+    free(handles);
+#endif
+    return throughput;
+  }
+
+  for (thread = 0; thread < threads; thread++) {
+    workers[thread].stress = &stress;
+    workers[thread].thread = thread;
+  }
+
+#if defined(UTEST_HAS_THREADS)
+  for (started = 0; started < threads; started++) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+    handles[started] = UTEST_PTR_CAST(
+        void *, _beginthreadex(UTEST_NULL, 0, utest_stress_entry,
+                               workers + started, 0, UTEST_NULL));
+
+    if (UTEST_NULL == handles[started]) {
+      break;
+    }
+#else
+    if (0 != pthread_create(handles + started, UTEST_NULL, utest_stress_entry,
+                            workers + started)) {
+      break;
+    }
+#endif
+  }
+
+  if (started < threads) {
+    /* the threads that did start see the failure and stop straight away */
+    UTEST_PRINTF("    Stress : could only start %" UTEST_PRIu64
+                 " of %" UTEST_PRIu64 " threads\n",
+                 UTEST_CAST(utest_uint64_t, started),
+                 UTEST_CAST(utest_uint64_t, threads));
+    utest_set_result(result, UTEST_TEST_FAILURE);
+  }
+
+  while (utest_atomic_load(&stress.ready) < UTEST_CAST(int, started)) {
+    utest_stress_yield();
+  }
+
+  ns = utest_ns();
+  utest_atomic_increment(&stress.go);
+
+  for (thread = 0; thread < started; thread++) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+    WaitForSingleObject(handles[thread], 0xffffffff);
+    CloseHandle(handles[thread]);
+#else
+    pthread_join(handles[thread], UTEST_NULL);
+#endif
+  }
+
+  ns = utest_ns() - ns;
+  free(handles);
+#else
+  /* without threads, the workers can only be run one after another */
+  if (report && (1 < threads)) {
+    UTEST_PRINTF("    Stress : no threads (see UTEST_USE_THREADS), so the "
+                 "%" UTEST_PRIu64 " workers ran one after another\n",
+                 UTEST_CAST(utest_uint64_t, threads));
+  }
+
+  started = threads;
+  stress.go = 1;
+  ns = utest_ns();
+
+  for (thread = 0; thread < threads; thread++) {
+    utest_stress_work(workers + thread);
+  }
+
+  ns = utest_ns() - ns;
+#endif
+
+  if ((started == threads) && report) {
+    throughput = utest_stress_report(workers, threads, ns);
+  }
+
+  free(workers);
+  return throughput;
+}
+
+/*
+   run a stress test on its threads, or with --scaling, once on each of the
+   thread counts given (stopping early if it fails).
+*/
+static UTEST_INLINE void utest_stress_run(const utest_stress_body_t body,
+                                          size_t threads,
+                                          const size_t iterations,
+                                          int *const result) {
+  double *throughputs;
+  size_t index;
+
+  if (0 == utest_state.scaling_length) {
+    if (0 < utest_state.stress_threads) {
+      threads = UTEST_CAST(size_t, utest_state.stress_threads);
+    }
+
+    /* a shorter untimed run first warms up the caches and the CPU's clock */
+    if (utest_state.isolate_noise) {
+      utest_stress_once(body, threads, iterations / 10 + 1, result, 0);
+    }
+
+    utest_stress_once(body, threads, iterations, result, 1);
+    return;
+  }
+
+  throughputs = UTEST_PTR_CAST(
+      double *, calloc(utest_state.scaling_length, sizeof(double)));
+
+  if (UTEST_NULL == throughputs) {
+    UTEST_PRINTF("   Scaling : out of memory\n");
+    utest_set_result(result, UTEST_TEST_FAILURE);
+    return;
+  }
+
+  for (index = 0; index < utest_state.scaling_length; index++) {
+    if (UTEST_TEST_FAILURE == utest_atomic_load(result)) {
+      break;
+    }
+
+    if (utest_state.isolate_noise) {
+      utest_stress_once(body, utest_state.scaling[index], iterations / 10 + 1,
+                        result, 0);
+    }
+
+    throughputs[index] = utest_stress_once(body, utest_state.scaling[index],
+                                           iterations, result, 1);
+  }
+
+  utest_stress_scaling_report(utest_state.scaling, throughputs, index);
+  free(throughputs);
+}
+
+#if defined(UTEST_HAS_EXCEPTIONS)
+#define UTEST_STRESS_CALL(SET, NAME)                                           \
+  try {                                                                        \
+    utest_run_##SET##_##NAME(utest_result);                                    \
+  } catch (const std::exception &err) {                                        \
+    UTEST_PRINTF(" Exception : %s\n", err.what());                             \
+    utest_set_result(utest_result, UTEST_TEST_FAILURE);                        \
+  } catch (...) {                                                              \
+    UTEST_PRINTF(" Exception : Unknown\n");                                    \
+    utest_set_result(utest_result, UTEST_TEST_FAILURE);                        \
+  }
+#else
+#define UTEST_STRESS_CALL(SET, NAME) utest_run_##SET##_##NAME(utest_result);
+#endif
+
+/* which of the threads, and which of its iterations, the stress body is on */
+#define UTEST_STRESS_THREAD() (utest_thread_context()->stress_thread)
+#define UTEST_STRESS_ITERATION() (utest_thread_context()->stress_iteration)
+
+#define UTEST_STRESS(SET, NAME, THREADS, ITERATIONS)                           \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  static void utest_run_##SET##_##NAME(int *utest_result);                     \
+  static void utest_stress_##SET##_##NAME(int *utest_result) {                 \
+    UTEST_SURPRESS_WARNING_BEGIN                                               \
+    UTEST_STRESS_CALL(SET, NAME)                                               \
+    UTEST_SURPRESS_WARNING_END                                                 \
+  }                                                                            \
+  static void utest_##SET##_##NAME(int *utest_result, size_t utest_index) {    \
+    (void)utest_index;                                                         \
+    utest_stress_run(&utest_stress_##SET##_##NAME, THREADS, ITERATIONS,        \
+                     utest_result);                                            \
+  }                                                                            \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    const size_t index = utest_state.tests_length++;                           \
+    const char *name_part = #SET "." #NAME;                                    \
+    const size_t name_size = strlen(name_part) + 1;                            \
+    char *name = UTEST_PTR_CAST(char *, malloc(name_size));                    \
+    utest_state.tests = UTEST_PTR_CAST(                                        \
+        struct utest_test_state_s *,                                           \
+        utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),               \
+                      sizeof(struct utest_test_state_s) *                      \
+                          utest_state.tests_length));                          \
+    if (utest_state.tests) {                                                   \
+      utest_state.tests[index].func = &utest_##SET##_##NAME;                   \
+      utest_state.tests[index].name = name;                                    \
+      utest_state.tests[index].index = 0;                                      \
+      UTEST_SNPRINTF(name, name_size, "%s", name_part);                        \
+    } else if (name) {                                                         \
+      free(name);                                                              \
+    }                                                                          \
+  }                                                                            \
+  void utest_run_##SET##_##NAME(int *utest_result)
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wvariadic-macros"
+#pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+#pragma clang diagnostic ignored "-Wc++98-compat"
+#endif
+
+/*
+   register one instantiation of a typed test as "SET.NAME<type>", where the
+   type's name is the type_index'th entry of the stringified type list.
+*/
+UTEST_WEAK
+void utest_typed_register(const char *name_part, const char *types,
+                          size_t type_index, utest_testcase_t func);
+UTEST_WEAK
+void utest_typed_register(const char *name_part, const char *types,
+                          size_t type_index, utest_testcase_t func) {
+  const size_t index = utest_state.tests_length++;
+  size_t types_to_skip = type_index;
+  const char *type_begin = types;
+  const char *type_end = UTEST_NULL;
+  size_t name_size = 0;
+  char *name = UTEST_NULL;
+  int depth = 0;
+
+  /* find the type_index'th type, skipping commas nested within templates */
+  for (type_end = types; '\0' != *type_end; type_end++) {
+    if (('<' == *type_end) || ('(' == *type_end) || ('[' == *type_end)) {
+      depth++;
+    } else if (('>' == *type_end) || (')' == *type_end) ||
+               (']' == *type_end)) {
+      depth--;
+    } else if ((',' == *type_end) && (0 == depth)) {
+      if (0 == types_to_skip) {
+        break;
+      }
+
+      types_to_skip--;
+      type_begin = type_end + 1;
+    }
+  }
+
+  while ((type_begin < type_end) && (' ' == *type_begin)) {
+    type_begin++;
+  }
+
+  while ((type_begin < type_end) && (' ' == type_end[-1])) {
+    type_end--;
+  }
+
+  name_size = strlen(name_part) + UTEST_CAST(size_t, type_end - type_begin) + 3;
+  name = UTEST_PTR_CAST(char *, malloc(name_size));
+  utest_state.tests = UTEST_PTR_CAST(
+      struct utest_test_state_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),
+                    sizeof(struct utest_test_state_s) *
+                        utest_state.tests_length));
+  if (utest_state.tests && name) {
+    utest_state.tests[index].func = func;
+    utest_state.tests[index].index = type_index;
+    utest_state.tests[index].name = name;
+    UTEST_SNPRINTF(name, name_size, "%s<%.*s>", name_part,
+                   UTEST_CAST(int, type_end - type_begin), type_begin);
+  } else if (name) {
+    free(name);
+  }
+}
+
+/*
+   expand the type list with a pack expansion (rather than recursion) so that
+   each extra type costs one template instantiation and nothing more.
+*/
+template <typename TYPED, typename... TYPES> struct utest_typed_registrar {
+  static void _(const char *name_part, const char *types) {
+    size_t type_index = 0;
+    const int expand[] = {
+        0, (utest_typed_register(name_part, types, type_index++,
+                                 &TYPED::template _<TYPES>),
+            0)...};
+    (void)expand;
+  }
+};
+
+#define UTEST_TYPED(SET, NAME, ...)                                            \
+  UTEST_EXTERN struct utest_state_s utest_state;                               \
+  template <typename utest_type>                                               \
+  static void utest_run_##SET##_##NAME(int *utest_result);                     \
+  struct utest_typed_##SET##_##NAME {                                          \
+    template <typename utest_type>                                             \
+    static void _(int *utest_result, size_t utest_index) {                     \
+      (void)utest_index;                                                       \
+      utest_run_##SET##_##NAME<utest_type>(utest_result);                      \
+    }                                                                          \
+  };                                                                           \
+  UTEST_INITIALIZER(utest_register_##SET##_##NAME) {                           \
+    utest_typed_registrar<utest_typed_##SET##_##NAME, __VA_ARGS__>::_(         \
+        #SET "." #NAME, #__VA_ARGS__);                                         \
+  }                                                                            \
+  template <typename utest_type>                                               \
+  void utest_run_##SET##_##NAME(int *utest_result)
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#endif
+
+UTEST_WEAK
+int utest_should_filter_test(const char *filter, const char *testcase);
+UTEST_WEAK int utest_should_filter_test(const char *filter,
+                                        const char *testcase) {
+  if (filter) {
+    const char *filter_cur = filter;
+    const char *testcase_cur = testcase;
+    const char *filter_wildcard = UTEST_NULL;
+
+    while (('\0' != *filter_cur) && ('\0' != *testcase_cur)) {
+      if ('*' == *filter_cur) {
+        /* store the position of the wildcard */
+        filter_wildcard = filter_cur;
+
+        /* skip the wildcard character */
+        filter_cur++;
+
+        while (('\0' != *filter_cur) && ('\0' != *testcase_cur)) {
+          if ('*' == *filter_cur) {
+            /*
+               we found another wildcard (filter is something like *foo*) so we
+               exit the current loop, and return to the parent loop to handle
+               the wildcard case
+            */
+            break;
+          } else if (*filter_cur != *testcase_cur) {
+            /* otherwise our filter didn't match, so reset it */
+            filter_cur = filter_wildcard;
+          }
+
+          /* move testcase along */
+          testcase_cur++;
+
+          /* move filter along */
+          filter_cur++;
+        }
+
+        if (('\0' == *filter_cur) && ('\0' == *testcase_cur)) {
+          return 0;
+        }
+
+        /* if the testcase has been exhausted, we don't have a match! */
+        if ('\0' == *testcase_cur) {
+          return 1;
+        }
+      } else {
+        if (*testcase_cur != *filter_cur) {
+          /* test case doesn't match filter */
+          return 1;
+        } else {
+          /* move our filter and testcase forward */
+          testcase_cur++;
+          filter_cur++;
+        }
+      }
+    }
+
+    if (('\0' != *filter_cur) ||
+        (('\0' != *testcase_cur) &&
+         ((filter == filter_cur) || ('*' != filter_cur[-1])))) {
+      /* we have a mismatch! */
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static UTEST_INLINE FILE *utest_fopen(const char *filename, const char *mode) {
+#ifdef _MSC_VER
+  FILE *file;
+  if (0 == fopen_s(&file, filename, mode)) {
+    return file;
+  } else {
+    return UTEST_NULL;
+  }
+#else
+  return fopen(filename, mode);
+#endif
+}
+
+#if defined(UTEST_HAS_MMAP)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+   a read-only view of a whole file. Where the platform has mmap the file is
+   mapped rather than read, so that even a large corpus is never copied.
+*/
+struct utest_mapped_file_s {
+  const unsigned char *data;
+  size_t size;
+  void *mapping;
+};
+
+UTEST_WEAK
+int utest_map_file(const char *path, struct utest_mapped_file_s *file);
+UTEST_WEAK
+int utest_map_file(const char *path, struct utest_mapped_file_s *file) {
+#if defined(UTEST_HAS_MMAP)
+  struct stat info;
+  const int fd = open(path, O_RDONLY);
+
+  file->data = UTEST_PTR_CAST(const unsigned char *, "");
+  file->size = 0;
+  file->mapping = UTEST_NULL;
+
+  if (fd < 0) {
+    return 1;
+  }
+
+  if ((0 != fstat(fd, &info)) || !S_ISREG(info.st_mode)) {
+    close(fd);
+    return 1;
+  }
+
+  /* mmap refuses a zero sized mapping, so empty files just get "" */
+  if (0 < info.st_size) {
+    void *const mapping = mmap(UTEST_NULL, UTEST_CAST(size_t, info.st_size),
+                               PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (MAP_FAILED == mapping) {
+      close(fd);
+      return 1;
+    }
+
+    file->data = UTEST_PTR_CAST(const unsigned char *, mapping);
+    file->size = UTEST_CAST(size_t, info.st_size);
+    file->mapping = mapping;
+  }
+
+  close(fd);
+  return 0;
+#else
+  FILE *stream = utest_fopen(path, "rb");
+  long size = -1;
+
+  file->data = UTEST_PTR_CAST(const unsigned char *, "");
+  file->size = 0;
+  file->mapping = UTEST_NULL;
+
+  if (UTEST_NULL == stream) {
+    return 1;
+  }
+
+  if (0 == fseek(stream, 0, SEEK_END)) {
+    size = ftell(stream);
+  }
+
+  if ((0 > size) || (0 != fseek(stream, 0, SEEK_SET))) {
+    fclose(stream);
+    return 1;
+  }
+
+  if (0 < size) {
+    file->mapping = malloc(UTEST_CAST(size_t, size));
+
+    if ((UTEST_NULL == file->mapping) ||
+        (UTEST_CAST(size_t, size) !=
+         fread(file->mapping, 1, UTEST_CAST(size_t, size), stream))) {
+      free(file->mapping);
+      file->mapping = UTEST_NULL;
+      fclose(stream);
+      return 1;
+    }
+
+    file->data = UTEST_PTR_CAST(const unsigned char *, file->mapping);
+    file->size = UTEST_CAST(size_t, size);
+  }
+
+  fclose(stream);
+  return 0;
+#endif
+}
+
+UTEST_WEAK
+void utest_unmap_file(struct utest_mapped_file_s *file);
+UTEST_WEAK
+void utest_unmap_file(struct utest_mapped_file_s *file) {
+#if defined(UTEST_HAS_MMAP)
+  if (file->mapping) {
+    munmap(file->mapping, file->size);
+  }
+#else
+  free(file->mapping);
+#endif
+
+  file->data = UTEST_NULL;
+  file->size = 0;
+  file->mapping = UTEST_NULL;
+}
+
+UTEST_WEAK
+int utest_compare_paths(const void *a, const void *b);
+UTEST_WEAK
+int utest_compare_paths(const void *a, const void *b) {
+  return strcmp(*UTEST_PTR_CAST(const char *const *, a),
+                *UTEST_PTR_CAST(const char *const *, b));
+}
+
+UTEST_WEAK
+void utest_free_files(char **paths, size_t paths_length);
+UTEST_WEAK
+void utest_free_files(char **paths, size_t paths_length) {
+  size_t index;
+
+  for (index = 0; index < paths_length; index++) {
+    free(paths[index]);
+  }
+
+  free(paths);
+}
+
+UTEST_WEAK
+int utest_append_file(const char *directory, const char *name, char ***paths,
+                      size_t *paths_length, size_t *paths_capacity);
+UTEST_WEAK
+int utest_append_file(const char *directory, const char *name, char ***paths,
+                      size_t *paths_length, size_t *paths_capacity) {
+  const size_t path_size = strlen(directory) + strlen(name) + 2;
+  char *const path = UTEST_PTR_CAST(char *, malloc(path_size));
+
+  if (UTEST_NULL == path) {
+    return 1;
+  }
+
+  if (*paths_length == *paths_capacity) {
+    char **const new_paths = UTEST_PTR_CAST(
+        char **, utest_realloc(UTEST_PTR_CAST(void *, *paths),
+                               sizeof(char *) * (*paths_capacity * 2 + 16)));
+
+    if (UTEST_NULL == new_paths) {
+      free(path);
+      return 1;
+    }
+
+    *paths = new_paths;
+    *paths_capacity = *paths_capacity * 2 + 16;
+  }
+
+  UTEST_SNPRINTF(path, path_size, "%s/%s", directory, name);
+  (*paths)[(*paths_length)++] = path;
+  return 0;
+}
+
+/*
+   list the files (but not the sub-directories or the hidden files) within a
+   directory, as sorted "directory/name" paths that the caller must release
+   with utest_free_files. Returns non-zero if the directory couldn't be read.
+*/
+UTEST_WEAK
+int utest_list_files(const char *directory, char ***paths,
+                     size_t *paths_length);
+UTEST_WEAK
+int utest_list_files(const char *directory, char ***paths,
+                     size_t *paths_length) {
+  size_t paths_capacity = 0;
+  int failed = 0;
+#if defined(UTEST_HAS_MMAP)
+  DIR *const dir = opendir(directory);
+  struct dirent *entry;
+
+  *paths = UTEST_NULL;
+  *paths_length = 0;
+
+  if (UTEST_NULL == dir) {
+    return 1;
+  }
+
+  while (!failed && (UTEST_NULL != (entry = readdir(dir)))) {
+    if ('.' == entry->d_name[0]) {
+      continue;
+    }
+
+#if defined(DT_DIR)
+    if (DT_DIR == entry->d_type) {
+      continue;
+    }
+#endif
+
+    failed = utest_append_file(directory, entry->d_name, paths, paths_length,
+                               &paths_capacity);
+  }
+
+  closedir(dir);
+#elif defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+  struct _finddata_t entry;
+  intptr_t handle;
+  const size_t pattern_size = strlen(directory) + 3;
+  char *const pattern = UTEST_PTR_CAST(char *, malloc(pattern_size));
+
+  *paths = UTEST_NULL;
+  *paths_length = 0;
+
+  if (UTEST_NULL == pattern) {
+    return 1;
+  }
+
+  UTEST_SNPRINTF(pattern, pattern_size, "%s/*", directory);
+  handle = _findfirst(pattern, &entry);
+  free(pattern);
+
+  if (-1 == handle) {
+    return 1;
+  }
+
+  do {
+    if (('.' == entry.name[0]) || (entry.attrib & _A_SUBDIR)) {
+      continue;
+    }
+
+    failed = utest_append_file(directory, entry.name, paths, paths_length,
+                               &paths_capacity);
+  } while (!failed && (0 == _findnext(handle, &entry)));
+
+  _findclose(handle);
+#else
+  (void)directory;
+  (void)paths_capacity;
+  *paths = UTEST_NULL;
+  *paths_length = 0;
+  failed = 1;
+#endif
+
+  if (failed) {
+    utest_free_files(*paths, *paths_length);
+    *paths = UTEST_NULL;
+    *paths_length = 0;
+    return 1;
+  }
+
+  if (*paths_length) {
+    qsort(*paths, *paths_length, sizeof(char *), &utest_compare_paths);
+  }
+
+  return 0;
+}
+
+/*
+   match a file name against a glob pattern, where '*' matches any run of
+   characters and '?' matches any single character.
+*/
+UTEST_WEAK
+int utest_glob_match(const char *pattern, const char *name);
+UTEST_WEAK
+int utest_glob_match(const char *pattern, const char *name) {
+  const char *star = UTEST_NULL;
+  const char *star_name = name;
+
+  while ('\0' != *name) {
+    if ('*' == *pattern) {
+      star = pattern++;
+      star_name = name;
+    } else if (('?' == *pattern) || (*pattern == *name)) {
+      pattern++;
+      name++;
+    } else if (star) {
+      /* backtrack, letting the last '*' swallow one more character */
+      pattern = star + 1;
+      name = ++star_name;
+    } else {
+      return 0;
+    }
+  }
+
+  while ('*' == *pattern) {
+    pattern++;
+  }
+
+  return '\0' == *pattern;
+}
+
+/*
+   register a UTEST_DATA test once for each file matching glob, named
+   "SET.NAME/<file name>". Only the file name part of glob may contain
+   wildcards. When nothing matches, a single "SET.NAME" test is registered
+   that fails, rather than the data silently going untested.
+*/
+UTEST_WEAK
+void utest_data_register(const char *name_part, const char *glob,
+                         utest_testcase_t func);
+UTEST_WEAK
+void utest_data_register(const char *name_part, const char *glob,
+                         utest_testcase_t func) {
+  const char *file_glob = glob;
+  const char *cursor;
+  char *directory;
+  char **paths = UTEST_NULL;
+  size_t paths_length = 0;
+  size_t matches = 0;
+  size_t index;
+  size_t first_path;
+  size_t first_test;
+  int placeholder = 0;
+
+  for (cursor = glob; '\0' != *cursor; cursor++) {
+    if (('/' == *cursor) || ('\\' == *cursor)) {
+      file_glob = cursor + 1;
+    }
+  }
+
+  if (file_glob == glob) {
+    directory = UTEST_PTR_CAST(char *, malloc(2));
+    if (directory) {
+      UTEST_SNPRINTF(directory, 2, "%s", ".");
+    }
+  } else {
+    const size_t directory_size = UTEST_CAST(size_t, file_glob - glob);
+    directory = UTEST_PTR_CAST(char *, malloc(directory_size));
+    if (directory) {
+      memcpy(directory, glob, directory_size - 1);
+      directory[directory_size - 1] = '\0';
+    }
+  }
+
+  if (directory && (0 == utest_list_files(directory, &paths, &paths_length))) {
+    /* keep the matching paths at the front of the (still sorted) list */
+    for (index = 0; index < paths_length; index++) {
+      char *const path = paths[index];
+
+      if (utest_glob_match(file_glob, path + strlen(directory) + 1)) {
+        paths[index] = paths[matches];
+        paths[matches++] = path;
+      }
+    }
+
+    for (index = matches; index < paths_length; index++) {
+      free(paths[index]);
+    }
+  }
+
+  if (0 == matches) {
+    /* the failing placeholder test reads the glob itself, which won't map */
+    const size_t glob_size = strlen(glob) + 1;
+    free(paths);
+    paths = UTEST_PTR_CAST(char **, malloc(sizeof(char *)));
+    if (paths) {
+      paths[0] = UTEST_PTR_CAST(char *, malloc(glob_size));
+      if (paths[0]) {
+        UTEST_SNPRINTF(paths[0], glob_size, "%s", glob);
+        matches = 1;
+        placeholder = 1;
+      }
+    }
+  }
+
+  first_path = utest_state.data_paths_length;
+  first_test = utest_state.tests_length;
+  utest_state.data_paths_length += matches;
+  utest_state.tests_length += matches;
+
+  utest_state.data_paths = UTEST_PTR_CAST(
+      char **, utest_realloc(UTEST_PTR_CAST(void *, utest_state.data_paths),
+                             sizeof(char *) * utest_state.data_paths_length));
+  utest_state.tests = UTEST_PTR_CAST(
+      struct utest_test_state_s *,
+      utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),
+                    sizeof(struct utest_test_state_s) *
+                        utest_state.tests_length));
+
+  for (index = 0; index < matches; index++) {
+    const char *const file_name =
+        placeholder ? "" : paths[index] + strlen(directory) + 1;
+    const size_t name_size = strlen(name_part) + strlen(file_name) + 2;
+    char *const name = UTEST_PTR_CAST(char *, malloc(name_size));
+
+    if (!utest_state.data_paths || !utest_state.tests || !name) {
+      if (utest_state.data_paths) {
+        utest_state.data_paths[first_path + index] = UTEST_NULL;
+      }
+      free(paths[index]);
+      free(name);
+      continue;
+    }
+
+    UTEST_SNPRINTF(name, name_size, placeholder ? "%s%s" : "%s/%s", name_part,
+                   file_name);
+    utest_state.data_paths[first_path + index] = paths[index];
+    utest_state.tests[first_test + index].func = func;
+    utest_state.tests[first_test + index].name = name;
+    utest_state.tests[first_test + index].index = first_path + index;
+  }
+
+  free(paths);
+  free(directory);
+}
+
+/* map a UTEST_DATA test's file, run the body over it, and unmap it again */
+UTEST_WEAK
+void utest_data_run(const char *path, utest_data_body_t body,
+                    int *utest_result);
+UTEST_WEAK
+void utest_data_run(const char *path, utest_data_body_t body,
+                    int *utest_result) {
+  struct utest_mapped_file_s file;
+
+  if (0 != utest_map_file(path, &file)) {
+    if (strpbrk(path, "*?")) {
+      UTEST_PRINTF("      Data : no files match '%s'\n", path);
+    } else {
+      UTEST_PRINTF("      Data : could not read '%s'\n", path);
+    }
+    *utest_result = UTEST_TEST_FAILURE;
+    return;
+  }
+
+  body(utest_result, path, file.data, file.size);
+  utest_unmap_file(&file);
+}
+
+#ifndef UTEST_SNAPSHOT_DIR
+#define UTEST_SNAPSHOT_DIR "snapshots"
+#endif
+
+#ifndef UTEST_SNAPSHOT_DIFF_LINES
+#define UTEST_SNAPSHOT_DIFF_LINES 16
+#endif
+
+#ifndef UTEST_SNAPSHOT_DIFF_WIDTH
+#define UTEST_SNAPSHOT_DIFF_WIDTH 120
+#endif
+
+/* print one line of a snapshot diff, escaping anything unprintable */
+UTEST_WEAK
+const unsigned char *utest_print_snapshot_line(const char *marker,
+                                               const unsigned char *line,
+                                               const unsigned char *end);
+UTEST_WEAK
+const unsigned char *utest_print_snapshot_line(const char *marker,
+                                               const unsigned char *line,
+                                               const unsigned char *end) {
+  char text[UTEST_SNAPSHOT_DIFF_WIDTH * 4 + 4];
+  size_t length = 0;
+
+  for (; (line < end) && ('\n' != *line); line++) {
+    if (UTEST_SNAPSHOT_DIFF_WIDTH <= length) {
+      UTEST_SNPRINTF(text + length, 4, "%s", "...");
+      length += 3;
+      break;
+    } else if (((0x20 <= *line) && (0x7f > *line)) || ('\t' == *line)) {
+      text[length++] = UTEST_CAST(char, *line);
+    } else {
+      UTEST_SNPRINTF(text + length, 5, "\\x%02x", UTEST_CAST(unsigned, *line));
+      length += 4;
+    }
+  }
+
+  text[length] = '\0';
+  UTEST_PRINTF("    %s%s\n", marker, text);
+
+  /* skip whatever of the line was too long to print */
+  while ((line < end) && ('\n' != *line)) {
+    line++;
+  }
+
+  return (line < end) ? line + 1 : end;
+}
+
+/*
+   print at most max_lines of [line, end) with marker, and say how many more
+   there were.
+*/
+UTEST_WEAK
+void utest_print_snapshot_lines(const char *marker, const unsigned char *line,
+                                const unsigned char *end, size_t max_lines);
+UTEST_WEAK
+void utest_print_snapshot_lines(const char *marker, const unsigned char *line,
+                                const unsigned char *end, size_t max_lines) {
+  size_t more = 0;
+
+  for (; (line < end) && (0 < max_lines); max_lines--) {
+    line = utest_print_snapshot_line(marker, line, end);
+  }
+
+  for (; line < end; line++) {
+    if (('\n' == *line) || (line + 1 == end)) {
+      more++;
+    }
+  }
+
+  if (more) {
+    UTEST_PRINTF("    ... %lu more lines\n", UTEST_CAST(unsigned long, more));
+  }
+}
+
+/*
+   print the single hunk that covers everything between the common prefix and
+   the common suffix of expected and actual, widened to whole lines with a few
+   lines of context either side, and with each side bounded to
+   UTEST_SNAPSHOT_DIFF_LINES lines so that a huge output doesn't drown the log.
+*/
+UTEST_WEAK
+void utest_print_snapshot_diff(const unsigned char *expected,
+                               size_t expected_size,
+                               const unsigned char *actual,
+                               size_t actual_size);
+UTEST_WEAK
+void utest_print_snapshot_diff(const unsigned char *expected,
+                               size_t expected_size,
+                               const unsigned char *actual,
+                               size_t actual_size) {
+  const size_t common =
+      expected_size < actual_size ? expected_size : actual_size;
+  size_t prefix = 0;
+  size_t suffix = 0;
+  size_t begin;
+  size_t context;
+  size_t expected_end;
+  size_t actual_end;
+  size_t line_number = 1;
+  size_t context_lines;
+  size_t index;
+
+  while ((prefix < common) && (expected[prefix] == actual[prefix])) {
+    prefix++;
+  }
+
+  while ((suffix < common - prefix) &&
+         (expected[expected_size - suffix - 1] ==
+          actual[actual_size - suffix - 1])) {
+    suffix++;
+  }
+
+  /* the prefix is common, so the hunk begins at the same offset in both */
+  begin = prefix;
+  while ((0 < begin) && ('\n' != expected[begin - 1])) {
+    begin--;
+  }
+
+  context = begin;
+  for (context_lines = 0; (0 < context) && (3 > context_lines);
+       context_lines++) {
+    context--;
+    while ((0 < context) && ('\n' != expected[context - 1])) {
+      context--;
+    }
+  }
+
+  for (index = 0; index < context; index++) {
+    line_number += ('\n' == expected[index]) ? 1 : 0;
+  }
+
+  expected_end = expected_size - suffix;
+  while ((expected_end < expected_size) && (begin < expected_end) &&
+         ('\n' != expected[expected_end - 1])) {
+    expected_end++;
+  }
+
+  actual_end = actual_size - suffix;
+  while ((actual_end < actual_size) && (begin < actual_end) &&
+         ('\n' != actual[actual_end - 1])) {
+    actual_end++;
+  }
+
+  UTEST_PRINTF("      Diff : first difference at byte %lu, in the hunk "
+               "from line %lu\n",
+               UTEST_CAST(unsigned long, prefix),
+               UTEST_CAST(unsigned long, line_number));
+  utest_print_snapshot_lines("  ", expected + context, expected + begin, 3);
+  utest_print_snapshot_lines("- ", expected + begin, expected + expected_end,
+                             UTEST_SNAPSHOT_DIFF_LINES);
+  utest_print_snapshot_lines("+ ", actual + begin, actual + actual_end,
+                             UTEST_SNAPSHOT_DIFF_LINES);
+
+  context = expected_end;
+  for (context_lines = 0; (context < expected_size) && (3 > context_lines);
+       context_lines++) {
+    while ((context < expected_size) && ('\n' != expected[context])) {
+      context++;
+    }
+    context += (context < expected_size) ? 1 : 0;
+  }
+
+  utest_print_snapshot_lines("  ", expected + expected_end, expected + context,
+                             3);
+}
+
+/*
+   replace the file at path with buffer, by writing a temporary file beside it
+   and renaming that over the original, so that an interrupted update never
+   leaves a truncated golden file behind.
+*/
+UTEST_WEAK
+int utest_write_snapshot(const char *path, const void *buffer, size_t size);
+UTEST_WEAK
+int utest_write_snapshot(const char *path, const void *buffer, size_t size) {
+  const size_t temporary_size = strlen(path) + 5;
+  char *const temporary = UTEST_PTR_CAST(char *, malloc(temporary_size));
+  FILE *file;
+  int failed;
+
+  if (UTEST_NULL == temporary) {
+    return 1;
+  }
+
+  UTEST_SNPRINTF(temporary, temporary_size, "%s.tmp", path);
+  file = utest_fopen(temporary, "wb");
+
+  if (UTEST_NULL == file) {
+    free(temporary);
+    return 1;
+  }
+
+  failed = (0 < size) && (size != fwrite(buffer, 1, size, file));
+  failed = (0 != fclose(file)) || failed;
+
+#if defined(_WIN32)
+  /* rename won't replace an existing file on Windows */
+  if (!failed) {
+    remove(path);
+  }
+#endif
+
+  if (failed || (0 != rename(temporary, path))) {
+    remove(temporary);
+    free(temporary);
+    return 1;
+  }
+
+  free(temporary);
+  return 0;
+}
+
+/*
+   check buffer against the running test's next golden file, which is
+   "<snapshot dir>/<test name>.<n>.snap" for the test's n'th snapshot check.
+   Returns non-zero (having printed why) if the check failed.
+*/
+UTEST_WEAK
+int utest_check_snapshot(int *const result, const char *file, int line,
+                         const void *buffer, size_t size);
+UTEST_WEAK
+int utest_check_snapshot(int *const result, const char *file, int line,
+                         const void *buffer, size_t size) {
+  const char *const directory =
+      utest_state.snapshot_dir ? utest_state.snapshot_dir : UTEST_SNAPSHOT_DIR;
+  const char *const test =
+      utest_state.current_test ? utest_state.current_test : "unknown";
+  const size_t path_size = strlen(directory) + strlen(test) + 32;
+  char *const path = UTEST_PTR_CAST(char *, malloc(path_size));
+  const unsigned char *const actual =
+      UTEST_PTR_CAST(const unsigned char *, buffer);
+  struct utest_mapped_file_s golden;
+  size_t index;
+  int missing;
+  int matches = 0;
+
+  if (UTEST_NULL == path) {
+    return 1;
+  }
+
+  UTEST_SNPRINTF(path, path_size, "%s/%s.%d.snap", directory, test,
+                 ++utest_state.snapshots_taken);
+
+  /* test names may contain '/' and other characters unfit for a file name */
+  for (index = strlen(directory) + 1; '\0' != path[index]; index++) {
+    const char c = path[index];
+    if (!(('a' <= c && 'z' >= c) || ('A' <= c && 'Z' >= c) ||
+          ('0' <= c && '9' >= c) || ('.' == c) || ('-' == c))) {
+      path[index] = '_';
+    }
+  }
+
+  missing = utest_map_file(path, &golden);
+
+  if (!missing) {
+    matches = (golden.size == size) &&
+              ((0 == size) || (0 == memcmp(golden.data, actual, size)));
+  }
+
+  if (!matches && utest_state.update_snapshots) {
+#if defined(UTEST_HAS_MMAP)
+    mkdir(directory, 0777);
+#elif defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+    _mkdir(directory);
+#endif
+
+    if (!missing) {
+      /* the old file must be unmapped before it can be replaced */
+      utest_unmap_file(&golden);
+      missing = 1;
+    }
+
+    if (0 == utest_write_snapshot(path, buffer, size)) {
+      UTEST_PRINTF("  Snapshot : updated %s\n", path);
+      matches = 1;
+    } else if (utest_count_failure(result)) {
+      UTEST_PRINTF("%s:%i: Failure\n", file, line);
+      UTEST_PRINTF("  Snapshot : could not write %s\n", path);
+    }
+  } else if (!matches && utest_count_failure(result)) {
+    UTEST_PRINTF("%s:%i: Failure\n", file, line);
+    if (missing) {
+      UTEST_PRINTF("  Expected : snapshot %s\n", path);
+      UTEST_PRINTF("    Actual : no such file (run with --update-snapshots to "
+                   "create it)\n");
+    } else {
+      UTEST_PRINTF("  Expected : snapshot %s (%lu bytes)\n", path,
+                   UTEST_CAST(unsigned long, golden.size));
+      UTEST_PRINTF("    Actual : %lu bytes\n", UTEST_CAST(unsigned long, size));
+      utest_print_snapshot_diff(golden.data, golden.size, actual, size);
+    }
+  }
+
+  if (!missing) {
+    utest_unmap_file(&golden);
+  }
+
+  free(path);
+  return !matches;
+}
+
+#ifndef UTEST_FUZZ_CORPUS
+#define UTEST_FUZZ_CORPUS "corpus"
+#endif
+
+/*
+   run a fuzz target over the empty input and then over every seed file in
+   "<corpus>/SET.NAME/" (a target without a seed directory only gets the empty
+   input), reporting each seed that fails.
+*/
+UTEST_WEAK
+void utest_fuzz_corpus(const char *name, utest_fuzz_body_t body,
+                       int *utest_result);
+UTEST_WEAK
+void utest_fuzz_corpus(const char *name, utest_fuzz_body_t body,
+                       int *utest_result) {
+  const char *const corpus =
+      utest_state.fuzz_corpus ? utest_state.fuzz_corpus : UTEST_FUZZ_CORPUS;
+  const size_t directory_size = strlen(corpus) + strlen(name) + 2;
+  char *const directory = UTEST_PTR_CAST(char *, malloc(directory_size));
+  char **paths = UTEST_NULL;
+  size_t paths_length = 0;
+  size_t index;
+  int result = UTEST_TEST_PASSED;
+  int *const current = utest_state.current_result;
+
+  /* the seeds' failures count against the test, as its own assertions do */
+  if (current == utest_result) {
+    utest_state.current_result = &result;
+  }
+
+  body(&result, UTEST_PTR_CAST(const unsigned char *, ""), 0);
+
+  if (UTEST_TEST_PASSED != result) {
+    if (UTEST_TEST_FAILURE == result) {
+      UTEST_PRINTF("    Corpus : <empty input>\n");
+    }
+    *utest_result = result;
+  }
+
+  if (UTEST_NULL == directory) {
+    utest_state.current_result = current;
+    *utest_result = UTEST_TEST_FAILURE;
+    return;
+  }
+
+  UTEST_SNPRINTF(directory, directory_size, "%s/%s", corpus, name);
+
+  if (0 == utest_list_files(directory, &paths, &paths_length)) {
+    for (index = 0; index < paths_length; index++) {
+      struct utest_mapped_file_s file;
+
+      if (0 != utest_map_file(paths[index], &file)) {
+        UTEST_PRINTF("    Corpus : %s (could not be read)\n", paths[index]);
+        *utest_result = UTEST_TEST_FAILURE;
+        continue;
+      }
+
+      result = UTEST_TEST_PASSED;
+      body(&result, file.data, file.size);
+      utest_unmap_file(&file);
+
+      if (UTEST_TEST_FAILURE == result) {
+        UTEST_PRINTF("    Corpus : %s\n", paths[index]);
+        *utest_result = UTEST_TEST_FAILURE;
+      }
+    }
+
+    utest_free_files(paths, paths_length);
+  }
+
+  utest_state.current_result = current;
+  free(directory);
+}
+
+/*
+   pick the target that LLVMFuzzerTestOneInput drives: the first whose name
+   matches the UTEST_FUZZ_TARGET environment variable (which takes the same
+   syntax as --filter), or the first target when it is unset.
+*/
+UTEST_WEAK
+struct utest_fuzz_target_s *utest_fuzz_target(void);
+UTEST_WEAK
+struct utest_fuzz_target_s *utest_fuzz_target(void) {
+  struct utest_fuzz_target_s *target = UTEST_NULL;
+  size_t index;
+#ifdef _MSC_VER
+  char *filter = UTEST_NULL;
+  size_t filter_length = 0;
+  _dupenv_s(&filter, &filter_length, "UTEST_FUZZ_TARGET");
+#else
+  const char *const filter = getenv("UTEST_FUZZ_TARGET");
+#endif
+
+  for (index = 0; index < utest_state.fuzz_targets_length; index++) {
+    if (!utest_should_filter_test(filter,
+                                  utest_state.fuzz_targets[index].name)) {
+      target = &utest_state.fuzz_targets[index];
+      break;
+    }
+  }
+
+  if (UTEST_NULL == target) {
+    fprintf(stderr, "utest.h: no UTEST_FUZZ target matches '%s'\n",
+            filter ? filter : "*");
+    abort();
+  }
+
+#ifdef _MSC_VER
+  free(filter);
+#endif
+
+  return target;
+}
+
+/*
+   the body of LLVMFuzzerTestOneInput, where a failed check is turned into an
+   abort so that the fuzzer records the input as a crash.
+*/
+UTEST_WEAK
+int utest_fuzz_one_input(struct utest_fuzz_target_s *target,
+                         const unsigned char *data, size_t size);
+UTEST_WEAK
+int utest_fuzz_one_input(struct utest_fuzz_target_s *target,
+                         const unsigned char *data, size_t size) {
+  int result = UTEST_TEST_PASSED;
+
+  target->body(&result, data, size);
+
+  if (UTEST_TEST_FAILURE == result) {
+    fflush(stdout);
+    abort();
+  }
+
+  return 0;
+}
+
+/*
+   what the tests are running on, recorded so that timings from different runs
+   (and machines) can be compared. Anything that can't be found is "unknown".
+*/
+struct utest_environment_s {
+  char cpu[128];
+  char governor[32];
+  char load_average[32];
+  /* set when the CPU is known to boost its clock beyond its base frequency */
+  int turbo;
+};
+
+/* read the first line of a (small, usually /proc or /sys) file */
+static UTEST_INLINE int utest_read_line(const char *const path,
+                                        char *const line, const size_t size) {
+  FILE *const file = utest_fopen(path, "r");
+  char *end;
+
+  if (UTEST_NULL == file) {
+    return 1;
+  }
+
+  if (UTEST_NULL == fgets(line, UTEST_CAST(int, size), file)) {
+    fclose(file);
+    return 1;
+  }
+
+  fclose(file);
+
+  end = strchr(line, '\n');
+  if (UTEST_NULL != end) {
+    *end = '\0';
+  }
+
+  return 0;
+}
+
+/*
+   if line is the "model name" line of /proc/cpuinfo, copy the name of the CPU
+   it holds into cpu and return non-zero.
+*/
+UTEST_WEAK int utest_parse_cpuinfo_line(const char *const line, char *const cpu,
+                                        const size_t size);
+UTEST_WEAK int utest_parse_cpuinfo_line(const char *const line, char *const cpu,
+                                        const size_t size) {
+  const char *colon;
+  const char *name;
+
+  if (0 != UTEST_STRNCMP(line, "model name", strlen("model name"))) {
+    return 0;
+  }
+
+  colon = strchr(line, ':');
+  if (UTEST_NULL == colon) {
+    return 0;
+  }
+
+  for (name = colon + 1; (' ' == *name) || ('\t' == *name); name++) {
+  }
+
+  if (('\0' == *name) || ('\n' == *name)) {
+    return 0;
+  }
+
+  UTEST_SNPRINTF(cpu, size, "%s", name);
+  cpu[strcspn(cpu, "\n")] = '\0';
+  return 1;
+}
+
+/*
+   cut the line read from /proc/loadavg down to its first three fields (the 1, 5
+   and 15 minute load averages), returning non-zero if it doesn't have them.
+*/
+UTEST_WEAK int utest_parse_loadavg(char *const line);
+UTEST_WEAK int utest_parse_loadavg(char *const line) {
+  char *end = line;
+  int fields;
+
+  for (fields = 0; fields < 3; fields++) {
+    const char *const field = end;
+
+    (void)strtod(field, &end);
+    if ((end == field) || ((' ' != *end) && ('\0' != *end))) {
+      return 1;
+    }
+  }
+
+  *end = '\0';
+  return 0;
+}
+
+UTEST_WEAK void
+utest_environment_read(struct utest_environment_s *const environment,
+                       const size_t cpu);
+UTEST_WEAK void
+utest_environment_read(struct utest_environment_s *const environment,
+                       const size_t cpu) {
+  char line[256];
+  char path[96];
+  FILE *file;
+
+  UTEST_SNPRINTF(environment->cpu, sizeof(environment->cpu), "unknown");
+  environment->turbo = 0;
+
+  file = utest_fopen("/proc/cpuinfo", "r");
+  if (UTEST_NULL != file) {
+    while (UTEST_NULL != fgets(line, sizeof(line), file)) {
+      if (utest_parse_cpuinfo_line(line, environment->cpu,
+                                   sizeof(environment->cpu))) {
+        break;
+      }
+    }
+
+    fclose(file);
+  }
+
+  UTEST_SNPRINTF(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%" UTEST_PRIu64
+                 "/cpufreq/scaling_governor",
+                 UTEST_CAST(utest_uint64_t, cpu));
+  if (0 != utest_read_line(path, environment->governor,
+                           sizeof(environment->governor))) {
+    UTEST_SNPRINTF(environment->governor, sizeof(environment->governor),
+                   "unknown");
+  }
+
+  if ((0 != utest_read_line("/proc/loadavg", environment->load_average,
+                            sizeof(environment->load_average))) ||
+      (0 != utest_parse_loadavg(environment->load_average))) {
+    UTEST_SNPRINTF(environment->load_average,
+                   sizeof(environment->load_average), "unknown");
+  }
+
+  /* intel_pstate has its own switch, other drivers share the boost one */
+  if ((0 == utest_read_line("/sys/devices/system/cpu/intel_pstate/no_turbo",
+                            line, sizeof(line)) &&
+       ('0' == line[0])) ||
+      (0 == utest_read_line("/sys/devices/system/cpu/cpufreq/boost", line,
+                            sizeof(line)) &&
+       ('1' == line[0]))) {
+    environment->turbo = 1;
+  }
+}
+
+/* raise the scheduling priority of the calling thread, returning zero if so */
+UTEST_WEAK int utest_raise_priority(void);
+UTEST_WEAK int utest_raise_priority(void) {
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+  /* THREAD_PRIORITY_HIGHEST */
+  return 0 == SetThreadPriority(GetCurrentThread(), 2);
+#elif defined(UTEST_HAS_FORK)
+  return 0 != setpriority(PRIO_PROCESS, 0, -20);
+#else
+  return 1;
+#endif
+}
+
+/*
+   the tests that failed the last time they were run are kept in a file, one
+   name per line, so that --rerun-failed and --failed-first can pick them out.
+   Unless --failed-file names it, the file is UTEST_LAST_FAILED followed by the
+   name of the test binary.
+*/
+#ifndef UTEST_LAST_FAILED
+#define UTEST_LAST_FAILED ".utest-last-failed"
+#endif
+
+/* the default file for the failed tests of binary (EG. argv[0]) */
+UTEST_WEAK char *utest_last_failed_path(const char *binary);
+UTEST_WEAK char *utest_last_failed_path(const char *binary) {
+  const char *name = binary;
+  const char *c;
+  size_t size;
+  char *path;
+
+  for (c = binary; '\0' != *c; c++) {
+    if (('/' == *c) || ('\\' == *c)) {
+      name = c + 1;
+    }
+  }
+
+  size = strlen(UTEST_LAST_FAILED) + strlen(name) + 2;
+  path = UTEST_PTR_CAST(char *, malloc(size));
+
+  if (UTEST_NULL != path) {
+    UTEST_SNPRINTF(path, size, "%s-%s", UTEST_LAST_FAILED, name);
+  }
+
+  return path;
+}
+
+/* read a list of test names, or return null if there isn't one */
+UTEST_WEAK char *utest_last_failed_read(const char *path);
+UTEST_WEAK char *utest_last_failed_read(const char *path) {
+  FILE *const file = utest_fopen(path, "rb");
+  char *list = UTEST_NULL;
+  size_t length = 0;
+
+  if (UTEST_NULL == file) {
+    return UTEST_NULL;
+  }
+
+  for (;;) {
+    char *const grown = UTEST_PTR_CAST(char *, realloc(list, length + 1025));
+    size_t read;
+
+    if (UTEST_NULL == grown) {
+      free(list);
+      fclose(file);
+      return UTEST_NULL;
+    }
+
+    list = grown;
+    read = fread(list + length, 1, 1024, file);
+    length += read;
+
+    if (1024 > read) {
+      break;
+    }
+  }
+
+  fclose(file);
+
+  /* end the last name with a newline too, so every name ends the same way */
+  if ((0 < length) && ('\n' != list[length - 1])) {
+    list[length++] = '\n';
+  }
+
+  list[length] = '\0';
+  return list;
+}
+
+UTEST_WEAK int utest_last_failed_contains(const char *list, const char *name);
+UTEST_WEAK int utest_last_failed_contains(const char *list, const char *name) {
+  const size_t length = strlen(name);
+
+  while ('\0' != *list) {
+    const char *const end = strchr(list, '\n');
+
+    if ((UTEST_CAST(size_t, end - list) == length) &&
+        (0 == UTEST_STRNCMP(list, name, length))) {
+      return 1;
+    }
+
+    list = end + 1;
+  }
+
+  return 0;
+}
+
+/* is the test picked out by --filter (and by --rerun-failed) to be run? */
+static UTEST_INLINE int utest_selected(const char *filter, const char *rerun,
+                                       const char *name) {
+  return !utest_should_filter_test(filter, name) &&
+         ((UTEST_NULL == rerun) || utest_last_failed_contains(rerun, name));
+}
+
+/*
+   move the tests in the list to the front of the order they are run in, but
+   otherwise keep the order as it was.
+*/
+UTEST_WEAK void utest_last_failed_first(size_t *order, size_t length,
+                                        const char *list);
+UTEST_WEAK void utest_last_failed_first(size_t *order, size_t length,
+                                        const char *list) {
+  size_t *const sorted =
+      UTEST_PTR_CAST(size_t *, malloc(sizeof(size_t) * (length + 1)));
+  size_t sorted_length = 0;
+  size_t pass;
+  size_t index;
+
+  if (UTEST_NULL == sorted) {
+    return;
+  }
+
+  for (pass = 0; pass < 2; pass++) {
+    for (index = 0; index < length; index++) {
+      const int failed = utest_last_failed_contains(
+          list, utest_state.tests[order[index]].name);
+
+      if ((0 == pass) == (0 != failed)) {
+        sorted[sorted_length++] = order[index];
+      }
+    }
+  }
+
+  memcpy(order, sorted, sizeof(size_t) * length);
+  free(sorted);
+}
+
+/* how a test fared over its runs (there are several with --repeat) */
+struct utest_repeat_s {
+  utest_uint64_t runs;
+  /* the runs that didn't fail, including those that were skipped */
+  utest_uint64_t passes;
+  utest_uint64_t skips;
+  double mean_ns;
+  /* the sum of squared differences from the mean (see Welford's algorithm) */
+  double m2_ns;
+  /*
+     whether the summary lists the test as failed or skipped (never both). Only
+     the runner records results (workers send theirs back down pipes), so
+     these are plain ints.
+  */
+  int failed;
+  int skipped;
+};
+
+/* add a run of a test, that took ns and ended with result, to its stats */
+UTEST_WEAK void utest_repeat_add(struct utest_repeat_s *const stats,
+                                 const int result, const utest_int64_t ns);
+UTEST_WEAK void utest_repeat_add(struct utest_repeat_s *const stats,
+                                 const int result, const utest_int64_t ns) {
+  const double delta = UTEST_CAST(double, ns) - stats->mean_ns;
+
+  stats->runs++;
+  stats->passes += (UTEST_TEST_FAILURE != result) ? 1 : 0;
+  stats->skips += (UTEST_TEST_SKIPPED == result) ? 1 : 0;
+  stats->mean_ns += delta / UTEST_CAST(double, stats->runs);
+  stats->m2_ns += delta * (UTEST_CAST(double, ns) - stats->mean_ns);
+}
+
+/* the percentage of a test's runs that passed (or were skipped) */
+UTEST_WEAK double
+utest_repeat_pass_rate(const struct utest_repeat_s *const stats);
+UTEST_WEAK double
+utest_repeat_pass_rate(const struct utest_repeat_s *const stats) {
+  return 0 < stats->runs ? 100.0 * UTEST_CAST(double, stats->passes) /
+                               UTEST_CAST(double, stats->runs)
+                         : 0.0;
+}
+
+/* the (population) standard deviation of how long a test's runs took */
+UTEST_WEAK double
+utest_repeat_stddev(const struct utest_repeat_s *const stats);
+UTEST_WEAK double
+utest_repeat_stddev(const struct utest_repeat_s *const stats) {
+  return 0 < stats->runs
+             ? utest_sqrt(stats->m2_ns / UTEST_CAST(double, stats->runs))
+             : 0.0;
+}
+
+/*
+   update the list of failed tests. A test that ran this time is only kept in
+   the list if it failed again, and a test that didn't run keeps its entry.
+*/
+UTEST_WEAK void utest_last_failed_write(const char *path, const char *previous,
+                                        const struct utest_repeat_s *repeats);
+UTEST_WEAK void utest_last_failed_write(const char *path, const char *previous,
+                                        const struct utest_repeat_s *repeats) {
+  FILE *file = UTEST_NULL;
+  size_t entries = 0;
+  size_t pass;
+
+  /* the first pass counts the entries, the second writes them */
+  for (pass = 0; pass < 2; pass++) {
+    const char *line = previous;
+    size_t index;
+
+    if ((1 == pass) && (0 == entries)) {
+      /* nothing is failing, so there's no list to keep */
+      remove(path);
+      return;
+    } else if (1 == pass) {
+      file = utest_fopen(path, "wb");
+
+      if (UTEST_NULL == file) {
+        return;
+      }
+    }
+
+    while ((UTEST_NULL != line) && ('\0' != *line)) {
+      const char *const end = strchr(line, '\n');
+      const size_t length = UTEST_CAST(size_t, end - line) + 1;
+      int ran = 0;
+
+      for (index = 0; index < utest_state.tests_length; index++) {
+        if ((strlen(utest_state.tests[index].name) + 1 == length) &&
+            (0 == UTEST_STRNCMP(line, utest_state.tests[index].name,
+                                length - 1))) {
+          ran = (0 < repeats[index].runs);
+          break;
+        }
+      }
+
+      if (!ran) {
+        entries++;
+
+        if (UTEST_NULL != file) {
+          fwrite(line, 1, length, file);
+        }
+      }
+
+      line = end + 1;
+    }
+
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (repeats[index].runs != repeats[index].passes) {
+        entries++;
+
+        if (UTEST_NULL != file) {
+          fprintf(file, "%s\n", utest_state.tests[index].name);
+        }
+      }
+    }
+  }
+
+  fclose(file);
+}
+
+/*
+   with --cache, the tests that passed are remembered along with a key, and
+   aren't run again until the key changes. The key hashes the test binary, the
+   options that change what the tests do, and the path, size and modification
+   time of the files the tests read (the UTEST_DATA files, the snapshots and
+   the fuzz corpus). Anything else a test reads (the environment, files it
+   opens itself) isn't part of the key, so such tests shouldn't be cached.
+*/
+#ifndef UTEST_CACHE
+#define UTEST_CACHE ".utest-cache"
+#endif
+
+static UTEST_INLINE utest_uint64_t utest_fnv1a_update(utest_uint64_t hash,
+                                                      const void *data,
+                                                      const size_t size) {
+  const unsigned char *const bytes =
+      UTEST_PTR_CAST(const unsigned char *, data);
+  size_t index;
+
+  for (index = 0; index < size; index++) {
+    hash = (hash ^ bytes[index]) * 0x100000001b3u;
+  }
+
+  return hash;
+}
+
+static UTEST_INLINE utest_uint64_t utest_fnv1a(const unsigned char *data,
+                                               const size_t size) {
+  return utest_fnv1a_update(0xcbf29ce484222325u, data, size);
+}
+
+/*
+   fold a file the tests read into key: its path and, where they can be had
+   without reading it, its size and modification time, else its contents.
+*/
+static UTEST_INLINE utest_uint64_t utest_cache_key_file(utest_uint64_t key,
+                                                        const char *path) {
+#if defined(UTEST_HAS_MMAP)
+  struct stat info;
+  utest_uint64_t fields[2];
+#else
+  struct utest_mapped_file_s file;
+#endif
+
+  /* the terminator keeps "ab" + "c" apart from "a" + "bc" */
+  key = utest_fnv1a_update(key, path, strlen(path) + 1);
+
+#if defined(UTEST_HAS_MMAP)
+  if (0 == stat(path, &info)) {
+    fields[0] = UTEST_CAST(utest_uint64_t, info.st_size);
+    fields[1] = UTEST_CAST(utest_uint64_t, info.st_mtime);
+    key = utest_fnv1a_update(key, fields, sizeof(fields));
+  }
+#else
+  if (0 == utest_map_file(path, &file)) {
+    key = utest_fnv1a_update(key, file.data, file.size);
+    utest_unmap_file(&file);
+  }
+#endif
+
+  return key;
+}
+
+static UTEST_INLINE utest_uint64_t
+utest_cache_key_directory(utest_uint64_t key, const char *directory) {
+  char **paths = UTEST_NULL;
+  size_t paths_length = 0;
+  size_t index;
+
+  if (0 == utest_list_files(directory, &paths, &paths_length)) {
+    for (index = 0; index < paths_length; index++) {
+      key = utest_cache_key_file(key, paths[index]);
+    }
+
+    utest_free_files(paths, paths_length);
+  }
+
+  return key;
+}
+
+/*
+   compute the cache key for a run (after the options have been parsed),
+   returning zero if the test binary can't be read.
+*/
+UTEST_WEAK utest_uint64_t utest_cache_key(const int argc,
+                                          const char *const argv[]);
+UTEST_WEAK utest_uint64_t utest_cache_key(const int argc,
+                                          const char *const argv[]) {
+  /* the options that only choose which tests run or how they're reported */
+  static const char *const ignored[] = {
+      "--filter=",        "--output=",       "--list-tests",
+      "--enable-mixed",   "--random-order",  "--fail-fast",
+      "--max-failures",   "--crash-handler", "--processes=",
+      "--recycle-after=", "--rerun-failed",  "--failed-first",
+      "--failed-file=",   "--cache"};
+  const char *const snapshots =
+      utest_state.snapshot_dir ? utest_state.snapshot_dir : UTEST_SNAPSHOT_DIR;
+  const char *const corpus =
+      utest_state.fuzz_corpus ? utest_state.fuzz_corpus : UTEST_FUZZ_CORPUS;
+  struct utest_mapped_file_s file;
+  utest_uint64_t key;
+  size_t index;
+  size_t option;
+
+  /* argv[0] isn't always a path to the binary, but on Linux there is one */
+  if ((0 != utest_map_file("/proc/self/exe", &file)) &&
+      (0 != utest_map_file(argv[0], &file))) {
+    return 0;
+  }
+
+  key = utest_fnv1a(file.data, file.size);
+  utest_unmap_file(&file);
+
+  for (index = 1; index < UTEST_CAST(size_t, argc); index++) {
+    for (option = 0; option < sizeof(ignored) / sizeof(ignored[0]); option++) {
+      if (0 == UTEST_STRNCMP(argv[index], ignored[option],
+                             strlen(ignored[option]))) {
+        break;
+      }
+    }
+
+    if (sizeof(ignored) / sizeof(ignored[0]) == option) {
+      key = utest_fnv1a_update(key, argv[index], strlen(argv[index]) + 1);
+    }
+  }
+
+  for (index = 0; index < utest_state.data_paths_length; index++) {
+    if (UTEST_NULL != utest_state.data_paths[index]) {
+      key = utest_cache_key_file(key, utest_state.data_paths[index]);
+    }
+  }
+
+  key = utest_cache_key_directory(key, snapshots);
+
+  for (index = 0; index < utest_state.fuzz_targets_length; index++) {
+    const char *const name = utest_state.fuzz_targets[index].name;
+    const size_t directory_size = strlen(corpus) + strlen(name) + 2;
+    char *const directory = UTEST_PTR_CAST(char *, malloc(directory_size));
+
+    if (UTEST_NULL != directory) {
+      UTEST_SNPRINTF(directory, directory_size, "%s/%s", corpus, name);
+      key = utest_cache_key_directory(key, directory);
+      free(directory);
+    }
+  }
+
+  return 0 == key ? 1 : key;
+}
+
+/*
+   mark which of the tests are in a list of names. The list can have tens of
+   thousands of tests in it, so they are looked up in a hash table.
+*/
+UTEST_WEAK void utest_cache_mark(const char *list, unsigned char *marks);
+UTEST_WEAK void utest_cache_mark(const char *list, unsigned char *marks) {
+  size_t buckets = 1;
+  size_t *table;
+  size_t index;
+
+  while (buckets < 2 * utest_state.tests_length) {
+    buckets *= 2;
+  }
+
+  /* each bucket holds the index of a test plus one, or zero when empty */
+  table = UTEST_PTR_CAST(size_t *, calloc(buckets, sizeof(size_t)));
+
+  if (UTEST_NULL == table) {
+    return;
+  }
+
+  for (index = 0; index < utest_state.tests_length; index++) {
+    const char *const name = utest_state.tests[index].name;
+    size_t bucket = UTEST_CAST(
+        size_t,
+        utest_fnv1a(UTEST_PTR_CAST(const unsigned char *, name), strlen(name)));
+
+    for (bucket &= buckets - 1; 0 != table[bucket];
+         bucket = (bucket + 1) & (buckets - 1)) {
+    }
+
+    table[bucket] = index + 1;
+  }
+
+  while ('\0' != *list) {
+    const char *const end = strchr(list, '\n');
+    const size_t length = UTEST_CAST(size_t, end - list);
+    size_t bucket = UTEST_CAST(
+        size_t,
+        utest_fnv1a(UTEST_PTR_CAST(const unsigned char *, list), length));
+
+    for (bucket &= buckets - 1; 0 != table[bucket];
+         bucket = (bucket + 1) & (buckets - 1)) {
+      const char *const name = utest_state.tests[table[bucket] - 1].name;
+
+      if ((strlen(name) == length) &&
+          (0 == UTEST_STRNCMP(list, name, length))) {
+        marks[table[bucket] - 1] = 1;
+        break;
+      }
+    }
+
+    list = end + 1;
+  }
+
+  free(table);
+}
+
+/*
+   rewrite the cache with the tests that passed this time (every time they ran,
+   without being skipped), and the tests that were already cached.
+*/
+UTEST_WEAK void utest_cache_write(const char *path, const char *header,
+                                  const unsigned char *cached,
+                                  const struct utest_repeat_s *repeats);
+UTEST_WEAK void utest_cache_write(const char *path, const char *header,
+                                  const unsigned char *cached,
+                                  const struct utest_repeat_s *repeats) {
+  FILE *const file = utest_fopen(path, "wb");
+  size_t index;
+
+  if (UTEST_NULL == file) {
+    return;
+  }
+
+  fputs(header, file);
+
+  for (index = 0; index < utest_state.tests_length; index++) {
+    const struct utest_repeat_s *const stats = &repeats[index];
+
+    if (cached[index] || ((0 < stats->runs) && (stats->runs == stats->passes) &&
+                          (0 == stats->skips))) {
+      fprintf(file, "%s\n", utest_state.tests[index].name);
+    }
+  }
+
+  fclose(file);
+}
+
+/*
+   with --crash-handler, a test that crashes gets its name, a backtrace and the
+   results so far printed, and the XML output closed, before the signal is
+   re-raised. Nothing in a crashed process can be trusted, so the handler only
+   writes straight to file descriptors.
+*/
+#if defined(UTEST_HAS_FORK)
+#include <signal.h>
+/* signal.h only has sigaction and kill when the POSIX extensions are on */
+#if defined(SA_ONSTACK)
+#define UTEST_HAS_POSIX_SIGNALS
+#endif
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define UTEST_HAS_BACKTRACE
+#include <execinfo.h>
+#endif
+#endif
+
+#ifndef UTEST_CRASH_STACK_SIZE
+#define UTEST_CRASH_STACK_SIZE 65536
+#endif
+
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+static UTEST_INLINE void utest_crash_write(const int fd, const char *text) {
+  size_t length = strlen(text);
+
+  while (0 < length) {
+    const ssize_t wrote = write(fd, text, length);
+
+    if ((0 > wrote) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= wrote) {
+      return;
+    }
+
+    text += wrote;
+    length -= UTEST_CAST(size_t, wrote);
+  }
+}
+
+static UTEST_INLINE void utest_crash_write_u64(const int fd,
+                                               utest_uint64_t value) {
+  char digits[24];
+  size_t index = sizeof(digits) - 1;
+
+  digits[index] = '\0';
+
+  do {
+    digits[--index] = UTEST_CAST(char, '0' + value % 10);
+    value /= 10;
+  } while (0 != value);
+
+  utest_crash_write(fd, digits + index);
+}
+
+static const int utest_crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGABRT};
+static const char *const utest_crash_signal_names[] = {"SIGSEGV", "SIGBUS",
+                                                       "SIGFPE", "SIGABRT"};
+
+/*
+   what installing the crash handler replaced, to be put back when it is
+   uninstalled, along with the stack the handler runs on.
+*/
+struct utest_crash_handler_s {
+  struct sigaction previous[sizeof(utest_crash_signals) / sizeof(int)];
+  stack_t previous_stack;
+  char stack[UTEST_CRASH_STACK_SIZE];
+};
+#endif
+
+UTEST_WEAK void utest_crash_handler(int signal_number);
+UTEST_WEAK void utest_crash_handler(int signal_number) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  const char *name = "a signal";
+  const char *const test = utest_state.current_test;
+  const struct utest_repeat_s *const repeats = utest_state.repeats;
+  utest_uint64_t passed = 0;
+  utest_uint64_t failed = 0;
+  size_t index;
+#if defined(UTEST_HAS_BACKTRACE)
+  void *frames[64];
+  int depth;
+#endif
+
+  /* a forked child crashing is for its parent to report */
+  if (utest_state.crashed || utest_state.death_child ||
+      (UTEST_NULL != utest_state.snapshot)) {
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+    return;
+  }
+
+  utest_state.crashed = 1;
+
+  for (index = 0; index < sizeof(utest_crash_signals) / sizeof(int); index++) {
+    if (utest_crash_signals[index] == signal_number) {
+      name = utest_crash_signal_names[index];
+    }
+  }
+
+  utest_crash_write(STDOUT_FILENO, "[ CRASHED  ] ");
+  utest_crash_write(STDOUT_FILENO, test ? test : "(outside of a test)");
+  utest_crash_write(STDOUT_FILENO, " (");
+  utest_crash_write(STDOUT_FILENO, name);
+  utest_crash_write(STDOUT_FILENO, ")\n");
+
+#if defined(UTEST_HAS_BACKTRACE)
+  depth = backtrace(frames, UTEST_CAST(int, sizeof(frames) / sizeof(void *)));
+  utest_crash_write(STDOUT_FILENO, " Backtrace :\n");
+  backtrace_symbols_fd(frames, depth, STDOUT_FILENO);
+#endif
+
+  if (UTEST_NULL != repeats) {
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (repeats[index].passes < repeats[index].runs) {
+        failed++;
+      } else if ((0 < repeats[index].runs) && (0 == repeats[index].skips)) {
+        passed++;
+      }
+    }
+
+    utest_crash_write(STDOUT_FILENO, "[  PASSED  ] ");
+    utest_crash_write_u64(STDOUT_FILENO, passed);
+    utest_crash_write(STDOUT_FILENO, " tests before the crash.\n");
+    utest_crash_write(STDOUT_FILENO, "[  FAILED  ] ");
+    utest_crash_write_u64(STDOUT_FILENO, failed + 1);
+    utest_crash_write(STDOUT_FILENO, " tests, listed below:\n");
+
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (repeats[index].passes < repeats[index].runs) {
+        utest_crash_write(STDOUT_FILENO, "[  FAILED  ] ");
+        utest_crash_write(STDOUT_FILENO, utest_state.tests[index].name);
+        utest_crash_write(STDOUT_FILENO, "\n");
+      }
+    }
+
+    utest_crash_write(STDOUT_FILENO, "[  FAILED  ] ");
+    utest_crash_write(STDOUT_FILENO, test ? test : "(outside of a test)");
+    utest_crash_write(STDOUT_FILENO, " (crashed)\n");
+  }
+
+  if (0 <= utest_state.crash_output) {
+    if (UTEST_NULL != test) {
+      utest_crash_write(utest_state.crash_output,
+                        "<failure message=\"crashed with ");
+      utest_crash_write(utest_state.crash_output, name);
+      utest_crash_write(utest_state.crash_output, "\"/></testcase>\n");
+    }
+
+    utest_crash_write(utest_state.crash_output,
+                      "</testsuite>\n</testsuites>\n");
+  }
+
+  signal(signal_number, SIG_DFL);
+  raise(signal_number);
+#else
+  (void)signal_number;
+#endif
+}
+
+/*
+   install the crash handler, on a stack of its own so that it can report a
+   stack overflow too. Returns a handle to give back to
+   utest_crash_handler_uninstall, which puts back the handlers and stack that
+   were there before, or null if the handler isn't supported.
+*/
+UTEST_WEAK void *utest_crash_handler_install(void);
+UTEST_WEAK void *utest_crash_handler_install(void) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct utest_crash_handler_s *const handler = UTEST_PTR_CAST(
+      struct utest_crash_handler_s *, malloc(sizeof(*handler)));
+  struct sigaction action;
+  stack_t stack;
+  size_t index;
+#if defined(UTEST_HAS_BACKTRACE)
+  void *frame;
+
+  /* the first backtrace loads libgcc, which mustn't happen inside a handler */
+  backtrace(&frame, 1);
+#endif
+
+  if (UTEST_NULL == handler) {
+    return UTEST_NULL;
+  }
+
+  stack.ss_sp = handler->stack;
+  stack.ss_size = sizeof(handler->stack);
+  stack.ss_flags = 0;
+
+  if (0 != sigaltstack(&stack, &handler->previous_stack)) {
+    free(handler);
+    return UTEST_NULL;
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = utest_crash_handler;
+  action.sa_flags = SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+
+  for (index = 0; index < sizeof(utest_crash_signals) / sizeof(int); index++) {
+    sigaction(utest_crash_signals[index], &action, &handler->previous[index]);
+  }
+
+  utest_state.crash_output =
+      utest_state.output ? fileno(utest_state.output) : -1;
+
+  return handler;
+#else
+  return UTEST_NULL;
+#endif
+}
+
+UTEST_WEAK void utest_crash_handler_uninstall(void *handle);
+UTEST_WEAK void utest_crash_handler_uninstall(void *handle) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct utest_crash_handler_s *const handler =
+      UTEST_PTR_CAST(struct utest_crash_handler_s *, handle);
+  size_t index;
+
+  if (UTEST_NULL == handler) {
+    return;
+  }
+
+  for (index = 0; index < sizeof(utest_crash_signals) / sizeof(int); index++) {
+    sigaction(utest_crash_signals[index], &handler->previous[index],
+              UTEST_NULL);
+  }
+
+  sigaltstack(&handler->previous_stack, UTEST_NULL);
+  free(handler);
+#else
+  (void)handle;
+#endif
+}
+
+/* run a test in this process, returning how long it took in nanoseconds */
+static UTEST_INLINE utest_int64_t
+utest_run_test(const size_t index, int *const result,
+               utest_uint64_t *const checked) {
+  utest_int64_t ns;
+
+  utest_state.current_test = utest_state.tests[index].name;
+  utest_state.current_result = result;
+  utest_state.snapshots_taken = 0;
+  utest_state.assertions_failed = 0;
+  utest_state.properties_length = 0;
+  if (utest_state.properties) {
+    utest_state.properties[0] = '\0';
+  }
+  utest_threads_collect();
+
+  ns = utest_ns();
+  errno = 0;
+#if defined(UTEST_HAS_EXCEPTIONS)
+  UTEST_SURPRESS_WARNING_BEGIN
+  try {
+    utest_state.tests[index].func(result, utest_state.tests[index].index);
+  } catch (const std::exception &err) {
+    printf(" Exception : %s\n", err.what());
+    *result = UTEST_TEST_FAILURE;
+  } catch (...) {
+    printf(" Exception : Unknown\n");
+    *result = UTEST_TEST_FAILURE;
+  }
+  UTEST_SURPRESS_WARNING_END
+#else
+  utest_state.tests[index].func(result, utest_state.tests[index].index);
+#endif
+  *checked = utest_threads_collect();
+  if ((0 != utest_state.max_failures_per_test) &&
+      (utest_state.assertions_failed > utest_state.max_failures_per_test)) {
+    UTEST_PRINTF("    Failed : %" UTEST_PRIu64 " assertions, only the "
+                 "first %" UTEST_PRIu64 " are shown\n",
+                 utest_state.assertions_failed,
+                 utest_state.max_failures_per_test);
+  }
+  utest_fixture_pool_exit_child(*result, *checked);
+  utest_death_return('r');
+  return utest_ns() - ns;
+}
 
-#define UTEST_I_SETUP(FIXTURE)                                                 \
-  static void utest_i_setup_##FIXTURE(                                         \
-      int *utest_result, struct FIXTURE *utest_fixture, size_t utest_index)
+/*
+   with --processes=<n>, the tests are run in a pool of n worker processes that
+   are forked once, rather than in the runner, so that a test that crashes only
+   takes its worker down with it. Each worker is sent the index of the test to
+   run down a pipe, and sends back its result down another, while its stdout
+   goes down a third for the runner to print with the test's result. A worker
+   is only replaced when it dies, or after --recycle-after=<k> tests.
+*/
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+#include <poll.h>
+#endif
 
-#define UTEST_I_TEARDOWN(FIXTURE)                                              \
-  static void utest_i_teardown_##FIXTURE(                                      \
-      int *utest_result, struct FIXTURE *utest_fixture, size_t utest_index)
+struct utest_pool_worker_s {
+  /* how many tests the worker has run, and the one it is running now */
+  utest_uint64_t tests;
+  size_t index;
+  /* when the worker was sent the test it is running */
+  utest_int64_t started;
+  /* what the worker has printed while running its current test */
+  char *output;
+  size_t output_length;
+  size_t output_capacity;
+  /* the worker's deque of tests, queue[head] to queue[tail - 1] of the pool */
+  size_t head;
+  size_t tail;
+  int pid;
+  /* the write end of the worker's commands, the read ends of the rest */
+  int commands;
+  int results;
+  int stdout_pipe;
+  int busy;
+  /* how the worker exited, once it has been reaped */
+  int status;
+};
 
-#define UTEST_I(FIXTURE, NAME, INDEX)                                          \
-  UTEST_EXTERN struct utest_state_s utest_state;                               \
-  static void utest_run_##FIXTURE##_##NAME##_##INDEX(int *, struct FIXTURE *); \
-  static void utest_i_##FIXTURE##_##NAME##_##INDEX(int *utest_result,          \
-                                                   size_t index) {             \
-    struct FIXTURE fixture;                                                    \
-    memset(&fixture, 0, sizeof(fixture));                                      \
-    utest_i_setup_##FIXTURE(utest_result, &fixture, index);                    \
-    if (UTEST_TEST_PASSED != *utest_result) {                                  \
-      return;                                                                  \
-    }                                                                          \
-    utest_run_##FIXTURE##_##NAME##_##INDEX(utest_result, &fixture);            \
-    utest_i_teardown_##FIXTURE(utest_result, &fixture, index);                 \
-  }                                                                            \
-  UTEST_INITIALIZER(utest_register_##FIXTURE##_##NAME##_##INDEX) {             \
-    size_t i;                                                                  \
-    utest_uint64_t iUp;                                                        \
-    for (i = 0; i < (INDEX); i++) {                                            \
-      const size_t index = utest_state.tests_length++;                         \
-      const char *name_part = #FIXTURE "." #NAME;                              \
-      const size_t name_size = strlen(name_part) + 32;                         \
-      char *name = UTEST_PTR_CAST(char *, malloc(name_size));                  \
-      utest_state.tests = UTEST_PTR_CAST(                                      \
-          struct utest_test_state_s *,                                         \
-          utest_realloc(UTEST_PTR_CAST(void *, utest_state.tests),             \
-                        sizeof(struct utest_test_state_s) *                    \
-                            utest_state.tests_length));                        \
-      if (utest_state.tests) {                                                 \
-        utest_state.tests[index].func = &utest_i_##FIXTURE##_##NAME##_##INDEX; \
-        utest_state.tests[index].index = i;                                    \
-        utest_state.tests[index].name = name;                                  \
-        iUp = UTEST_CAST(utest_uint64_t, i);                                   \
-        UTEST_SNPRINTF(name, name_size, "%s/%" UTEST_PRIu64, name_part, iUp);  \
-      } else if (name) {                                                       \
-        free(name);                                                            \
-      }                                                                        \
-    }                                                                          \
-  }                                                                            \
-  void utest_run_##FIXTURE##_##NAME##_##INDEX(int *utest_result,               \
-                                              struct FIXTURE *utest_fixture)
+struct utest_pool_s {
+  struct utest_pool_worker_s *workers;
+  size_t length;
+  /* replace a worker after it has run this many tests (0 for never) */
+  utest_uint64_t recycle;
+  /* the tests to run, split into a deque for each worker once all are queued */
+  size_t *queue;
+  size_t queued;
+  /* room for the scheduler to work in, twice the length of the queue */
+  size_t *scratch;
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct pollfd *polls;
+  /* how SIGPIPE was handled before the pool started, while workers is set */
+  struct sigaction sigpipe;
+#endif
+};
 
-UTEST_WEAK
-double utest_fabs(double d);
-UTEST_WEAK
-double utest_fabs(double d) {
-  union {
-    double d;
-    utest_uint64_t u;
-  } both;
-  both.d = d;
-  both.u &= 0x7fffffffffffffffu;
-  return both.d;
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+/*
+   the loop a worker runs, until the runner closes its end of the commands
+   pipe. The worker exits with the number of pooled fixtures whose teardown
+   failed.
+*/
+static UTEST_INLINE void utest_pool_serve(const int commands,
+                                          const int results) {
+  size_t index;
+
+  while (0 == utest_read_all(commands, &index, sizeof(index))) {
+    struct utest_child_result_s message;
+    int result = UTEST_TEST_PASSED;
+    utest_uint64_t checked = 0;
+
+    message.ns = UTEST_CAST(utest_uint64_t,
+                            utest_run_test(index, &result, &checked));
+    message.result = UTEST_CAST(utest_uint64_t, result);
+    message.checked = checked;
+    message.assertions_failed = utest_state.assertions_failed;
+    message.properties_length = utest_state.properties_length;
+
+    /* what the test printed has to reach the runner before its result */
+    fflush(stdout);
+
+    if (utest_write_all(results, &message, sizeof(message)) ||
+        utest_write_all(results, utest_state.properties,
+                        utest_state.properties_length)) {
+      break;
+    }
+  }
+
+  index = UTEST_CAST(size_t, utest_fixture_pools_teardown("", ""));
+  fflush(stdout);
+  _exit(255 < index ? 255 : UTEST_CAST(int, index));
 }
+#endif
 
-UTEST_WEAK
-int utest_isnan(double d);
-UTEST_WEAK
-int utest_isnan(double d) {
-  union {
-    double d;
-    utest_uint64_t u;
-  } both;
-  both.d = d;
-  both.u &= 0x7fffffffffffffffu;
-  return both.u > 0x7ff0000000000000u;
+/* fork a worker into the pool, returning non-zero if it couldn't be */
+UTEST_WEAK int utest_pool_spawn(struct utest_pool_s *pool,
+                                struct utest_pool_worker_s *worker);
+UTEST_WEAK int utest_pool_spawn(struct utest_pool_s *pool,
+                                struct utest_pool_worker_s *worker) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  int commands[2];
+  int results[2];
+  int output[2];
+  size_t index;
+  pid_t pid;
+
+  if (0 != pipe(commands)) {
+    return 1;
+  }
+
+  if (0 != pipe(results)) {
+    close(commands[0]);
+    close(commands[1]);
+    return 1;
+  }
+
+  if (0 != pipe(output)) {
+    close(commands[0]);
+    close(commands[1]);
+    close(results[0]);
+    close(results[1]);
+    return 1;
+  }
+
+  /* flush before forking so the child doesn't inherit buffered output */
+  fflush(stdout);
+  if (utest_state.output) {
+    fflush(utest_state.output);
+  }
+
+  pid = fork();
+
+  if (0 == pid) {
+    /* the other workers' pipes would keep them from seeing the runner close */
+    for (index = 0; index < pool->length; index++) {
+      if (0 < pool->workers[index].pid) {
+        close(pool->workers[index].commands);
+        close(pool->workers[index].results);
+        close(pool->workers[index].stdout_pipe);
+      }
+    }
+
+    close(commands[1]);
+    close(results[0]);
+    close(output[0]);
+    dup2(output[1], STDOUT_FILENO);
+    close(output[1]);
+    sigaction(SIGPIPE, &pool->sigpipe, UTEST_NULL);
+
+    /* the runner writes the XML output, but properties are only recorded
+       when there is some */
+    if (utest_state.output) {
+      utest_state.output = fopen("/dev/null", "w");
+    }
+
+    /* a worker that crashes is reported by the runner */
+    utest_state.repeats = UTEST_NULL;
+    utest_state.crash_output = -1;
+
+    utest_pool_serve(commands[0], results[1]);
+  }
+
+  close(commands[0]);
+  close(results[1]);
+  close(output[1]);
+
+  if (0 > pid) {
+    close(commands[1]);
+    close(results[0]);
+    close(output[0]);
+    return 1;
+  }
+
+  worker->tests = 0;
+  worker->output_length = 0;
+  worker->pid = UTEST_CAST(int, pid);
+  worker->commands = commands[1];
+  worker->results = results[0];
+  worker->stdout_pipe = output[0];
+  worker->busy = 0;
+  worker->status = 0;
+  return 0;
+#else
+  (void)pool;
+  (void)worker;
+  return 1;
+#endif
 }
 
-UTEST_WEAK
-int utest_should_filter_test(const char *filter, const char *testcase);
-UTEST_WEAK int utest_should_filter_test(const char *filter,
-                                        const char *testcase) {
-  if (filter) {
-    const char *filter_cur = filter;
-    const char *testcase_cur = testcase;
-    const char *filter_wildcard = UTEST_NULL;
+/*
+   append what a worker has printed to its output, returning non-zero once its
+   stdout is closed. When wait is zero only what has already arrived is read.
+*/
+UTEST_WEAK int utest_pool_read_output(struct utest_pool_worker_s *worker,
+                                      const int wait);
+UTEST_WEAK int utest_pool_read_output(struct utest_pool_worker_s *worker,
+                                      const int wait) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct pollfd ready;
+  ssize_t got;
 
-    while (('\0' != *filter_cur) && ('\0' != *testcase_cur)) {
-      if ('*' == *filter_cur) {
-        /* store the position of the wildcard */
-        filter_wildcard = filter_cur;
+  ready.fd = worker->stdout_pipe;
+  ready.events = POLLIN;
 
-        /* skip the wildcard character */
-        filter_cur++;
+  for (;;) {
+    ready.revents = 0;
 
-        while (('\0' != *filter_cur) && ('\0' != *testcase_cur)) {
-          if ('*' == *filter_cur) {
-            /*
-               we found another wildcard (filter is something like *foo*) so we
-               exit the current loop, and return to the parent loop to handle
-               the wildcard case
-            */
-            break;
-          } else if (*filter_cur != *testcase_cur) {
-            /* otherwise our filter didn't match, so reset it */
-            filter_cur = filter_wildcard;
-          }
+    if (!wait && (1 > poll(&ready, 1, 0))) {
+      return 0;
+    }
+
+    if (worker->output_capacity < worker->output_length + 4096) {
+      const size_t capacity = 2 * worker->output_capacity + 4096;
+      char *const output =
+          UTEST_PTR_CAST(char *, realloc(worker->output, capacity));
+
+      if (UTEST_NULL == output) {
+        return 1;
+      }
+
+      worker->output = output;
+      worker->output_capacity = capacity;
+    }
+
+    got = read(worker->stdout_pipe, worker->output + worker->output_length,
+               worker->output_capacity - worker->output_length - 1);
+
+    if ((0 > got) && (EINTR == errno)) {
+      continue;
+    } else if (0 >= got) {
+      return 1;
+    }
+
+    worker->output_length += UTEST_CAST(size_t, got);
+    worker->output[worker->output_length] = '\0';
+
+    if (wait) {
+      return 0;
+    }
+  }
+#else
+  (void)worker;
+  (void)wait;
+  return 1;
+#endif
+}
+
+/*
+   stop a worker, killing it first if it is still running a test, and reap it.
+   Returns how many of its pooled fixture teardowns failed.
+*/
+UTEST_WEAK utest_uint64_t utest_pool_stop(struct utest_pool_worker_s *worker);
+UTEST_WEAK utest_uint64_t utest_pool_stop(struct utest_pool_worker_s *worker) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  int status = 0;
+
+  if (0 >= worker->pid) {
+    return 0;
+  }
+
+  if (worker->busy) {
+    kill(UTEST_CAST(pid_t, worker->pid), SIGKILL);
+  }
+
+  close(worker->commands);
+
+  /* let the worker finish printing (EG. its fixture teardowns) as it exits */
+  while (0 == utest_pool_read_output(worker, 1)) {
+  }
+
+  close(worker->results);
+  close(worker->stdout_pipe);
+
+  while ((0 > waitpid(UTEST_CAST(pid_t, worker->pid), &status, 0)) &&
+         (EINTR == errno)) {
+  }
+
+  worker->pid = 0;
+  worker->status = status;
+
+  if (!worker->busy && (0 < worker->output_length)) {
+    printf("%s", worker->output);
+  }
+
+  worker->output_length = 0;
+
+  return (!worker->busy && WIFEXITED(status))
+             ? UTEST_CAST(utest_uint64_t, WEXITSTATUS(status))
+             : 0;
+#else
+  (void)worker;
+  return 0;
+#endif
+}
+
+/*
+   split the queued tests into a deque for each worker. The tests of a set (EG.
+   all the tests of a fixture) go to the same worker, in the order they were
+   queued, so that they run one after another and reuse the pooled fixtures and
+   warm caches the worker is left with. Each set goes to whichever worker has
+   the fewest tests so far, and the stealing in utest_pool_next evens out what
+   that misses.
+*/
+UTEST_WEAK void utest_pool_schedule(struct utest_pool_s *pool);
+UTEST_WEAK void utest_pool_schedule(struct utest_pool_s *pool) {
+  size_t *const owners = pool->scratch;
+  size_t *const deques = pool->scratch + pool->queued;
+  size_t buckets = 1;
+  size_t *table;
+  size_t index;
+  size_t start;
+
+  while (buckets < 2 * pool->queued) {
+    buckets *= 2;
+  }
+
+  /* each bucket holds the queue position of a set's first test plus one */
+  table = UTEST_PTR_CAST(size_t *, calloc(buckets, sizeof(size_t)));
+
+  for (index = 0; index < pool->length; index++) {
+    pool->workers[index].head = 0;
+    pool->workers[index].tail = 0;
+  }
+
+  for (index = 0; index < pool->queued; index++) {
+    const char *const name = utest_state.tests[pool->queue[index]].name;
+    const char *const dot = strchr(name, '.');
+    const size_t length =
+        UTEST_NULL != dot ? UTEST_CAST(size_t, dot - name) : strlen(name);
+    size_t bucket = UTEST_CAST(
+        size_t,
+        utest_fnv1a(UTEST_PTR_CAST(const unsigned char *, name), length));
+    size_t owner = pool->length;
+    size_t worker;
+
+    /* without the table (out of memory) every test is its own set */
+    for (bucket &= buckets - 1; (UTEST_NULL != table) && (0 != table[bucket]);
+         bucket = (bucket + 1) & (buckets - 1)) {
+      const char *const first =
+          utest_state.tests[pool->queue[table[bucket] - 1]].name;
+
+      if ((0 == UTEST_STRNCMP(first, name, length)) &&
+          (('.' == first[length]) || ('\0' == first[length]))) {
+        owner = owners[table[bucket] - 1];
+        break;
+      }
+    }
+
+    if (pool->length == owner) {
+      for (owner = 0, worker = 1; worker < pool->length; worker++) {
+        if (pool->workers[worker].tail < pool->workers[owner].tail) {
+          owner = worker;
+        }
+      }
+
+      if (UTEST_NULL != table) {
+        table[bucket] = index + 1;
+      }
+    }
+
+    owners[index] = owner;
+    pool->workers[owner].tail++;
+  }
+
+  free(table);
+
+  /* lay the deques out one after another, each in the order it was queued */
+  for (index = 0, start = 0; index < pool->length; index++) {
+    const size_t count = pool->workers[index].tail;
+
+    pool->workers[index].head = start;
+    pool->workers[index].tail = start;
+    start += count;
+  }
+
+  for (index = 0; index < pool->queued; index++) {
+    deques[pool->workers[owners[index]].tail++] = pool->queue[index];
+  }
+
+  memcpy(pool->queue, deques, sizeof(size_t) * pool->queued);
+}
+
+/*
+   take the next test for a worker from the head of its own deque, or if that
+   is empty steal one from the tail of the longest deque. Returns non-zero once
+   there are no tests left to take.
+*/
+UTEST_WEAK int utest_pool_next(struct utest_pool_s *pool,
+                               struct utest_pool_worker_s *worker,
+                               size_t *index);
+UTEST_WEAK int utest_pool_next(struct utest_pool_s *pool,
+                               struct utest_pool_worker_s *worker,
+                               size_t *index) {
+  struct utest_pool_worker_s *victim = worker;
+  size_t other;
+
+  if (worker->head < worker->tail) {
+    *index = pool->queue[worker->head++];
+    return 0;
+  }
+
+  for (other = 0; other < pool->length; other++) {
+    struct utest_pool_worker_s *const candidate = &pool->workers[other];
+
+    if (candidate->tail - candidate->head > victim->tail - victim->head) {
+      victim = candidate;
+    }
+  }
+
+  if (victim->head == victim->tail) {
+    return 1;
+  }
+
+  *index = pool->queue[--victim->tail];
+  return 0;
+}
+
+/*
+   find a live worker that isn't running a test, or return null if they all are
+   (or are dead, having not been replaced).
+*/
+static UTEST_INLINE struct utest_pool_worker_s *
+utest_pool_idle(struct utest_pool_s *pool) {
+  size_t index;
+
+  for (index = 0; index < pool->length; index++) {
+    if ((0 < pool->workers[index].pid) && !pool->workers[index].busy) {
+      return &pool->workers[index];
+    }
+  }
+
+  return UTEST_NULL;
+}
+
+/* how many of the workers of a pool are live */
+static UTEST_INLINE size_t utest_pool_live(struct utest_pool_s *pool) {
+  size_t live = 0;
+  size_t index;
+
+  for (index = 0; index < pool->length; index++) {
+    live += (0 < pool->workers[index].pid) ? 1 : 0;
+  }
+
+  return live;
+}
+
+/* send a test to an idle worker, returning non-zero if it couldn't be */
+UTEST_WEAK int utest_pool_dispatch(struct utest_pool_worker_s *worker,
+                                   const size_t index);
+UTEST_WEAK int utest_pool_dispatch(struct utest_pool_worker_s *worker,
+                                   const size_t index) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  worker->index = index;
+  worker->busy = 1;
+  worker->output_length = 0;
+  worker->started = utest_ns();
+  return utest_write_all(worker->commands, &index, sizeof(index));
+#else
+  (void)worker;
+  (void)index;
+  return 1;
+#endif
+}
+
+/*
+   wait for one of the busy workers to finish its test, and return it (or null
+   if none of them are busy).
+*/
+UTEST_WEAK struct utest_pool_worker_s *
+utest_pool_wait(struct utest_pool_s *pool);
+UTEST_WEAK struct utest_pool_worker_s *
+utest_pool_wait(struct utest_pool_s *pool) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  for (;;) {
+    nfds_t polls = 0;
+    size_t index;
+
+    for (index = 0; index < pool->length; index++) {
+      if ((0 < pool->workers[index].pid) && pool->workers[index].busy) {
+        pool->polls[polls].fd = pool->workers[index].results;
+        pool->polls[polls].events = POLLIN;
+        pool->polls[polls].revents = 0;
+        polls++;
+        pool->polls[polls].fd = pool->workers[index].stdout_pipe;
+        pool->polls[polls].events = POLLIN;
+        pool->polls[polls].revents = 0;
+        polls++;
+      }
+    }
+
+    if (0 == polls) {
+      return UTEST_NULL;
+    }
+
+    if (0 > poll(pool->polls, polls, -1)) {
+      if (EINTR == errno) {
+        continue;
+      }
+
+      return UTEST_NULL;
+    }
+
+    polls = 0;
 
-          /* move testcase along */
-          testcase_cur++;
+    for (index = 0; index < pool->length; index++) {
+      struct utest_pool_worker_s *const worker = &pool->workers[index];
 
-          /* move filter along */
-          filter_cur++;
-        }
+      if ((0 >= worker->pid) || !worker->busy) {
+        continue;
+      }
 
-        if (('\0' == *filter_cur) && ('\0' == *testcase_cur)) {
-          return 0;
-        }
+      /* keep the worker's stdout drained, or it stalls once the pipe fills */
+      if (0 != pool->polls[polls + 1].revents) {
+        utest_pool_read_output(worker, 0);
+      }
 
-        /* if the testcase has been exhausted, we don't have a match! */
-        if ('\0' == *testcase_cur) {
-          return 1;
-        }
-      } else {
-        if (*testcase_cur != *filter_cur) {
-          /* test case doesn't match filter */
-          return 1;
-        } else {
-          /* move our filter and testcase forward */
-          testcase_cur++;
-          filter_cur++;
-        }
+      if (0 != pool->polls[polls].revents) {
+        /* the worker flushed stdout before sending its result */
+        utest_pool_read_output(worker, 0);
+        return worker;
       }
+
+      polls += 2;
     }
+  }
+#else
+  (void)pool;
+  return UTEST_NULL;
+#endif
+}
 
-    if (('\0' != *filter_cur) ||
-        (('\0' != *testcase_cur) &&
-         ((filter == filter_cur) || ('*' != filter_cur[-1])))) {
-      /* we have a mismatch! */
-      return 1;
+/*
+   fork a worker to replace one that was stopped. If it couldn't be, the slot is
+   left dead (its pid -1), and the live workers take over its tests.
+*/
+static UTEST_INLINE void
+utest_pool_replace(struct utest_pool_s *pool,
+                   struct utest_pool_worker_s *worker) {
+  if (0 != utest_pool_spawn(pool, worker)) {
+    UTEST_PRINTF("    Worker : could not fork a replacement\n");
+    worker->busy = 0;
+    worker->pid = -1;
+  }
+}
+
+/*
+   take the result of the test a worker finished. If the worker died instead,
+   it is reaped, the test failed, and the worker is replaced. The worker is
+   also replaced once it has run as many tests as the pool recycles them at.
+*/
+UTEST_WEAK utest_int64_t utest_pool_finish(struct utest_pool_s *pool,
+                                           struct utest_pool_worker_s *worker,
+                                           int *const result,
+                                           utest_uint64_t *const checked,
+                                           utest_uint64_t *const teardowns);
+UTEST_WEAK utest_int64_t utest_pool_finish(struct utest_pool_s *pool,
+                                           struct utest_pool_worker_s *worker,
+                                           int *const result,
+                                           utest_uint64_t *const checked,
+                                           utest_uint64_t *const teardowns) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct utest_child_result_s message;
+  utest_int64_t ns;
+  size_t size;
+  int replace;
+
+  utest_state.properties_length = 0;
+  if (utest_state.properties) {
+    utest_state.properties[0] = '\0';
+  }
+
+  if (0 != utest_read_all(worker->results, &message, sizeof(message))) {
+    /* the worker died, so the test took as long as it took to find that out */
+    ns = utest_ns() - worker->started;
+
+    /* let whatever the worker printed before it died be shown */
+    while (0 == utest_pool_read_output(worker, 1)) {
+    }
+
+    if (0 < worker->output_length) {
+      UTEST_PRINTF("%s", worker->output);
+    }
+
+    utest_pool_stop(worker);
+
+    if (WIFSIGNALED(worker->status)) {
+      UTEST_PRINTF("    Worker : test process killed by signal %d\n",
+                   WTERMSIG(worker->status));
+    } else {
+      UTEST_PRINTF("    Worker : test process exited with code %d\n",
+                   WEXITSTATUS(worker->status));
     }
+
+    *result = UTEST_TEST_FAILURE;
+    *checked = 0;
+    utest_state.assertions_failed = 0;
+    utest_pool_replace(pool, worker);
+    return ns;
+  }
+
+  if (0 < worker->output_length) {
+    UTEST_PRINTF("%s", worker->output);
+  }
+
+  *result = UTEST_CAST(int, message.result);
+  *checked = message.checked;
+  utest_state.assertions_failed = message.assertions_failed;
+  size = UTEST_CAST(size_t, message.properties_length);
+
+  worker->output_length = 0;
+  worker->busy = 0;
+  worker->tests++;
+  replace = (0 != pool->recycle) && (worker->tests >= pool->recycle);
+
+  if ((0 < size) && (0 != utest_read_properties(worker->results, size))) {
+    /* the properties couldn't be taken, so the worker is out of step */
+    replace = 1;
+  }
+
+  if (replace) {
+    *teardowns += utest_pool_stop(worker);
+    utest_pool_replace(pool, worker);
   }
 
+  return UTEST_CAST(utest_int64_t, message.ns);
+#else
+  (void)pool;
+  (void)worker;
+  (void)teardowns;
+  *result = UTEST_TEST_FAILURE;
+  *checked = 0;
   return 0;
+#endif
 }
 
-static UTEST_INLINE FILE *utest_fopen(const char *filename, const char *mode) {
-#ifdef _MSC_VER
-  FILE *file;
-  if (0 == fopen_s(&file, filename, mode)) {
-    return file;
-  } else {
-    return UTEST_NULL;
+/*
+   fork the workers of a pool, returning non-zero if there aren't any (EG. on a
+   platform without fork).
+*/
+UTEST_WEAK int utest_pool_start(struct utest_pool_s *pool, const size_t length,
+                                const utest_uint64_t recycle);
+UTEST_WEAK int utest_pool_start(struct utest_pool_s *pool, const size_t length,
+                                const utest_uint64_t recycle) {
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  struct sigaction ignore;
+  size_t index;
+
+  pool->length = 0;
+  pool->recycle = recycle;
+  pool->workers = UTEST_PTR_CAST(
+      struct utest_pool_worker_s *,
+      calloc(length, sizeof(struct utest_pool_worker_s)));
+
+  if (UTEST_NULL == pool->workers) {
+    return 1;
+  }
+
+  /* a worker dying while it is sent a test mustn't kill the runner */
+  memset(&ignore, 0, sizeof(ignore));
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset(&ignore.sa_mask);
+  sigaction(SIGPIPE, &ignore, &pool->sigpipe);
+
+  pool->polls = UTEST_PTR_CAST(struct pollfd *,
+                               calloc(2 * length, sizeof(struct pollfd)));
+  pool->queue = UTEST_PTR_CAST(
+      size_t *, malloc(sizeof(size_t) * (utest_state.tests_length + 1)));
+  pool->scratch = UTEST_PTR_CAST(
+      size_t *, malloc(2 * sizeof(size_t) * (utest_state.tests_length + 1)));
+
+  if ((UTEST_NULL == pool->polls) || (UTEST_NULL == pool->queue) ||
+      (UTEST_NULL == pool->scratch)) {
+    return 1;
+  }
+
+  for (index = 0; index < length; index++) {
+    if (0 != utest_pool_spawn(pool, &pool->workers[index])) {
+      break;
+    }
+
+    pool->length++;
   }
+
+  return 0 == pool->length;
 #else
-  return fopen(filename, mode);
+  (void)pool;
+  (void)length;
+  (void)recycle;
+  return 1;
+#endif
+}
+
+/*
+   stop every worker of a pool (killing any that are still running a test),
+   returning how many of their pooled fixture teardowns failed.
+*/
+UTEST_WEAK utest_uint64_t utest_pool_shutdown(struct utest_pool_s *pool);
+UTEST_WEAK utest_uint64_t utest_pool_shutdown(struct utest_pool_s *pool) {
+  utest_uint64_t teardowns = 0;
+#if defined(UTEST_HAS_POSIX_SIGNALS)
+  size_t index;
+
+  for (index = 0; index < pool->length; index++) {
+    teardowns += utest_pool_stop(&pool->workers[index]);
+    free(pool->workers[index].output);
+  }
+
+  if (UTEST_NULL != pool->workers) {
+    sigaction(SIGPIPE, &pool->sigpipe, UTEST_NULL);
+  }
+
+  free(pool->polls);
+  pool->polls = UTEST_NULL;
 #endif
+  free(pool->workers);
+  free(pool->queue);
+  free(pool->scratch);
+  pool->workers = UTEST_NULL;
+  pool->queue = UTEST_NULL;
+  pool->scratch = UTEST_NULL;
+  pool->length = 0;
+  return teardowns;
 }
 
 static UTEST_INLINE int utest_main(int argc, const char *const argv[]);
 int utest_main(int argc, const char *const argv[]) {
   utest_uint64_t failed = 0;
   utest_uint64_t skipped = 0;
+  utest_uint64_t failed_teardowns = 0;
   size_t index = 0;
-  size_t *failed_testcases = UTEST_NULL;
-  size_t failed_testcases_length = 0;
-  size_t *skipped_testcases = UTEST_NULL;
-  size_t skipped_testcases_length = 0;
   const char *filter = UTEST_NULL;
   utest_uint64_t ran_tests = 0;
+  utest_uint64_t assertions_checked = 0;
+  utest_uint64_t assertions_failed = 0;
   int enable_mixed_units = 0;
   int random_order = 0;
   utest_uint32_t seed = 0;
+  struct utest_environment_s environment;
+  size_t *order = UTEST_NULL;
+  struct utest_repeat_s *repeats = UTEST_NULL;
+  const char *failed_file = UTEST_NULL;
+  char *default_failed_file = UTEST_NULL;
+  char *last_failed = UTEST_NULL;
+  const char *rerun = UTEST_NULL;
+  int rerun_failed = 0;
+  int failed_first = 0;
+  const char *cache_file = UTEST_NULL;
+  char *cache = UTEST_NULL;
+  unsigned char *cached = UTEST_NULL;
+  utest_uint64_t cached_tests = 0;
+  char cache_header[48];
+  size_t position = 0;
+  size_t repeat = 0;
+  size_t repetition = 0;
+  int until_fail = 0;
+  utest_uint64_t max_failures = 0;
+  utest_uint64_t not_run = 0;
+  int crash_handler = 0;
+  void *crash_handle = UTEST_NULL;
+  struct utest_pool_s pool;
+  size_t processes = 0;
+  utest_uint64_t recycle_after = 0;
+  int scheduled = 0;
 
   enum colours { RESET, GREEN, RED, YELLOW };
 
@@ -1341,6 +7801,12 @@ int utest_main(int argc, const char *const argv[]) {
       colours[index] = "";
     }
   }
+
+  /* the thread running the tests prints failures directly, not buffered */
+  utest_thread_context();
+  utest_state.pin_cpu = -1;
+  memset(&pool, 0, sizeof(pool));
+
   /* loop through all arguments looking for our options */
   for (index = 1; index < UTEST_CAST(size_t, argc); index++) {
     /* Informational switches */
@@ -1352,6 +7818,30 @@ int utest_main(int argc, const char *const argv[]) {
     const char enable_mixed_units_str[] = "--enable-mixed-units";
     const char random_order_str[] = "--random-order";
     const char random_order_with_seed_str[] = "--random-order=";
+    const char property_seed_str[] = "--property-seed=";
+    const char property_runs_str[] = "--property-runs=";
+    const char property_time_str[] = "--property-time=";
+    const char fuzz_corpus_str[] = "--fuzz-corpus=";
+    const char update_snapshots_str[] = "--update-snapshots";
+    const char snapshot_dir_str[] = "--snapshot-dir=";
+    const char max_failures_per_test_str[] = "--max-failures-per-test=";
+    const char stress_threads_str[] = "--stress-threads=";
+    const char pin_threads_str[] = "--pin-threads";
+    const char scaling_str[] = "--scaling=";
+    const char pin_cpu_str[] = "--pin-cpu=";
+    const char isolate_noise_str[] = "--isolate-noise";
+    const char repeat_str[] = "--repeat=";
+    const char until_fail_str[] = "--until-fail";
+    const char fail_fast_str[] = "--fail-fast";
+    const char max_failures_str[] = "--max-failures=";
+    const char crash_handler_str[] = "--crash-handler";
+    const char processes_str[] = "--processes=";
+    const char recycle_after_str[] = "--recycle-after=";
+    const char rerun_failed_str[] = "--rerun-failed";
+    const char failed_first_str[] = "--failed-first";
+    const char failed_file_str[] = "--failed-file=";
+    const char cache_str[] = "--cache";
+    const char cache_with_file_str[] = "--cache=";
 
     if (0 == UTEST_STRNCMP(argv[index], help_str, strlen(help_str))) {
       printf("utest.h - the single file unit testing solution for C/C++!\n"
@@ -1367,7 +7857,53 @@ int utest_main(int argc, const char *const argv[]) {
              "mixed units (s/ms/us/ns).\n"
              "  --random-order[=<seed>] Randomize the order that the tests are "
              "ran in. If the optional <seed> argument is not provided, then a "
-             "random starting seed is used.\n");
+             "random starting seed is used.\n"
+             "  --repeat=<n>            Run the tests <n> times (reshuffled "
+             "each time with --random-order), and report each test's pass "
+             "rate and timing.\n"
+             "  --until-fail            Run the tests over and over, until one "
+             "of them fails.\n"
+             "  --fail-fast             Stop running tests after the first "
+             "one fails.\n"
+             "  --max-failures=<n>      Stop running tests after <n> of them "
+             "fail.\n"
+             "  --crash-handler         Report the test that crashed, with a "
+             "backtrace and the results so far, and close the XML output.\n");
+      printf("  --processes=<n>         Run the tests in a pool of <n> worker "
+             "processes, so that a crash only takes down its worker.\n"
+             "  --recycle-after=<k>     Replace each worker process after it "
+             "has run <k> tests.\n");
+      printf("  --rerun-failed          Only run the tests that failed the "
+             "last time they ran.\n"
+             "  --failed-first          Run the tests that failed the last "
+             "time they ran before the others.\n"
+             "  --failed-file=<file>    Keep the list of failed tests in "
+             "<file> (default '" UTEST_LAST_FAILED "-<binary>').\n");
+      printf("  --cache[=<file>]        Don't rerun the tests that passed in "
+             "an earlier run of the same test binary, remembering them in "
+             "<file> (default '" UTEST_CACHE "').\n");
+      printf("  --property-seed=<seed>  Seed the inputs of property tests "
+             "with <seed>, EG. to replay a failure.\n"
+             "  --property-runs=<runs>  Run each property test <runs> times.\n"
+             "  --property-time=<ms>    Stop generating new inputs for a "
+             "property test after <ms> milliseconds.\n"
+             "  --fuzz-corpus=<dir>     Run each fuzz test over the seed files "
+             "in <dir>/<test name>/ (default '" UTEST_FUZZ_CORPUS "').\n");
+      printf("  --update-snapshots      Rewrite the golden files of snapshot "
+             "checks that don't match, rather than failing them.\n"
+             "  --snapshot-dir=<dir>    Keep golden files in <dir> (default '"
+             UTEST_SNAPSHOT_DIR "').\n");
+      printf("  --max-failures-per-test=<n> Only print the first <n> failed "
+             "assertions of each test.\n"
+             "  --stress-threads=<n>    Run every stress test on <n> threads.\n"
+             "  --pin-threads           Pin the threads of stress tests to "
+             "CPUs, one thread per CPU.\n"
+             "  --scaling=<n>,<n>,...   Rerun every stress test on each of the "
+             "thread counts, and report how its throughput scales.\n");
+      printf("  --pin-cpu=<n>           Run the tests pinned to CPU <n>.\n"
+             "  --isolate-noise         Raise the scheduling priority of the "
+             "tests, warn about CPU frequency scaling, and warm up stress "
+             "tests before they are measured.\n");
       goto cleanup;
     } else if (0 ==
                UTEST_STRNCMP(argv[index], filter_str, strlen(filter_str))) {
@@ -1392,6 +7928,134 @@ int utest_main(int argc, const char *const argv[]) {
                      strtoul(argv[index] + strlen(random_order_with_seed_str),
                              UTEST_NULL, 10));
       random_order = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], property_seed_str,
+                                  strlen(property_seed_str))) {
+      utest_state.property_seed = UTEST_CAST(
+          utest_uint64_t,
+          strtoul(argv[index] + strlen(property_seed_str), UTEST_NULL, 10));
+      utest_state.property_seeded = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], property_runs_str,
+                                  strlen(property_runs_str))) {
+      utest_state.property_runs = UTEST_CAST(
+          size_t,
+          strtoul(argv[index] + strlen(property_runs_str), UTEST_NULL, 10));
+    } else if (0 == UTEST_STRNCMP(argv[index], property_time_str,
+                                  strlen(property_time_str))) {
+      utest_state.property_time_ns =
+          UTEST_CAST(utest_int64_t,
+                     strtoul(argv[index] + strlen(property_time_str),
+                             UTEST_NULL, 10)) *
+          1000000;
+    } else if (0 == UTEST_STRNCMP(argv[index], fuzz_corpus_str,
+                                  strlen(fuzz_corpus_str))) {
+      utest_state.fuzz_corpus = argv[index] + strlen(fuzz_corpus_str);
+    } else if (0 == UTEST_STRNCMP(argv[index], update_snapshots_str,
+                                  strlen(update_snapshots_str))) {
+      utest_state.update_snapshots = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], snapshot_dir_str,
+                                  strlen(snapshot_dir_str))) {
+      utest_state.snapshot_dir = argv[index] + strlen(snapshot_dir_str);
+    } else if (0 == UTEST_STRNCMP(argv[index], max_failures_per_test_str,
+                                  strlen(max_failures_per_test_str))) {
+      utest_state.max_failures_per_test = UTEST_CAST(
+          utest_uint64_t,
+          strtoul(argv[index] + strlen(max_failures_per_test_str), UTEST_NULL,
+                  10));
+    } else if (0 == UTEST_STRNCMP(argv[index], stress_threads_str,
+                                  strlen(stress_threads_str))) {
+      utest_state.stress_threads = UTEST_CAST(
+          int, strtol(argv[index] + strlen(stress_threads_str), UTEST_NULL,
+                      10));
+    } else if (0 == UTEST_STRNCMP(argv[index], pin_threads_str,
+                                  strlen(pin_threads_str))) {
+      utest_state.pin_threads = 1;
+    } else if (0 ==
+               UTEST_STRNCMP(argv[index], pin_cpu_str, strlen(pin_cpu_str))) {
+      const char *const number = argv[index] + strlen(pin_cpu_str);
+      char *end;
+      const long cpu = strtol(number, &end, 10);
+
+      if ((end == number) || ('\0' != *end) || (0 > cpu) || (INT_MAX < cpu)) {
+        fprintf(stderr, "utest.h: invalid CPU in '%s'\n", argv[index]);
+        failed = 1;
+        goto cleanup;
+      }
+
+      utest_state.pin_cpu = UTEST_CAST(int, cpu);
+    } else if (0 == UTEST_STRNCMP(argv[index], isolate_noise_str,
+                                  strlen(isolate_noise_str))) {
+      utest_state.isolate_noise = 1;
+    } else if (0 ==
+               UTEST_STRNCMP(argv[index], repeat_str, strlen(repeat_str))) {
+      repeat = UTEST_CAST(
+          size_t, strtoul(argv[index] + strlen(repeat_str), UTEST_NULL, 10));
+    } else if (0 == UTEST_STRNCMP(argv[index], until_fail_str,
+                                  strlen(until_fail_str))) {
+      until_fail = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], fail_fast_str,
+                                  strlen(fail_fast_str))) {
+      max_failures = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], max_failures_str,
+                                  strlen(max_failures_str))) {
+      max_failures = UTEST_CAST(
+          utest_uint64_t,
+          strtoul(argv[index] + strlen(max_failures_str), UTEST_NULL, 10));
+    } else if (0 == UTEST_STRNCMP(argv[index], crash_handler_str,
+                                  strlen(crash_handler_str))) {
+      crash_handler = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], processes_str,
+                                  strlen(processes_str))) {
+      processes = UTEST_CAST(
+          size_t, strtoul(argv[index] + strlen(processes_str), UTEST_NULL, 10));
+    } else if (0 == UTEST_STRNCMP(argv[index], recycle_after_str,
+                                  strlen(recycle_after_str))) {
+      recycle_after = UTEST_CAST(
+          utest_uint64_t,
+          strtoul(argv[index] + strlen(recycle_after_str), UTEST_NULL, 10));
+    } else if (0 == UTEST_STRNCMP(argv[index], rerun_failed_str,
+                                  strlen(rerun_failed_str))) {
+      rerun_failed = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], failed_first_str,
+                                  strlen(failed_first_str))) {
+      failed_first = 1;
+    } else if (0 == UTEST_STRNCMP(argv[index], failed_file_str,
+                                  strlen(failed_file_str))) {
+      failed_file = argv[index] + strlen(failed_file_str);
+    } else if (0 == UTEST_STRNCMP(argv[index], cache_with_file_str,
+                                  strlen(cache_with_file_str))) {
+      cache_file = argv[index] + strlen(cache_with_file_str);
+    } else if (0 == UTEST_STRNCMP(argv[index], cache_str, strlen(cache_str))) {
+      cache_file = UTEST_CACHE;
+    } else if (0 ==
+               UTEST_STRNCMP(argv[index], scaling_str, strlen(scaling_str))) {
+      const char *count = argv[index] + strlen(scaling_str);
+
+      while ('\0' != *count) {
+        char *end;
+        const long threads = strtol(count, &end, 10);
+
+        if ((end == count) || (0 >= threads)) {
+          fprintf(stderr, "utest.h: invalid thread count in '%s'\n",
+                  argv[index]);
+          failed = 1;
+          goto cleanup;
+        }
+
+        utest_state.scaling = UTEST_PTR_CAST(
+            size_t *, utest_realloc(UTEST_PTR_CAST(void *, utest_state.scaling),
+                                    sizeof(size_t) *
+                                        (utest_state.scaling_length + 1)));
+
+        if (UTEST_NULL == utest_state.scaling) {
+          utest_state.scaling_length = 0;
+          failed = 1;
+          goto cleanup;
+        }
+
+        utest_state.scaling[utest_state.scaling_length++] =
+            UTEST_CAST(size_t, threads);
+        count = (',' == *end) ? end + 1 : end;
+      }
     } else if (0 == UTEST_STRNCMP(argv[index], random_order_str,
                                   strlen(random_order_str))) {
       const utest_int64_t ns = utest_ns();
@@ -1411,30 +8075,163 @@ int utest_main(int argc, const char *const argv[]) {
     // tests.
     for (index = utest_state.tests_length; index > 1; index--) {
       // For the random order we'll use PCG.
-      const utest_uint32_t state = seed;
-      const utest_uint32_t word =
-          ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
       const utest_uint32_t next =
-          ((word >> 22u) ^ word) % UTEST_CAST(utest_uint32_t, index);
+          utest_random(&seed) % UTEST_CAST(utest_uint32_t, index);
 
       // Swap the randomly chosen element into the last location.
       const struct utest_test_state_s copy = utest_state.tests[index - 1];
       utest_state.tests[index - 1] = utest_state.tests[next];
       utest_state.tests[next] = copy;
+    }
+  }
+
+  /* the failed tests are only remembered when asked for */
+  if ((UTEST_NULL == failed_file) && (rerun_failed || failed_first)) {
+    default_failed_file = utest_last_failed_path(argv[0]);
+
+    if (UTEST_NULL == default_failed_file) {
+      failed = 1;
+      goto cleanup;
+    }
+
+    failed_file = default_failed_file;
+  }
+
+  if (UTEST_NULL != failed_file) {
+    last_failed = utest_last_failed_read(failed_file);
+  }
+
+  if (UTEST_NULL != cache_file) {
+    const utest_uint64_t key = utest_cache_key(argc, argv);
+
+    UTEST_SNPRINTF(cache_header, sizeof(cache_header),
+                   "utest-cache %" UTEST_PRIu64 "\n", key);
+    cached = UTEST_PTR_CAST(unsigned char *,
+                            calloc(utest_state.tests_length + 1, 1));
+    if (UTEST_NULL == cached) {
+      failed = 1;
+      goto cleanup;
+    }
 
-      // Move the seed onwards.
-      seed = seed * 747796405u + 2891336453u;
+    if (0 == key) {
+      printf("%s[ WARNING  ]%s Could not read the test binary to hash it, so "
+             "no results are cached\n",
+             colours[YELLOW], colours[RESET]);
+      cache_file = UTEST_NULL;
+    } else {
+      cache = utest_last_failed_read(cache_file);
+
+      /* the cache is only used when it is for this exact binary */
+      if ((UTEST_NULL != cache) &&
+          (0 == UTEST_STRNCMP(cache, cache_header, strlen(cache_header)))) {
+        utest_cache_mark(cache + strlen(cache_header), cached);
+      }
     }
   }
 
+  if (rerun_failed && (UTEST_NULL != last_failed) && ('\0' != *last_failed)) {
+    rerun = last_failed;
+  } else if (rerun_failed) {
+    printf("%s[==========]%s No tests failed the last time, so running them "
+           "all.\n",
+           colours[GREEN], colours[RESET]);
+  }
+
   for (index = 0; index < utest_state.tests_length; index++) {
-    if (utest_should_filter_test(filter, utest_state.tests[index].name)) {
+    if (!utest_selected(filter, rerun, utest_state.tests[index].name)) {
       continue;
     }
 
     ran_tests++;
   }
 
+  /* --until-fail on its own repeats the tests without limit (a repeat of 0) */
+  if ((0 == repeat) && !until_fail) {
+    repeat = 1;
+  }
+
+  order = UTEST_PTR_CAST(
+      size_t *, malloc(sizeof(size_t) * (utest_state.tests_length + 1)));
+  if (UTEST_NULL == order) {
+    failed = 1;
+    goto cleanup;
+  }
+
+  for (index = 0; index < utest_state.tests_length; index++) {
+    order[index] = index;
+  }
+
+  if (failed_first && (UTEST_NULL != last_failed)) {
+    utest_last_failed_first(order, utest_state.tests_length, last_failed);
+  }
+
+  repeats = UTEST_PTR_CAST(
+      struct utest_repeat_s *,
+      calloc(utest_state.tests_length + 1, sizeof(struct utest_repeat_s)));
+  if (UTEST_NULL == repeats) {
+    failed = 1;
+    goto cleanup;
+  }
+
+  utest_state.repeats = repeats;
+
+  if (crash_handler) {
+    crash_handle = utest_crash_handler_install();
+
+    if (UTEST_NULL == crash_handle) {
+      printf("%s[ WARNING  ]%s The crash handler isn't supported on this "
+             "platform\n",
+             colours[YELLOW], colours[RESET]);
+    }
+  }
+
+  if ((0 <= utest_state.pin_cpu) || utest_state.isolate_noise) {
+    const size_t cpu =
+        0 <= utest_state.pin_cpu ? UTEST_CAST(size_t, utest_state.pin_cpu) : 0;
+
+    if ((0 <= utest_state.pin_cpu) && (0 != utest_pin_cpu(cpu))) {
+      printf("%s[ WARNING  ]%s Could not pin the tests to CPU %" UTEST_PRIu64
+             "\n",
+             colours[YELLOW], colours[RESET], UTEST_CAST(utest_uint64_t, cpu));
+    }
+
+    utest_environment_read(&environment, cpu);
+
+    printf("%s[==========]%s CPU: %s (%" UTEST_PRIu64 " online)\n",
+           colours[GREEN], colours[RESET], environment.cpu,
+           UTEST_CAST(utest_uint64_t, utest_cpu_count()));
+    printf("%s[==========]%s Governor: %s, load average: %s\n",
+           colours[GREEN], colours[RESET], environment.governor,
+           environment.load_average);
+
+    if (utest_state.isolate_noise) {
+      const utest_int64_t warmup = utest_ns();
+
+      if (0 != utest_raise_priority()) {
+        printf("%s[ WARNING  ]%s Could not raise the scheduling priority (it "
+               "needs more privileges)\n",
+               colours[YELLOW], colours[RESET]);
+      }
+
+      if ((0 != strcmp(environment.governor, "performance")) &&
+          (0 != strcmp(environment.governor, "unknown"))) {
+        printf("%s[ WARNING  ]%s The CPU frequency governor is '%s', not "
+               "'performance'\n",
+               colours[YELLOW], colours[RESET], environment.governor);
+      }
+
+      if (environment.turbo) {
+        printf("%s[ WARNING  ]%s Turbo boost is enabled, so the CPU's clock "
+               "varies with its temperature\n",
+               colours[YELLOW], colours[RESET]);
+      }
+
+      /* spin for a moment, so the CPU has ramped its clock up */
+      while (100000000 > utest_ns() - warmup) {
+      }
+    }
+  }
+
   printf("%s[==========]%s Running %" UTEST_PRIu64 " test cases.\n",
          colours[GREEN], colours[RESET], UTEST_CAST(utest_uint64_t, ran_tests));
 
@@ -1446,119 +8243,332 @@ int utest_main(int argc, const char *const argv[]) {
     fprintf(utest_state.output,
             "<testsuite name=\"Tests\" tests=\"%" UTEST_PRIu64 "\">\n",
             UTEST_CAST(utest_uint64_t, ran_tests));
+
+    if ((0 <= utest_state.pin_cpu) || utest_state.isolate_noise) {
+      fprintf(utest_state.output,
+              "<properties><property name=\"cpu\" value=\"%s\"/>"
+              "<property name=\"pinned_cpu\" value=\"%d\"/>"
+              "<property name=\"governor\" value=\"%s\"/>"
+              "<property name=\"load_average\" value=\"%s\"/>"
+              "<property name=\"turbo\" value=\"%d\"/></properties>\n",
+              environment.cpu, utest_state.pin_cpu, environment.governor,
+              environment.load_average, environment.turbo);
+    }
   }
 
-  for (index = 0; index < utest_state.tests_length; index++) {
-    int result = UTEST_TEST_PASSED;
-    utest_int64_t ns = 0;
+  if ((0 < processes) &&
+      (0 != utest_pool_start(&pool, processes, recycle_after))) {
+    printf("%s[ WARNING  ]%s Could not fork the worker processes, so the tests "
+           "run in this one\n",
+           colours[YELLOW], colours[RESET]);
+    utest_pool_shutdown(&pool);
+  }
 
-    if (utest_should_filter_test(filter, utest_state.tests[index].name)) {
-      continue;
+  for (repetition = 0; (0 == repeat) || (repetition < repeat); repetition++) {
+    if ((until_fail && (0 != failed)) ||
+        ((0 != max_failures) && (failed >= max_failures))) {
+      break;
     }
 
-    printf("%s[ RUN      ]%s %s\n", colours[GREEN], colours[RESET],
-           utest_state.tests[index].name);
+    if (0 < repetition) {
+      printf("%s[==========]%s Repetition %" UTEST_PRIu64 ".\n",
+             colours[GREEN], colours[RESET],
+             UTEST_CAST(utest_uint64_t, repetition + 1));
+
+      /* each repetition runs the tests in a new order, from the same seed */
+      if (random_order) {
+        for (position = utest_state.tests_length; position > 1; position--) {
+          const utest_uint32_t next =
+              utest_random(&seed) % UTEST_CAST(utest_uint32_t, position);
+          const size_t copy = order[position - 1];
+          order[position - 1] = order[next];
+          order[next] = copy;
+        }
 
-    if (utest_state.output) {
-      fprintf(utest_state.output, "<testcase name=\"%s\">",
-              utest_state.tests[index].name);
+        if (failed_first && (UTEST_NULL != last_failed)) {
+          utest_last_failed_first(order, utest_state.tests_length,
+                                  last_failed);
+        }
+      }
     }
 
-    ns = utest_ns();
-    errno = 0;
-#if defined(UTEST_HAS_EXCEPTIONS)
-    UTEST_SURPRESS_WARNING_BEGIN
-    try {
-      utest_state.tests[index].func(&result, utest_state.tests[index].index);
-    } catch (const std::exception &err) {
-      printf(" Exception : %s\n", err.what());
-      result = UTEST_TEST_FAILURE;
-    } catch (...) {
-      printf(" Exception : Unknown\n");
-      result = UTEST_TEST_FAILURE;
-    }
-    UTEST_SURPRESS_WARNING_END
-#else
-    utest_state.tests[index].func(&result, utest_state.tests[index].index);
-#endif
-    ns = utest_ns() - ns;
+    position = 0;
+    pool.queued = 0;
+    scheduled = 0;
 
-    if (utest_state.output) {
-      fprintf(utest_state.output, "</testcase>\n");
-    }
+    for (;;) {
+      int result = UTEST_TEST_PASSED;
+      utest_int64_t ns = 0;
+      utest_uint64_t checked = 0;
+      struct utest_pool_worker_s *worker = UTEST_NULL;
 
-    // Record the failing test.
-    if (UTEST_TEST_FAILURE == result) {
-      const size_t failed_testcase_index = failed_testcases_length++;
-      failed_testcases = UTEST_PTR_CAST(
-          size_t *, utest_realloc(UTEST_PTR_CAST(void *, failed_testcases),
-                                  sizeof(size_t) * failed_testcases_length));
-      if (UTEST_NULL != failed_testcases) {
-        failed_testcases[failed_testcase_index] = index;
+      /* move on to the next test that is selected, and isn't cached */
+      for (; position < utest_state.tests_length; position++) {
+        index = order[position];
+
+        if (!utest_selected(filter, rerun, utest_state.tests[index].name)) {
+          continue;
+        }
+
+        if ((UTEST_NULL != cached) && cached[index]) {
+          printf("%s[  CACHED  ]%s %s\n", colours[GREEN], colours[RESET],
+                 utest_state.tests[index].name);
+
+          if (utest_state.output) {
+            fprintf(utest_state.output,
+                    "<testcase name=\"%s\"><properties><property "
+                    "name=\"cached\" value=\"1\"/></properties></testcase>\n",
+                    utest_state.tests[index].name);
+          }
+
+          cached_tests += (0 == repetition) ? 1 : 0;
+          continue;
+        }
+
+        break;
       }
-      failed++;
-    } else if (UTEST_TEST_SKIPPED == result) {
-      const size_t skipped_testcase_index = skipped_testcases_length++;
-      skipped_testcases = UTEST_PTR_CAST(
-          size_t *, utest_realloc(UTEST_PTR_CAST(void *, skipped_testcases),
-                                  sizeof(size_t) * skipped_testcases_length));
-      if (UTEST_NULL != skipped_testcases) {
-        skipped_testcases[skipped_testcase_index] = index;
+
+      if (0 < pool.length) {
+        /* queue every test up first, so they can be spread over the workers */
+        if (position < utest_state.tests_length) {
+          pool.queue[pool.queued++] = order[position++];
+          continue;
+        } else if (!scheduled) {
+          utest_pool_schedule(&pool);
+          scheduled = 1;
+        }
+
+        /* keep every worker busy, and only wait on them once they all are */
+        worker = utest_pool_idle(&pool);
+
+        if ((UTEST_NULL != worker) &&
+            (0 == utest_pool_next(&pool, worker, &index))) {
+          printf("%s[ RUN      ]%s %s\n", colours[GREEN], colours[RESET],
+                 utest_state.tests[index].name);
+
+          /* a worker that couldn't be sent its test is reported as it dies */
+          utest_pool_dispatch(worker, index);
+          continue;
+        }
+
+        worker = utest_pool_wait(&pool);
+
+        if (UTEST_NULL != worker) {
+          index = worker->index;
+
+          if (utest_state.output) {
+            fprintf(utest_state.output, "<testcase name=\"%s\">",
+                    utest_state.tests[index].name);
+          }
+
+          ns = utest_pool_finish(&pool, worker, &result, &checked,
+                                 &failed_teardowns);
+        } else if ((0 < utest_pool_live(&pool)) ||
+                   (0 != utest_pool_next(&pool, pool.workers, &index))) {
+          break;
+        }
+        /* else no workers are left, so the tests they didn't run run in here */
+      } else if (position < utest_state.tests_length) {
+        index = order[position++];
+      } else {
+        break;
       }
-      skipped++;
-    }
 
-    {
-      const char *const units[] = {"ns", "us", "ms", "s", UTEST_NULL};
-      unsigned int unit_index = 0;
-      utest_int64_t time = ns;
+      if (UTEST_NULL == worker) {
+        printf("%s[ RUN      ]%s %s\n", colours[GREEN], colours[RESET],
+               utest_state.tests[index].name);
 
-      if (enable_mixed_units) {
-        for (unit_index = 0; UTEST_NULL != units[unit_index]; unit_index++) {
-          if (10000 > time) {
-            break;
+        if (utest_state.output) {
+          fprintf(utest_state.output, "<testcase name=\"%s\">",
+                  utest_state.tests[index].name);
+        }
+
+        /* the crash handler writes straight to the files, so catch them up */
+        if (UTEST_NULL != crash_handle) {
+          fflush(stdout);
+          if (utest_state.output) {
+            fflush(utest_state.output);
           }
+        }
+
+        ns = utest_run_test(index, &result, &checked);
+      }
+
+      assertions_checked += checked;
+      assertions_failed += utest_state.assertions_failed;
+
+      if (utest_state.output) {
+        fprintf(utest_state.output,
+                "<properties><property name=\"assertions\" value=\"%"
+                UTEST_PRIu64 "\"/><property name=\"failed_assertions\" "
+                "value=\"%" UTEST_PRIu64 "\"/>%s</properties></testcase>\n",
+                checked, utest_state.assertions_failed,
+                utest_state.properties ? utest_state.properties : "");
+      }
+
+      utest_state.current_test = UTEST_NULL;
+      utest_state.current_result = UTEST_NULL;
 
-          time /= 1000;
+      utest_repeat_add(&repeats[index], result, ns);
+
+      // Record the failing test (only the once, when the tests are repeated).
+      // A test that was skipped the first time but failed since is failed.
+      if ((UTEST_TEST_FAILURE == result) &&
+          (1 == repeats[index].runs - repeats[index].passes)) {
+        if (repeats[index].skipped) {
+          repeats[index].skipped = 0;
+          skipped--;
         }
+
+        repeats[index].failed = 1;
+        failed++;
+      } else if ((UTEST_TEST_SKIPPED == result) && (0 == repetition)) {
+        repeats[index].skipped = 1;
+        skipped++;
       }
 
-      if (UTEST_TEST_FAILURE == result) {
-        printf("%s[  FAILED  ]%s %s (%" UTEST_PRId64 "%s)\n", colours[RED],
-               colours[RESET], utest_state.tests[index].name, time,
-               units[unit_index]);
-      } else if (UTEST_TEST_SKIPPED == result) {
-        printf("%s[  SKIPPED ]%s %s (%" UTEST_PRId64 "%s)\n", colours[YELLOW],
-               colours[RESET], utest_state.tests[index].name, time,
-               units[unit_index]);
-      } else {
-        printf("%s[       OK ]%s %s (%" UTEST_PRId64 "%s)\n", colours[GREEN],
-               colours[RESET], utest_state.tests[index].name, time,
-               units[unit_index]);
+      {
+        const char *const units[] = {"ns", "us", "ms", "s", UTEST_NULL};
+        unsigned int unit_index = 0;
+        utest_int64_t time = ns;
+
+        if (enable_mixed_units) {
+          for (unit_index = 0; UTEST_NULL != units[unit_index]; unit_index++) {
+            if (10000 > time) {
+              break;
+            }
+
+            time /= 1000;
+          }
+        }
+
+        if (UTEST_TEST_FAILURE == result) {
+          printf("%s[  FAILED  ]%s %s (%" UTEST_PRId64 "%s)\n", colours[RED],
+                 colours[RESET], utest_state.tests[index].name, time,
+                 units[unit_index]);
+        } else if (UTEST_TEST_SKIPPED == result) {
+          printf("%s[  SKIPPED ]%s %s (%" UTEST_PRId64 "%s)\n", colours[YELLOW],
+                 colours[RESET], utest_state.tests[index].name, time,
+                 units[unit_index]);
+        } else {
+          printf("%s[       OK ]%s %s (%" UTEST_PRId64 "%s)\n", colours[GREEN],
+                 colours[RESET], utest_state.tests[index].name, time,
+                 units[unit_index]);
+        }
+      }
+
+      if (until_fail && (UTEST_TEST_FAILURE == result)) {
+        break;
+      }
+
+      /* with --fail-fast or --max-failures, stop once enough tests failed */
+      if ((0 != max_failures) && (failed >= max_failures)) {
+        break;
+      }
+    }
+  }
+
+  /* the tests that were stopped before they ran aren't counted as passing */
+  for (index = 0; index < utest_state.tests_length; index++) {
+    if (utest_selected(filter, rerun, utest_state.tests[index].name) &&
+        (0 == repeats[index].runs) &&
+        ((UTEST_NULL == cached) || !cached[index])) {
+      not_run++;
+    }
+  }
+
+  ran_tests -= not_run;
+
+  /* any test a worker is still running was cancelled, and counts as not run */
+  failed_teardowns += utest_pool_shutdown(&pool);
+
+  if ((1 != repeat) || until_fail) {
+    printf("%s[==========]%s %" UTEST_PRIu64 " repetitions ran.\n",
+           colours[GREEN], colours[RESET],
+           UTEST_CAST(utest_uint64_t, repetition));
+
+    for (index = 0; index < utest_state.tests_length; index++) {
+      const struct utest_repeat_s *const stats = &repeats[index];
+      const double rate = utest_repeat_pass_rate(stats);
+      const char *colour = colours[YELLOW];
+
+      if (0 == stats->runs) {
+        continue;
+      } else if (stats->passes == stats->runs) {
+        colour = colours[GREEN];
+      } else if (0 == stats->passes) {
+        colour = colours[RED];
       }
+
+      printf("%s[  %6.1f%% ]%s %s (%" UTEST_PRIu64 "/%" UTEST_PRIu64
+             " passed, mean %.0fns, stddev %.0fns)\n",
+             colour, rate, colours[RESET], utest_state.tests[index].name,
+             stats->passes, stats->runs, stats->mean_ns,
+             utest_repeat_stddev(stats));
     }
   }
 
+  /* tear down any fixtures that were still being kept in the fixture pool */
+  failed_teardowns +=
+      utest_fixture_pools_teardown(colours[RED], colours[RESET]);
+
   printf("%s[==========]%s %" UTEST_PRIu64 " test cases ran.\n", colours[GREEN],
          colours[RESET], ran_tests);
+  printf("%s[==========]%s %" UTEST_PRIu64 " assertions checked, %" UTEST_PRIu64
+         " failed.\n",
+         colours[GREEN], colours[RESET], assertions_checked, assertions_failed);
   printf("%s[  PASSED  ]%s %" UTEST_PRIu64 " tests.\n", colours[GREEN],
          colours[RESET], ran_tests - failed - skipped);
 
+  if (0 != cached_tests) {
+    printf("%s[  CACHED  ]%s %" UTEST_PRIu64
+           " of them passed in an earlier run of this test binary, so "
+           "weren't run again.\n",
+           colours[GREEN], colours[RESET], cached_tests);
+  }
+
   if (0 != skipped) {
     printf("%s[  SKIPPED ]%s %" UTEST_PRIu64 " tests, listed below:\n",
            colours[YELLOW], colours[RESET], skipped);
-    for (index = 0; index < skipped_testcases_length; index++) {
-      printf("%s[  SKIPPED ]%s %s\n", colours[YELLOW], colours[RESET],
-             utest_state.tests[skipped_testcases[index]].name);
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (repeats[index].skipped) {
+        printf("%s[  SKIPPED ]%s %s\n", colours[YELLOW], colours[RESET],
+               utest_state.tests[index].name);
+      }
     }
   }
 
   if (0 != failed) {
     printf("%s[  FAILED  ]%s %" UTEST_PRIu64 " tests, listed below:\n",
            colours[RED], colours[RESET], failed);
-    for (index = 0; index < failed_testcases_length; index++) {
-      printf("%s[  FAILED  ]%s %s\n", colours[RED], colours[RESET],
-             utest_state.tests[failed_testcases[index]].name);
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (repeats[index].failed) {
+        printf("%s[  FAILED  ]%s %s\n", colours[RED], colours[RESET],
+               utest_state.tests[index].name);
+      }
+    }
+  }
+
+  if (0 != not_run) {
+    printf("%s[ NOT RUN  ]%s %" UTEST_PRIu64
+           " tests, stopped after %" UTEST_PRIu64 " failed, listed below:\n",
+           colours[YELLOW], colours[RESET], not_run, failed);
+    for (index = 0; index < utest_state.tests_length; index++) {
+      if (!utest_selected(filter, rerun, utest_state.tests[index].name) ||
+          (0 != repeats[index].runs) ||
+          ((UTEST_NULL != cached) && cached[index])) {
+        continue;
+      }
+
+      printf("%s[ NOT RUN  ]%s %s\n", colours[YELLOW], colours[RESET],
+             utest_state.tests[index].name);
+
+      if (utest_state.output) {
+        fprintf(utest_state.output,
+                "<testcase name=\"%s\"><skipped message=\"not run, stopped "
+                "after %" UTEST_PRIu64 " failed\"/></testcase>\n",
+                utest_state.tests[index].name, failed);
+      }
     }
   }
 
@@ -1566,20 +8576,48 @@ int utest_main(int argc, const char *const argv[]) {
     fprintf(utest_state.output, "</testsuite>\n</testsuites>\n");
   }
 
+  if (UTEST_NULL != failed_file) {
+    utest_last_failed_write(failed_file, last_failed, repeats);
+  }
+
+  if (UTEST_NULL != cache_file) {
+    utest_cache_write(cache_file, cache_header, cached, repeats);
+  }
+
 cleanup:
+  utest_pool_shutdown(&pool);
+  utest_crash_handler_uninstall(crash_handle);
+  utest_state.repeats = UTEST_NULL;
+
   for (index = 0; index < utest_state.tests_length; index++) {
     free(UTEST_PTR_CAST(void *, utest_state.tests[index].name));
   }
 
-  free(UTEST_PTR_CAST(void *, skipped_testcases));
-  free(UTEST_PTR_CAST(void *, failed_testcases));
   free(UTEST_PTR_CAST(void *, utest_state.tests));
+  free(UTEST_PTR_CAST(void *, utest_state.fixture_pools));
+  free(UTEST_PTR_CAST(void *, utest_state.fuzz_targets));
+  free(UTEST_PTR_CAST(void *, utest_state.scaling));
+  free(order);
+  free(repeats);
+  free(last_failed);
+  free(default_failed_file);
+  free(cache);
+  free(cached);
+  free(utest_state.properties);
+  while (UTEST_NULL != utest_state.threads) {
+    struct utest_thread_s *const thread = utest_state.threads;
+    utest_state.threads = thread->next;
+    free(thread->output);
+    free(thread);
+  }
+  utest_thread = UTEST_NULL;
+  utest_free_files(utest_state.data_paths, utest_state.data_paths_length);
 
   if (utest_state.output) {
     fclose(utest_state.output);
   }
 
-  return UTEST_CAST(int, failed);
+  return UTEST_CAST(int, failed + failed_teardowns);
 }
 
 /*
@@ -1588,7 +8626,11 @@ cleanup:
    data without having to use the UTEST_MAIN macro, thus allowing them to write
    their own main() function.
 */
-#define UTEST_STATE() struct utest_state_s utest_state = {0, 0, 0}
+#define UTEST_STATE()                                                          \
+  struct utest_state_s utest_state = {                                         \
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,              \
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};          \
+  UTEST_THREAD_LOCAL struct utest_thread_s *utest_thread = UTEST_NULL
 
 /*
    define a main() function to call into utest.h and start executing tests! A
@@ -1597,10 +8639,31 @@ cleanup:
    file, use the UTEST_STATE macro to declare a global struct variable that
    utest requires.
 */
+#if defined(UTEST_FUZZING)
+/*
+   when built for fuzzing (EG. with -fsanitize=fuzzer) the fuzzing engine owns
+   main(), so UTEST_MAIN instead provides the entry point that the engine
+   calls with each input, forwarding it to one of the UTEST_FUZZ targets. This
+   is only ever opted into explicitly - fuzzing builds (EG. OSS-Fuzz's) define
+   FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION for every file they compile, plain
+   unit test binaries included, and those still need their main().
+*/
+#define UTEST_MAIN()                                                           \
+  UTEST_STATE();                                                               \
+  UTEST_EXTERN int LLVMFuzzerTestOneInput(const unsigned char *, size_t);      \
+  int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size) {         \
+    static struct utest_fuzz_target_s *target = UTEST_NULL;                    \
+    if (UTEST_NULL == target) {                                                \
+      target = utest_fuzz_target();                                            \
+    }                                                                          \
+    return utest_fuzz_one_input(target, data, size);                           \
+  }
+#else
 #define UTEST_MAIN()                                                           \
   UTEST_STATE();                                                               \
   int main(int argc, const char *const argv[]) {                               \
     return utest_main(argc, argv);                                             \
   }
+#endif
 
 #endif /* SHEREDOM_UTEST_H_INCLUDED */